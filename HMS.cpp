@@ -1,41 +1,55 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <fstream>
+#include <functional>
+#include <limits>
 #include <vector>
 #include <string>
-#include <algorithm>
+#include <string_view>
+#include <thread>
+#include <cstdlib>
 #include <iomanip> // Include iomanip for setprecision
 #include <ctime> // For current date and time
+#include <csignal>
+
+#include "analytics.h"
+#include "batch.h"
+#include "billing.h"
+#include "display.h"
+#include "hospital.h"
+#include "importer.h"
+#include "metrics.h"
+#include "replication.h"
+#include "router.h"
+#include "screen.h"
+#include "server.h"
 using namespace std;
-
+using namespace hms;
 
 // Function to get the current date and time as a formatted string
 string getCurrentDateTime() {
-    time_t now = time(0);
-    char buffer[80];
-    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", localtime(&now));
-    return string(buffer);
+    return formatDateTime(time(0));
 }
 
 // Function to display the current date and time in the top-right corner
 void displayCurrentDateTime() {
     string dateTime = getCurrentDateTime();
-    cout << "\033[2J\033[1;1H"; // Clear screen and move cursor to top-left
-    cout << setw(60) << right << dateTime << endl; // Display date and time aligned to the right
+    Screen screen;
+    screen << "\033[2J\033[1;1H"; // Clear screen and move cursor to top-left
+    screen.out() << setw(60) << right << dateTime << "\n"; // Display date and time aligned to the right
 }
 
 
-
-vector<string> departmentRepository;
-
-
 class Service {
 public:
     string category; // Medical, Diagnostic, etc.
-    vector<string> subDepartments;
+    vector<Symbol> subDepartments;
 
     void displayService() const {
         cout << "Category: " << category << "\n";
         cout << "  Sub-Departments: ";
-        for (const string& subDepartment : subDepartments) {
+        for (Symbol subDepartment : subDepartments) {
             cout << subDepartment << ", ";
         }
         cout << "\n";
@@ -43,105 +57,10 @@ public:
 };
 
 
-class Room {
-public:
-    string type;
-    int totalRooms;
-    int occupiedRooms;
-
-    Room(string type = "", int total = 0, int occupied = 0)  
-        : type(type), totalRooms(total), occupiedRooms(occupied) {} 
-
-    int availableRooms() const {
-        return totalRooms - occupiedRooms;
-    }
-
-    void displayRoom() const {
-        cout << "Room Type: " << type 
-             << " | Total: " << totalRooms 
-             << " | Occupied: " << occupiedRooms 
-             << " | Available: " << availableRooms() << endl;
-    }
-
-    
-};
-
-
-// Base Staff class
-
-const int HOURS_IN_DAY = 24;
-
-
-class Staff {
-public:
-    string name;
-    string department;
-    vector<string> timetable;
-
-    // Constructor to initialize the timetable with "Free"
-    Staff() : timetable(HOURS_IN_DAY, "Free") {}
-
-    // Display basic staff details
-    virtual void displayStaff() const {
-        cout << "Name: " << name
-             << "\nDepartment: " << department << "\n";
-    }
-
-    // Display the timetable
-    void displayTimetable() const {
-        cout << "\nTimetable for " << name << ":\n";
-        cout << "+---------------------------------------------------------------------------------------------------------+\n";
-        cout << "| Hour   |  0   1   2   3   4   5   6   7   8   9  10  11  12  13  14  15  16  17  18  19  20  21  22  23  |\n";
-        cout << "+---------------------------------------------------------------------------------------------------------+\n";
-        cout << "| Status | ";
-        for (const auto& status : timetable) {
-            cout << (status == "Free" ? " #  " : " X  ");
-        }
-        cout << "|\n";
-        cout << "+---------------------------------------------------------------------------------------------------------+\n";
-    }
-
-    // Update the timetable with a specific status for a time range
-    void updateTimetable(int startHour, int endHour, const string& status) {
-        for (int i = startHour; i <= endHour; ++i) {
-            if (i >= 0 && i < HOURS_IN_DAY) {
-                timetable[i] = status;
-            }
-        }
-    }
-
-    
-};
-
-// Derived classes
-class Doctor : public Staff {
-public:
-    void displayStaff() const override {
-        cout << "[Doctor]\n";
-        Staff::displayStaff();
-    }
-};
-
-class Nurse : public Staff {
-public:
-    void displayStaff() const override {
-        cout << "[Nurse]\n";
-        Staff::displayStaff();
-    }
-};
-
-class Technician : public Staff {
-public:
-    void displayStaff() const override {
-        cout << "[Technician]\n";
-        Staff::displayStaff();
-    }
-};
 
 
-// Function to customize staff timetable
-void staffScheduling(Staff& staffMember) {
-    cout << "\nEditing Timetable for " << staffMember.name << ":\n";
+void staffScheduling(Hospital& hospital, StaffRef staffMember) {
+    cout << "\nEditing Timetable for " << staffMember.name() << ":\n";
     while (true) {
         cout << "Enter the start hour (0-23, -1 to exit): ";
         int startHour;
@@ -166,63 +85,15 @@ void staffScheduling(Staff& staffMember) {
         getline(cin, status);
         status = (status.empty() || (status != "Work" && status != "Free")) ? "Free" : status;
 
-        staffMember.updateTimetable(startHour, endHour, status);
+        hospital.updateTimetable(staffMember, startHour, endHour, parseSlotState(status));
         cout << "Timetable updated.\n";
     }
 }
 
 
-class Patient {
-public:
-    string id;
-    string name;
-    int age;
-    string reasonForVisit;
-    string department;
-    bool hospitalized;
-    string roomType;
-    string hospitalizationDate;
-    string dischargeDate;
-    vector<string> history;
-
-    Patient(string id = "", string name = "", int age = 0, string reason = "", string dept = "", 
-            bool hosp = false, string room = "", string hospDate = "", string discDate = "")
-        : id(id), name(name), age(age), reasonForVisit(reason), department(dept),
-          hospitalized(hosp), roomType(room), hospitalizationDate(hospDate), dischargeDate(discDate) {}
-
-    void addHistory(const string& event) {
-        history.push_back(event);
-    }
-
-    void displayPatient() const{
-        cout<<"ID: "<< id <<" | Name: "<<name 
-            <<" | Age: "<<age 
-            <<" | Reason: "<<reasonForVisit 
-            <<" | Department: "<<department 
-            <<" | Hospitalized: "<<(hospitalized ? "Yes" : "No") 
-            <<" | Room Type: " <<roomType 
-            <<" | Hospitalization Date: "<<hospitalizationDate 
-            <<" | Discharge Date: "<<dischargeDate<<endl
-            <<" | History:\n";
-        for (const auto& event : history){
-            cout<<"  - "<<event<<"\n";
-        }
-    }
-
-    // Overload operator==
-    bool operator==(const Patient& other) const {
-        return id == other.id; // Compare based on unique ID
-    }
-};
-
-
-
-
-
-
-
 // Configure staff
-void configureStaff(vector<Doctor>& doctors, vector<Nurse>& nurses, vector<Technician>& technicians) {
+void configureStaff(Hospital& hospital) {
+    const vector<Symbol>& departmentRepository = hospital.departments();
     while (true) {
         cout << "\nSelect staff type:\n";
         cout << "1. Doctor\n";
@@ -236,21 +107,22 @@ void configureStaff(vector<Doctor>& doctors, vector<Nurse>& nurses, vector<Techn
 
         if (choice == "done") break;
 
-        Staff* staffMember = nullptr;
+        StaffRole role;
 
         if (choice == "1") {
-            staffMember = new Doctor();
+            role = StaffRole::Doctor;
         } else if (choice == "2") {
-            staffMember = new Nurse();
+            role = StaffRole::Nurse;
         } else if (choice == "3") {
-            staffMember = new Technician();
+            role = StaffRole::Technician;
         } else {
             cout << "Invalid choice. Try again.\n";
             continue;
         }
 
+        Staff staffMember;
         cout << "Enter staff member's name: ";
-        getline(cin, staffMember->name);
+        getline(cin, staffMember.name);
 
         if (!departmentRepository.empty()) {
             cout << "Select a Department:\n";
@@ -263,28 +135,23 @@ void configureStaff(vector<Doctor>& doctors, vector<Nurse>& nurses, vector<Techn
             cin.ignore();
 
             if (deptChoice > 0 && deptChoice <= departmentRepository.size()) {
-                staffMember->department = departmentRepository[deptChoice - 1];
+                staffMember.department = departmentRepository[deptChoice - 1];
             } else {
                 cout << "Invalid choice. Skipping department assignment.\n";
             }
         }
 
-        staffScheduling(*staffMember);
-
-        if (Doctor* doc = dynamic_cast<Doctor*>(staffMember)) {
-            doctors.push_back(*doc);
-        } else if (Nurse* nurse = dynamic_cast<Nurse*>(staffMember)) {
-            nurses.push_back(*nurse);
-        } else if (Technician* tech = dynamic_cast<Technician*>(staffMember)) {
-            technicians.push_back(*tech);
+        StaffRef hired;
+        if (hospital.hireStaff(role, move(staffMember), &hired) != HmsStatus::Ok) {
+            cout << "A staff member needs a name. Try again.\n";
+            continue;
         }
-
-        delete staffMember;
+        staffScheduling(hospital, hired);
     }
 }
 
 
-void configureServices() {
+void configureServices(Hospital& hospital) {
     vector<Service> serviceList;
     int serviceCount;
 
@@ -309,8 +176,11 @@ void configureServices() {
             cout << "Sub-Department: ";
             getline(cin, subDepartment);
             if (subDepartment == "done") break;
+            if (hospital.addDepartment(subDepartment) != HmsStatus::Ok) {
+                cout << "Sub-department " << subDepartment << " already exists or has no name.\n";
+                continue;
+            }
             serviceItem.subDepartments.push_back(subDepartment);
-            departmentRepository.push_back(subDepartment); // Add to global repository
         }
 
         serviceList.push_back(serviceItem);
@@ -323,7 +193,7 @@ void configureServices() {
     }
 }
 
-void configureRooms(vector<Room>& rooms) {
+void configureRooms(Hospital& hospital) {
     int typeCount;
 
     cout << "How many different types of Rooms does your hospital have? ";
@@ -331,33 +201,42 @@ void configureRooms(vector<Room>& rooms) {
     cin.ignore();
 
     for (int i = 0; i < typeCount; i++) {
-        Room room;
+        string type;
+        int total, occupied;
         cout << "\nEnter the type of room (e.g., ICU, General Ward, etc.): ";
-        getline(cin, room.type);
+        getline(cin, type);
 
-        cout << "Enter the total number of " << room.type << " rooms: ";
-        cin >> room.totalRooms;
+        cout << "Enter the total number of " << type << " rooms: ";
+        cin >> total;
 
-        cout << "Enter the number of occupied " << room.type << " rooms: ";
-        cin >> room.occupiedRooms;
+        cout << "Enter the number of occupied " << type << " rooms: ";
+        cin >> occupied;
         cin.ignore();
 
-        rooms.push_back(room); // Update the shared rooms vector
+        if (hospital.addRoomType(type, total, occupied) != HmsStatus::Ok) {
+            cout << "Room type " << type << " was not added: it exists or its counts are invalid.\n";
+        }
     }
 
     cout << "\nRoom Details:\n";
-    for (const auto& room : rooms) {
-        room.displayRoom();
+    for (const auto& room : hospital.rooms()) {
+        displayRoom(room);
     }
 }
 
-void registerPatient(vector<Patient>& patientList) {
+void registerPatient(Hospital& hospital) {
+    const vector<Symbol>& departmentRepository = hospital.departments();
     Patient patient;
 
     cout << "\nEnter Patient ID: ";
     cin >> patient.id;
     cin.ignore();
 
+    if (hospital.patients().idInUse(patient.id)) {
+        cout << "A patient with ID " << patient.id << " is already registered.\n";
+        return;
+    }
+
     cout << "Enter Patient Name: ";
     getline(cin, patient.name);
 
@@ -385,19 +264,17 @@ void registerPatient(vector<Patient>& patientList) {
         }
     }
 
-    patientList.push_back(patient);
+    if (hospital.registerPatient(patient) != HmsStatus::Ok) {
+        cout << "Patient ID must be unique and non-empty. Registration cancelled.\n";
+        return;
+    }
     cout << "Patient registered successfully!\n";
 }
 
 
 
-void manageStaffSchedules(vector<Doctor>& doctors, vector<Nurse>& nurses, vector<Technician>& technicians) {
-    vector<Staff*> allStaff;
-
-    // Combine all staff types into one list for selection
-    for (auto& doctor : doctors) allStaff.push_back(&doctor);
-    for (auto& nurse : nurses) allStaff.push_back(&nurse);
-    for (auto& technician : technicians) allStaff.push_back(&technician);
+void manageStaffSchedules(Hospital& hospital) {
+    StaffDirectory& allStaff = hospital.staff();
 
     cout << "\nManaging staff schedules...\n";
     if (allStaff.empty()) {
@@ -405,25 +282,34 @@ void manageStaffSchedules(vector<Doctor>& doctors, vector<Nurse>& nurses, vector
         return;
     }
 
-    cout << "List of all staff members:\n";
-    for (size_t i = 0; i < allStaff.size(); ++i) {
-        cout << i + 1 << ". " << allStaff[i]->name << " (" << allStaff[i]->department << ")\n";
-    }
-
-    cout << "Enter the number of the staff member to manage (or '0' to go back): ";
-    int choice;
-    cin >> choice;
+    Pager pager(allStaff.size());
+    string input;
+    do {
+        Screen screen;
+        screen << "List of all staff members:\n";
+        for (size_t i = pager.first(); i < pager.end(); ++i) {
+            screen << i + 1 << ". " << allStaff.names()[i] << " (" << allStaff.departments()[i] << ")\n";
+        }
+        pager.footer(screen.out());
+        screen.flush();
+        cout << "Enter the number of the staff member to manage (or '0' to go back): ";
+        cin >> input;
+    } while (pager.turn(input));
+    int choice = atoi(input.c_str());
 
     if (choice == 0) return;
 
     if (choice > 0 && choice <= allStaff.size()) {
-        Staff* selectedStaff = allStaff[choice - 1];
-        cout << "Managing schedule for " << selectedStaff->name << ":\n";
-        selectedStaff->displayTimetable(); // Display current timetable
+        StaffRef selectedStaff = allStaff.member(choice - 1);
+        cout << "Managing schedule for " << selectedStaff.name() << ":\n";
+        displayTimetable(selectedStaff); // Display current timetable
 
-        staffScheduling(*selectedStaff); // Modify the timetable
+        staffScheduling(hospital, selectedStaff); // Modify the timetable
         cout << "Updated schedule:\n";
-        selectedStaff->displayTimetable(); // Show updated timetable
+        displayTimetable(selectedStaff); // Show updated timetable
+        int64_t today = dayOf(civilSeconds(time(0)) / 60) * MINUTES_IN_DAY;
+        displayCalendar(selectedStaff.name(), hospital.shiftsOf(selectedStaff),
+                        hospital.visitsOf(selectedStaff, today, today + 7 * MINUTES_IN_DAY), today, 7);
     } else {
         cout << "Invalid choice. Returning to the menu...\n";
     }
@@ -432,33 +318,67 @@ void manageStaffSchedules(vector<Doctor>& doctors, vector<Nurse>& nurses, vector
 
 
 
-void managePatients(vector<Patient>& patientList, vector<Doctor>& doctors, vector<Nurse>& nurses, vector<Technician>& technicians, vector<Room>& rooms) {
+const size_t SEARCH_RESULTS = 10;
+
+// Reads each match afresh, skipping any discharged and archived meanwhile
+void listSearchResults(const Hospital& hospital, const vector<string>& found, ostream& out) {
+    Patient record;
+    for (size_t i = 0; i < found.size(); ++i) {
+        if (!hospital.readPatient(found[i], record)) continue;
+        out << i + 1 << ". ID: " << record.id << " | Name: " << record.name << " | " << record.department << "\n";
+    }
+}
+
+// Shows the best matches while a search is typed
+function<void(const string&, ostream&)> suggestPatients(Hospital& hospital) {
+    return [&hospital](const string& query, ostream& out) {
+        listSearchResults(hospital, hospital.searchPatients(query, SEARCH_RESULTS), out);
+    };
+}
+
+// Lets the user pick one of the patients matching `query`; nullptr if
+// nothing matches or the user goes back
+Patient* pickSearchResult(Hospital& hospital, const string& query) {
+    vector<string> found = hospital.searchPatients(query, SEARCH_RESULTS);
+    if (found.empty()) return nullptr;
+    {
+        Screen screen;
+        screen << "Matching patients:\n";
+        listSearchResults(hospital, found, screen.out());
+    }
+    cout << "Select a patient by number (or '0' to go back): ";
+    string input;
+    cin >> input;
+    int choice = atoi(input.c_str());
+    return choice > 0 && choice <= (int)found.size() ? hospital.findPatient(found[choice - 1]) : nullptr;
+}
+
+void managePatients(Hospital& hospital) {
+    const vector<Symbol>& departmentRepository = hospital.departments();
     while (true) {
         cout << "\n********** Manage Patients **********\n";
-        cout << "List of Registered Patients (by ID):\n";
-        for (size_t i = 0; i < patientList.size(); ++i) {
-            cout << i + 1 << ". ID: " << patientList[i].id << " | Name: " << patientList[i].name << "\n";
-        }
-        cout << "Enter the Patient ID to manage (or '0' to go back): ";
-        string id;
-        cin >> id;
+        string id = readWithSuggestions("Enter the Patient ID, or search by name, reason or history (or '0' to go back): ",
+                                        suggestPatients(hospital));
 
         if (id == "0") {
             cout << "Returning to menu...\n";
             break;
         }
 
-        Patient* selectedPatient = nullptr;
-        for (auto& patient : patientList) {
-            if (patient.id == id) {
-                selectedPatient = &patient;
-                break;
-            }
-        }
+        Patient* selectedPatient = hospital.findPatient(id);
 
         if (!selectedPatient) {
-            cout << "Patient not found. Try again.\n";
-            continue;
+            ArchivedPatient closed = hospital.findArchivedPatient(id);
+            if (closed.valid()) {
+                cout << "Patient " << id << " has been discharged; showing the archived record.\n";
+                displayPatientChart(closed);
+                continue;
+            }
+            selectedPatient = pickSearchResult(hospital, id);
+            if (!selectedPatient) {
+                cout << "Patient not found. Try again.\n";
+                continue;
+            }
         }
 
         while (true) {
@@ -467,6 +387,7 @@ void managePatients(vector<Patient>& patientList, vector<Doctor>& doctors, vecto
             cout << "2. Schedule Appointment\n";
             cout << "3. Hospitalize/Assign Room\n";
             cout << "4. Back to Patient Selection\n";
+            cout << "5. Book a Dated Visit\n";
             cout << "Enter your choice: ";
             int choice;
             cin >> choice;
@@ -483,7 +404,7 @@ void managePatients(vector<Patient>& patientList, vector<Doctor>& doctors, vecto
                     cout << "Enter the corresponding number: ";
                     cin >> deptChoice;
                     if (deptChoice > 0 && deptChoice <= departmentRepository.size()) {
-                        selectedPatient->department = departmentRepository[deptChoice - 1];
+                        hospital.assignDepartment(*selectedPatient, departmentRepository[deptChoice - 1]);
                         cout << "Department updated successfully to " << selectedPatient->department << "!\n";
                     } else {
                         cout << "Invalid choice. Try again.\n";
@@ -497,50 +418,39 @@ void managePatients(vector<Patient>& patientList, vector<Doctor>& doctors, vecto
         break;
     }
 
-    vector<Staff*> departmentStaff;
-    for (auto& doctor : doctors) {
-        if (doctor.department == selectedPatient->department) {
-            departmentStaff.push_back(&doctor);
-        }
-    }
-    for (auto& nurse : nurses) {
-        if (nurse.department == selectedPatient->department) {
-            departmentStaff.push_back(&nurse);
-        }
-    }
-    for (auto& technician : technicians) {
-        if (technician.department == selectedPatient->department) {
-            departmentStaff.push_back(&technician);
-        }
-    }
+    vector<StaffRef> departmentStaff = hospital.staffInDepartment(selectedPatient->department);
 
     if (departmentStaff.empty()) {
         cout << "No staff available in the assigned department.\n";
         break;
     }
 
-    cout << "Available Staff in " << selectedPatient->department << ":\n";
-    for (size_t i = 0; i < departmentStaff.size(); ++i) {
-        cout << i + 1 << ". " << departmentStaff[i]->name << "\n";
-        departmentStaff[i]->displayTimetable();
-    }
-
-    cout << "Select a staff member by number: ";
-    int staffChoice;
-    cin >> staffChoice;
+    // Each timetable takes about seven rows
+    Pager pager(departmentStaff.size(), max<size_t>(pageRows() / 7, 1));
+    string input;
+    do {
+        Screen screen;
+        screen << "Available Staff in " << selectedPatient->department << ":\n";
+        for (size_t i = pager.first(); i < pager.end(); ++i) {
+            screen << i + 1 << ". " << departmentStaff[i].name() << "\n";
+            displayTimetable(departmentStaff[i], screen.out());
+        }
+        pager.footer(screen.out());
+        screen.flush();
+        cout << "Select a staff member by number: ";
+        cin >> input;
+    } while (pager.turn(input));
+    int staffChoice = atoi(input.c_str());
     if (staffChoice <= 0 || staffChoice > departmentStaff.size()) {
         cout << "Invalid choice. Try again.\n";
         break;
     }
 
-    Staff* selectedStaff = departmentStaff[staffChoice - 1];
+    StaffRef selectedStaff = departmentStaff[staffChoice - 1];
     cout << "Enter the hour for the appointment (0-23): ";
     int hour;
     cin >> hour;
-    if (hour >= 0 && hour < HOURS_IN_DAY && selectedStaff->timetable[hour] == "Work") {
-        selectedStaff->timetable[hour] = "Appointment";
-        string log = "Appointment scheduled with " + selectedStaff->name + " at hour " + to_string(hour) + " on " + getCurrentDateTime();
-        selectedPatient->history.push_back(log);
+    if (hospital.bookAppointment(*selectedPatient, selectedStaff, hour, time(0)) == HmsStatus::Ok) {
         cout << "Appointment scheduled successfully!\n";
     } else {
         cout << "Invalid hour or the selected time is not available.\n";
@@ -556,22 +466,17 @@ void managePatients(vector<Patient>& patientList, vector<Doctor>& doctors, vecto
     }
 
     cout << "Available Rooms:\n";
-    for (size_t i = 0; i < rooms.size(); ++i) {
-        if (rooms[i].availableRooms() > 0) {
-            cout << i + 1 << ". " << rooms[i].type << " (Available: " << rooms[i].availableRooms() << ")\n";
+    vector<RoomLoad> loads = hospital.statusBoard(time(0)).rooms;
+    for (size_t i = 0; i < loads.size(); ++i) {
+        if (loads[i].free > 0) {
+            cout << i + 1 << ". " << loads[i].type << " (Available: " << loads[i].free << ")\n";
         }
     }
     cout << "Select a room type by number: ";
     int roomChoice;
     cin >> roomChoice;
-    if (roomChoice > 0 && roomChoice <= rooms.size() && rooms[roomChoice - 1].availableRooms() > 0) {
-        selectedPatient->hospitalized = true;
-        selectedPatient->roomType = rooms[roomChoice - 1].type;
-        rooms[roomChoice - 1].occupiedRooms++;
-        selectedPatient->hospitalizationDate = getCurrentDateTime();
-        string log="Hospitalized in "+selectedPatient->roomType+" on "+selectedPatient->hospitalizationDate;
-        selectedPatient->history.push_back(log);
-        cout<<"Patient hospitalized successfully in "<<selectedPatient->roomType<<" room.\n";
+    if (roomChoice > 0 && hospital.hospitalize(*selectedPatient, roomChoice - 1, time(0)) == HmsStatus::Ok) {
+        cout<<"Patient hospitalized successfully in "<<selectedPatient->roomType<<" room, bed "<<selectedPatient->bed + 1<<".\n";
     } else {
         cout<<"Invalid choice or no rooms available.\n";
     }
@@ -579,6 +484,41 @@ void managePatients(vector<Patient>& patientList, vector<Doctor>& doctors, vecto
 }
 
 
+            case 5: {
+    if (selectedPatient->department.empty()) {
+        cout << "Please assign a department first.\n";
+        break;
+    }
+    cout << "Length of the visit in minutes: ";
+    int minutes;
+    cin >> minutes;
+    cout << "Earliest start (YYYY-MM-DD HH:MM, or 'now'): ";
+    string text;
+    cin >> ws;
+    getline(cin, text);
+    int64_t from = text == "now" ? civilSeconds(time(0)) / 60 : parseCivilMinute(text);
+    if (minutes <= 0 || from < 0) {
+        cout << "Invalid length or start time.\n";
+        break;
+    }
+    OpenSlot open = hospital.nextOpenSlot(selectedPatient->department, -1, from, minutes);
+    if (!open.member) {
+        cout << "No opening in " << selectedPatient->department << " within four weeks.\n";
+        break;
+    }
+    cout << "First opening: " << formatCivilMinute(open.start) << " with " << open.member.name() << ". Book it? (y/n): ";
+    string answer;
+    cin >> answer;
+    if (answer != "y" && answer != "Y") break;
+    if (hospital.bookVisit(*selectedPatient, open.member, open.start, minutes) == HmsStatus::Ok) {
+        cout << "Visit booked.\n";
+    } else {
+        cout << "That opening was just taken. Try again.\n";
+    }
+    break;
+}
+
+
             default:
                 cout<<"Invalid choice. Try again.\n";
                 break;
@@ -587,46 +527,335 @@ void managePatients(vector<Patient>& patientList, vector<Doctor>& doctors, vecto
     }
 }
 
-void displayPatientChart(const Patient& patient) {
-    cout<< "\n=============================================\n"
-        <<setw(20)<<left<< "Name:" << patient.name << "\n"
-        <<setw(20)<<left<< "Age:" << patient.age << "\n"
-        <<setw(20)<<left<< "Reason for Visit:" << patient.reasonForVisit << "\n"
-        <<setw(20)<<left<< "Assigned Department:" << patient.department << "\n"
-        <<setw(20)<<left<< "Hospitalized:" << (patient.hospitalized ? "Yes" : "No") << "\n";
-    if (patient.hospitalized){
-        cout<<setw(20)<<left<<"Assigned Room:"<<patient.roomType<<"\n";
-        cout<<setw(20)<<left<<"Hospitalization Date:"<<patient.hospitalizationDate<<"\n";
-    }
-    cout<<setw(20)<<left<<"Discharge Date:"<<(!patient.dischargeDate.empty()?patient.dischargeDate:"N/A")<<"\n";
-    cout<<"\n--- Patient History ---\n";
-    for(const auto& event:patient.history){
-        cout<<"  - "<<event<<"\n";
-    }
-    cout<<"=============================================\n";
+// Prints one report ("occupancy", "stays", "load", "heatmap") or "all"
+// of them; false for an unknown kind
+bool printReport(const AnalyticsEngine& engine, const string& kind, const TimeRange& range, int64_t bucketSeconds,
+                 ostream& out) {
+    bool all = kind == "all";
+    if (!all && kind != "occupancy" && kind != "stays" && kind != "load" && kind != "heatmap") return false;
+    if (all || kind == "occupancy") displayOccupancy(engine.occupancy(range, bucketSeconds), out);
+    if (all || kind == "stays") displayStayLengths(engine.stayLengths(range), out);
+    if (all || kind == "load") displayLoad(engine.load(range), 20, out);
+    if (all || kind == "heatmap") displayUtilization(engine.utilization(), out);
+    return true;
 }
 
+void reportsMenu(const Hospital& hospital) {
+    AnalyticsStore store;
+    store.load(hospital);
+    AnalyticsEngine engine(store, thread::hardware_concurrency());
+    static const char* kinds[] = {"occupancy", "stays", "load", "heatmap"};
+    while (true) {
+        cout << "\n--- Reports ---\n";
+        cout << "1. Occupancy by Room Type\n";
+        cout << "2. Average Length of Stay\n";
+        cout << "3. Department and Staff Load\n";
+        cout << "4. Hourly Utilization\n";
+        cout << "5. Back to Main Menu\n";
+        cout << "Enter your choice: ";
+        int choice;
+        if (!(cin >> choice) || choice == 5) return;
+        if (choice < 1 || choice > 4) {
+            cout << "Invalid choice. Please try again.\n";
+            continue;
+        }
+        TimeRange range;
+        if (choice != 4) {
+            string fromDate, toDate;
+            cout << "From date (YYYY-MM-DD, or '-' for the first record): ";
+            cin >> fromDate;
+            cout << "To date (YYYY-MM-DD, or '-' for today): ";
+            cin >> toDate;
+            if (!parseDateRange(fromDate == "-" ? "" : fromDate, toDate == "-" ? "" : toDate, range)) {
+                cout << "Dates must be written as YYYY-MM-DD.\n";
+                continue;
+            }
+        }
+        Screen screen;
+        printReport(engine, kinds[choice - 1], range, 0, screen.out());
+    }
+}
 
+int runBatchMode(const string& path, Hospital& hospital, unsigned desks) {
+    ios::sync_with_stdio(false);
+    ifstream file;
+    if (path != "-") {
+        file.open(path);
+        if (!file) {
+            cerr << "Cannot open command file " << path << "\n";
+            return 1;
+        }
+    }
+    BatchRunner runner(hospital);
+    BatchSummary summary = runner.run(path == "-" ? cin : file, cout, desks);
+    cout.flush();
+    cerr << summary.commands << " commands, " << summary.failed << " failed, "
+         << fixed << setprecision(3) << summary.seconds << " s, "
+         << setprecision(0) << (summary.seconds > 0 ? summary.commands / summary.seconds : 0.0) << " commands/s\n";
+    return summary.failed == 0 ? 0 : 2;
+}
 
-int main() {
-    vector<Doctor> doctors;
-    vector<Nurse> nurses;
-    vector<Technician> technicians;
-    vector<Room> rooms;
-    vector<Patient> patientList;
-   
+// Nothing is added unless every file can be read
+int runImportMode(const vector<string>& paths, Hospital& hospital, unsigned threads) {
+    ios::sync_with_stdio(false);
+    Importer importer(hospital, threads);
+    for (const string& path : paths) {
+        string error;
+        if (!importer.read(path, error)) {
+            cerr << error << "; nothing imported\n";
+            return 1;
+        }
+    }
+    ImportSummary summary = importer.commit(cout);
+    cout.flush();
+    cerr << summary.rows << " rows, " << summary.failed << " failed: " << summary.departments << " departments, "
+         << summary.rooms << " room types, " << summary.staff << " staff, " << summary.patients << " patients, "
+         << fixed << setprecision(3) << summary.seconds << " s\n";
+    return summary.failed == 0 ? 0 : 2;
+}
+
+Server* runningServer = nullptr;
+Router* runningRouter = nullptr;
+
+void stopServer(int) {
+    if (runningServer) runningServer->stop();
+    if (runningRouter) runningRouter->stop();
+}
+
+// Listens on each of the comma-separated addresses
+template <class Service>
+bool listenOn(Service& service, const string& addresses) {
+    string error;
+    for (size_t start = 0; start <= addresses.size();) {
+        size_t comma = addresses.find(',', start);
+        if (comma == string::npos) comma = addresses.size();
+        if (!service.listen(addresses.substr(start, comma - start), error)) {
+            cerr << error << "\n";
+            return false;
+        }
+        start = comma + 1;
+    }
+    return true;
+}
+
+int runServeMode(const string& addresses, Hospital& hospital, unsigned workers, bool readOnly = false) {
+    Server server(hospital, workers);
+    server.setReadOnly(readOnly);
+    if (!listenOn(server, addresses)) return 1;
+    runningServer = &server;
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    cerr << "Serving on " << addresses << " with " << workers << " workers\n";
+    auto started = chrono::steady_clock::now();
+    server.run();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    runningServer = nullptr;
+    ServerStats stats = server.stats();
+    cerr << stats.requests << " requests (" << stats.failed << " failed) on " << stats.connections
+         << " connections, " << stats.checkpoints << " checkpoints, " << fixed << setprecision(1) << seconds << " s\n";
+    return 0;
+}
+
+int runRouteMode(const string& addresses, const vector<Facility>& facilities) {
+    Router router(facilities);
+    if (!listenOn(router, addresses)) return 1;
+    runningRouter = &router;
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    cerr << "Routing on " << addresses << " for " << facilities.size() << " facilities\n";
+    router.run();
+    runningRouter = nullptr;
+    RouterStats stats = router.stats();
+    cerr << stats.requests << " requests (" << stats.failed << " failed) on " << stats.connections
+         << " connections, " << stats.probes << " patients located\n";
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    Hospital hospital;
+
+    // HMS_METRICS=0 turns operation metrics off. kill -USR1 writes them to
+    // stderr, as JSON when HMS_METRICS_FORMAT=json.
+    const char* metricsSetting = getenv("HMS_METRICS");
+    setMetricsEnabled(!(metricsSetting && string(metricsSetting) == "0"));
+    const char* metricsFormat = getenv("HMS_METRICS_FORMAT");
+    installMetricsDump(metricsFormat && string(metricsFormat) == "json");
+
+    // HMS --route ADDRESS[,ADDRESS...] --facility NAME=PRIMARY[,REPLICA] ...
+    // fronts the servers of several facilities; see router.h
+    if (argc >= 5 && string(argv[1]) == "--route") {
+        vector<Facility> facilities;
+        for (int i = 3; i < argc; i += 2) {
+            Facility facility;
+            string error;
+            if (string(argv[i]) != "--facility" || i + 1 == argc) error = "expected --facility NAME=PRIMARY[,REPLICA]";
+            else if (parseFacility(argv[i + 1], facility, error)) {
+                for (const Facility& other : facilities) {
+                    if (other.name == facility.name) error = "facility " + facility.name + " given twice";
+                }
+            }
+            if (!error.empty()) {
+                cerr << error << "\n";
+                return 1;
+            }
+            facilities.push_back(facility);
+        }
+        return runRouteMode(argv[2], facilities);
+    }
+
+    // HMS --serve ADDRESS[,ADDRESS...] --replica-of PRIMARY [--workers N]
+    // keeps a copy of a primary's state in memory, following its log, and
+    // answers queries about it; see replication.h
+    if ((argc == 5 || (argc == 7 && string(argv[5]) == "--workers")) && string(argv[1]) == "--serve" &&
+        string(argv[3]) == "--replica-of") {
+        unsigned workers = max(thread::hardware_concurrency(), 2u) - 1;
+        if (argc == 7) workers = (unsigned)max(atoi(argv[6]), 1);
+        Replica replica(hospital, argv[4]);
+        replica.start();
+        int status = runServeMode(argv[2], hospital, workers, true);
+        replica.stop();
+        ReplicaStatus followed = replica.status();
+        cerr << "Replica at record " << followed.lsn << " (" << followed.records << " applied)";
+        if (followed.stopped) cerr << ", refused by the primary: " << followed.error;
+        cerr << "\n";
+        return status;
+    }
+
+    // State is persisted in HMS_DATA_DIR (default: the current directory)
+    const char* dataDir = getenv("HMS_DATA_DIR");
+    if (hospital.open(dataDir ? dataDir : ".") != HmsStatus::Ok) {
+        cout<<"Stored HMS data is damaged or unreadable. Refusing to start.\n";
+        return 1;
+    }
+
+    // Prices are read from tariffs.txt next to the data
+    string dataPath = dataDir ? dataDir : ".";
+    Tariffs tariffs;
+    string tariffError;
+    if (!tariffs.loadFile(dataPath + "/tariffs.txt", tariffError)) {
+        cerr << "tariffs.txt " << tariffError << "\n";
+        return 1;
+    }
+
+    // HMS --bill [--from DATE] [--to DATE] [--threads N] writes an invoice
+    // for every patient discharged in the date range as JSON lines
+    if (argc >= 2 && string(argv[1]) == "--bill") {
+        string fromDate, toDate;
+        unsigned threads = thread::hardware_concurrency();
+        for (int i = 2; i + 1 < argc; i += 2) {
+            string option = argv[i];
+            if (option == "--from") fromDate = argv[i + 1];
+            else if (option == "--to") toDate = argv[i + 1];
+            else if (option == "--threads") threads = (unsigned)max(atoi(argv[i + 1]), 1);
+        }
+        ios::sync_with_stdio(false);
+        BillingSummary summary = BillingEngine(hospital, tariffs).run(fromDate, toDate, cout, threads);
+        cout.flush();
+        cerr << summary.invoices << " invoices, total Pkr" << formatAmount(summary.total) << ", " << fixed
+             << setprecision(3) << summary.seconds << " s\n";
+        hospital.close();
+        return 0;
+    }
+
+    // HMS --report occupancy|stays|load|heatmap|all [--from DATE] [--to DATE]
+    // [--bucket-days N] [--threads N] prints management reports
+    if (argc >= 3 && string(argv[1]) == "--report") {
+        string fromDate, toDate;
+        int64_t bucketSeconds = 0;
+        unsigned threads = thread::hardware_concurrency();
+        for (int i = 3; i + 1 < argc; i += 2) {
+            string option = argv[i];
+            if (option == "--from") fromDate = argv[i + 1];
+            else if (option == "--to") toDate = argv[i + 1];
+            else if (option == "--bucket-days") bucketSeconds = max(atoll(argv[i + 1]), 1LL) * 86400;
+            else if (option == "--threads") threads = (unsigned)max(atoi(argv[i + 1]), 1);
+        }
+        TimeRange range;
+        if (!parseDateRange(fromDate, toDate, range)) {
+            cerr << "Dates must be written as YYYY-MM-DD.\n";
+            return 1;
+        }
+        auto started = chrono::steady_clock::now();
+        AnalyticsStore store;
+        store.load(hospital);
+        auto loaded = chrono::steady_clock::now();
+        if (!printReport(AnalyticsEngine(store, threads), argv[2], range, bucketSeconds, cout)) {
+            cerr << "Unknown report " << argv[2] << "; expected occupancy, stays, load, heatmap or all\n";
+            return 1;
+        }
+        auto finished = chrono::steady_clock::now();
+        cerr << store.rows() << " rows, loaded in " << fixed << setprecision(3)
+             << chrono::duration<double>(loaded - started).count() << " s, reported in "
+             << chrono::duration<double>(finished - loaded).count() << " s\n";
+        hospital.close();
+        return 0;
+    }
+
+    // HMS --batch FILE [--desks N] runs a command script instead of the menus
+    if ((argc == 3 || (argc == 5 && string(argv[3]) == "--desks")) && string(argv[1]) == "--batch") {
+        int desks = argc == 5 ? atoi(argv[4]) : 1;
+        int status = runBatchMode(argv[2], hospital, desks > 0 ? desks : 1);
+        if (hospital.checkpoint() != HmsStatus::Ok) {
+            cerr << "Warning: could not write snapshot; changes remain in the log.\n";
+        }
+        hospital.close();
+        return status;
+    }
 
-    vector<Staff> staffList;
+    // HMS --import FILE... [--threads N] loads rooms, staff and patients in
+    // one step; see importer.h
+    if (argc >= 3 && string(argv[1]) == "--import") {
+        vector<string> paths;
+        unsigned threads = max(thread::hardware_concurrency(), 1u);
+        for (int i = 2; i < argc; ++i) {
+            if (string(argv[i]) == "--threads" && i + 1 < argc) threads = (unsigned)max(atoi(argv[++i]), 1);
+            else paths.push_back(argv[i]);
+        }
+        if (paths.empty()) {
+            cerr << "--import needs at least one file\n";
+            return 1;
+        }
+        int status = runImportMode(paths, hospital, threads);
+        if (hospital.checkpoint() != HmsStatus::Ok) {
+            cerr << "Warning: could not write snapshot; changes remain in the log.\n";
+        }
+        hospital.close();
+        return status;
+    }
+
+    // HMS --serve ADDRESS[,ADDRESS...] [--workers N] answers batch commands
+    // over TCP or Unix sockets until SIGINT or SIGTERM; see server.h
+    if ((argc == 3 || (argc == 5 && string(argv[3]) == "--workers")) && string(argv[1]) == "--serve") {
+        unsigned workers = max(thread::hardware_concurrency(), 2u) - 1;
+        if (argc == 5) workers = (unsigned)max(atoi(argv[4]), 1);
+        int status = runServeMode(argv[2], hospital, workers);
+        if (hospital.checkpoint() != HmsStatus::Ok) {
+            cerr << "Warning: could not write snapshot; changes remain in the log.\n";
+        }
+        hospital.close();
+        return status;
+    }
+    bool restored = !hospital.empty();
 
     char start;
-    do {
+    if (restored) {
         cout<<"Thank You For Choosing Hospital Management System (HMS)!\n";
-        cout<<"Press 'E' to Begin Setup: ";
-        cin>>start;
-    }while(start!='E'&&start!='e');
+        cout<<"Restored "<<hospital.departments().size()<<" departments, "<<hospital.rooms().size()<<" room types, "
+            <<hospital.staff().size()<<" staff and "<<hospital.patients().size()<<" patients.\n";
+        do {
+            cout<<"Press 'E' to Edit Setup or 'C' to Continue: ";
+            cin>>start;
+        }while(start!='E'&&start!='e'&&start!='C'&&start!='c');
+    } else {
+        do {
+            cout<<"Thank You For Choosing Hospital Management System (HMS)!\n";
+            cout<<"Press 'E' to Begin Setup: ";
+            cin>>start;
+        }while(start!='E'&&start!='e');
+    }
 
-    short choice;
-    do{
+    short choice = (start=='C'||start=='c') ? 4 : 0;
+    while (choice != 4) {
         
         cout<<"\n********** Configuration Menu **********\n";
         cout<<"1. Services\t2. Rooms\t3. Staff\t4. Exit\n";
@@ -635,13 +864,13 @@ int main() {
 
         switch (choice){
         case 1:
-            configureServices();
+            configureServices(hospital);
             break;
         case 2:
-            configureRooms(rooms);
+            configureRooms(hospital);
             break;
         case 3:
-            configureStaff(doctors,nurses,technicians);
+            configureStaff(hospital);
             break;
         case 4:
             cout<<"Exiting configuration...\n";
@@ -649,14 +878,16 @@ int main() {
         default:
             cout<<"Invalid choice. Please enter a number between 1 and 4.\n";
         }
-    } while (choice != 4);
+    }
     
     short choice2;
     string id; 
     
-    //vector to hold all staff 
-    vector<Staff*> allStaff;
     do {
+        if (hospital.checkpointDue()) {
+            hospital.checkpoint();
+        }
+
         cout << "\n********** Main Menu **********\n";
     
         cout<<"1. Patient Intake\n";       
@@ -665,48 +896,49 @@ int main() {
         cout<<"4. Staff Scheduling\n";
         cout<<"5. Room Managemnt\n";          
         cout<<"6. Exit\n";
+        cout<<"7. Statistics\n";
+        cout<<"8. Reports\n";
+        cout<<"9. Status Board\n";
         cout<<"============================================\n";
         cout<<"Enter your choice: ";
 
         cin >> choice2;
         
-        // Search for the staff member by name
-        Staff* selectedStaffMember = nullptr;
         // Search for the patient by name
         Patient* selectedPatient = nullptr;
         
 
         switch (choice2) {
         case 1:
-            registerPatient(patientList);
+            registerPatient(hospital);
             break;
         case 2:
-            managePatients(patientList, doctors, nurses, technicians, rooms);
+            managePatients(hospital);
             break;
             
         case 3: {
     cout << "\nDischarging a patient...\n";
-    cout << "List of all patients:\n";
-    for (size_t i = 0; i < patientList.size(); ++i) {
-        cout << i + 1 << ". " << patientList[i].name << "\n";
-    }
-    cout << "Enter the patient's name to discharge (or '0' to go back): ";
-    cin.ignore();
-    getline(cin, id);
+    id = readWithSuggestions("Enter the patient's name to discharge, or search (or '0' to go back): ",
+                             suggestPatients(hospital));
 
     if (id == "0") {
         cout << "Returning to menu...\n";
         break;
     }
 
-   Patient* selectedPatient = nullptr;
-   for (auto& patient : patientList) {
-    if (patient.name == id) { 
-        selectedPatient = &patient;
-        break;
-    }
-}
-   if (selectedPatient) {
+   Patient* selectedPatient = hospital.findPatientByName(id);
+   if (!selectedPatient) selectedPatient = hospital.findPatient(id);
+   if (!selectedPatient) selectedPatient = pickSearchResult(hospital, id);
+   if (selectedPatient && !selectedPatient->hospitalized) {
+    cout << "Patient is not hospitalized.\n";
+   } else if (selectedPatient && !tariffs.empty()) {
+    // Charges come from the recorded stay and appointments
+    hospital.discharge(*selectedPatient, time(0));
+    Screen screen;
+    screen << "\n--- Patient Discharge Summary ---\n";
+    displayPatientChart(*selectedPatient, screen.out());
+    displayInvoice(BillingEngine(hospital, tariffs).price(*selectedPatient), screen.out());
+   } else if (selectedPatient) {
     cout << "\n--- Patient Discharge Summary ---\n";
     displayPatientChart(*selectedPatient); 
 
@@ -725,10 +957,7 @@ int main() {
     cout << "Total cost: Pkr" << totalCost << "\n";
 
     // Update patient data
-    selectedPatient->dischargeDate = getCurrentDateTime();
-    selectedPatient->hospitalized = false;
-    string log = "Discharged on " + selectedPatient->dischargeDate;
-    selectedPatient->history.push_back(log);
+    hospital.discharge(*selectedPatient, time(0));
 
    
 } else {
@@ -739,40 +968,47 @@ int main() {
 
 
     case 4: {
-        manageStaffSchedules(doctors, nurses, technicians);
+        manageStaffSchedules(hospital);
     break;
     }
 
     case 5: {
-    cout << "\n--- Room Management ---\n";
-    cout << "+-------------------+--------+------------+------------+\n";
-    cout << "| Room Type         | Total  | Occupied   | Available  |\n";
-    cout << "+-------------------+--------+------------+------------+\n";
-
-    for (const auto& room : rooms) {
-        cout << "| " << setw(17) << left << room.type
-             << "| " << setw(6) << room.totalRooms
-             << "| " << setw(10) << room.occupiedRooms
-             << "| " << setw(10) << room.availableRooms() << " |\n";
+    const vector<Room>& rooms = hospital.rooms();
+    {
+        Screen screen;
+        screen << "\n--- Room Management ---\n";
+        displayRoomTable(hospital.statusBoard(time(0)).rooms, screen.out());
     }
 
-    cout << "+-------------------+--------+------------+------------+\n";
-
-    // Optional: Allow updating room data
-    cout << "Would you like to update room details? (y/n): ";
+    // Optional: Allow updating room data, or keep the table on screen
+    cout << "Would you like to update room details? (y/n, 'w' to watch): ";
     char updateChoice;
     cin >> updateChoice;
+    if (tolower(updateChoice) == 'w') {
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        watch([&hospital](ostream& out) {
+            out << setw(60) << right << getCurrentDateTime() << "\n--- Room Management ---\n";
+            displayRoomTable(hospital.statusBoard(time(0)).rooms, out);
+            out << "Press Enter to stop watching.\n";
+        });
+        break;
+    }
     if (tolower(updateChoice) == 'y') {
         int roomIndex;
         cout << "Enter the room index to update (1 to " << rooms.size() << "): ";
         cin >> roomIndex;
         if (roomIndex > 0 && roomIndex <= rooms.size()) {
-            Room& selectedRoom = rooms[roomIndex - 1];
+            const Room& selectedRoom = rooms[roomIndex - 1];
+            int total, occupied;
             cout << "Enter new total number of rooms for " << selectedRoom.type << ": ";
-            cin >> selectedRoom.totalRooms;
+            cin >> total;
             cout << "Enter new number of occupied rooms for " << selectedRoom.type << ": ";
-            cin >> selectedRoom.occupiedRooms;
-            cout << "Room details updated successfully.\n";
+            cin >> occupied;
+            if (hospital.updateRoom(roomIndex - 1, total, occupied) == HmsStatus::Ok) {
+                cout << "Room details updated successfully.\n";
+            } else {
+                cout << "Invalid counts: occupied rooms must fit the total and include every bed held by a patient.\n";
+            }
         } else {
             cout << "Invalid room index.\n";
         }
@@ -782,11 +1018,48 @@ int main() {
 
    case 6:
     cout << "Exiting the program...\n";
+    if (hospital.checkpoint() != HmsStatus::Ok) {
+        cout << "Warning: could not write snapshot; changes remain in the log.\n";
+    }
+    hospital.close();
     return 0;
 
+   case 7:
+    cout << "\n--- Statistics ---\n";
+    if (!metricsEnabled()) {
+        cout << "Metrics are turned off (HMS_METRICS=0).\n";
+        break;
+    }
+    writeMetricsText(cout, collectMetrics());
+    break;
+
+   case 8:
+    reportsMenu(hospital);
+    break;
+
+   case 9: {
+    {
+        Screen screen;
+        displayStatusBoard(hospital.statusBoard(time(0)), screen.out());
+    }
+    cout << "Press 'w' to watch the board, or any other key to go back: ";
+    char watchChoice;
+    cin >> watchChoice;
+    if (tolower(watchChoice) == 'w') {
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        watch([&hospital](ostream& out) {
+            out << setw(60) << right << getCurrentDateTime();
+            displayStatusBoard(hospital.statusBoard(time(0)), out);
+            out << "Press Enter to stop watching.\n";
+        });
+    }
+    break;
+   }
+
 default:
     cout << "Invalid choice. Please try again.\n";
         }
     } while (true);
 
 }
+
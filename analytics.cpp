@@ -0,0 +1,457 @@
+#include "analytics.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace hms {
+
+namespace {
+
+const size_t BLOCK_ROWS = 1024;           // rows filtered per pass, small enough to stay in L1
+const size_t MIN_ROWS_PER_THREAD = 65536; // below this a thread costs more than it saves
+const int64_t SECONDS_PER_DAY = 86400;
+const size_t MAX_AUTO_BUCKETS = 31;
+
+int64_t floorDiv(int64_t value, int64_t divisor) {
+    return value / divisor - (value % divisor < 0);
+}
+
+double averageHours(int64_t seconds, uint64_t count) {
+    return count ? seconds / 3600.0 / count : 0;
+}
+
+// Filter passes over one block of columns: straight loops with no
+// branches. On x86-64 an AVX2 copy is built next to the baseline one and
+// picked when the program starts.
+#if defined(__x86_64__)
+#define VECTOR_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define VECTOR_KERNEL
+#endif
+
+// kept[i] = 1 when times[i] is in [from, to), else 0
+VECTOR_KERNEL
+void keepInRange(const int64_t* times, size_t count, int64_t from, int64_t to, int64_t* __restrict kept) {
+    for (size_t i = 0; i < count; ++i) kept[i] = (times[i] >= from) & (times[i] < to);
+}
+
+// Lengths of the stays discharged in [from, to), 0 for the others
+VECTOR_KERNEL
+void stayLengthsInRange(const int64_t* admitted, const int64_t* discharged, size_t count, int64_t from, int64_t to,
+                        int64_t* __restrict kept, int64_t* __restrict lengths) {
+    for (size_t i = 0; i < count; ++i) {
+        int64_t keep = (discharged[i] >= from) & (discharged[i] < to);
+        kept[i] = keep;
+        lengths[i] = (discharged[i] - admitted[i]) & -keep;
+    }
+}
+
+// Stays clipped to [from, to) with open stays ending at `now`; a stay
+// outside the range ends up with ends[i] <= starts[i]
+VECTOR_KERNEL
+void clipStays(const int64_t* admitted, const int64_t* discharged, size_t count, int64_t from, int64_t to,
+               int64_t now, int64_t* __restrict starts, int64_t* __restrict ends) {
+    for (size_t i = 0; i < count; ++i) {
+        int64_t last = discharged[i] < now ? discharged[i] : now;
+        starts[i] = admitted[i] > from ? admitted[i] : from;
+        ends[i] = last < to ? last : to;
+    }
+}
+
+VECTOR_KERNEL
+int64_t minimum(const int64_t* values, size_t count, int64_t initial) {
+    for (size_t i = 0; i < count; ++i) initial = values[i] < initial ? values[i] : initial;
+    return initial;
+}
+
+} // namespace
+
+uint16_t CodeTable::code(Symbol symbol) {
+    if (symbol.id() >= codeOf.size()) codeOf.resize(symbol.id() + 1, NONE);
+    uint16_t& code = codeOf[symbol.id()];
+    if (code == NONE) {
+        code = (uint16_t)symbolOf.size();
+        symbolOf.push_back(symbol);
+    }
+    return code;
+}
+
+uint16_t CodeTable::find(Symbol symbol) const {
+    return symbol.id() < codeOf.size() ? codeOf[symbol.id()] : NONE;
+}
+
+void CodeTable::clear() {
+    symbolOf.clear();
+    codeOf.clear();
+}
+
+bool parseDateRange(const string& fromDate, const string& toDate, TimeRange& range) {
+    range = TimeRange();
+    if (!fromDate.empty()) {
+        range.from = fromDate.size() == 10 ? civilSeconds(fromDate) : -1;
+        if (range.from < 0) return false;
+    }
+    if (!toDate.empty()) {
+        int64_t day = toDate.size() == 10 ? civilSeconds(toDate) : -1;
+        if (day < 0) return false;
+        range.to = day + SECONDS_PER_DAY;
+    }
+    return true;
+}
+
+void AnalyticsStore::clear() {
+    departments.clear();
+    roomTypes.clear();
+    beds.clear();
+    stays = Stays();
+    appointments = Appointments();
+    staff = StaffRows();
+}
+
+void AnalyticsStore::addStay(int64_t admitted, int64_t discharged, uint16_t roomType, uint16_t department) {
+    stays.admitted.push_back(admitted);
+    stays.discharged.push_back(discharged);
+    stays.roomType.push_back(roomType);
+    stays.department.push_back(department);
+}
+
+void AnalyticsStore::addAppointment(int64_t when, int32_t staffRow, uint16_t department) {
+    appointments.when.push_back(when);
+    appointments.staff.push_back(staffRow);
+    appointments.department.push_back(department);
+}
+
+void AnalyticsStore::addStaff(const string& name, Symbol department, StaffRole role, const Timetable& timetable) {
+    staff.name.push_back(name);
+    staff.department.push_back(department.empty() ? CodeTable::NONE : departments.code(department));
+    staff.role.push_back((uint8_t)role);
+    for (int hour = 0; hour < HOURS_IN_DAY; ++hour) {
+        uint16_t working = 0, booked = 0;
+        for (int day = 0; day < timetable.dayCount(); ++day) {
+            working += !timetable.isFree(hour, day);
+            booked += timetable.state(timetable.slotOf(hour, day)) == SlotState::Appointment;
+        }
+        staff.onShift.push_back(working);
+        staff.booked.push_back(booked);
+    }
+}
+
+void AnalyticsStore::load(const Hospital& hospital) {
+    clear();
+    loadedAt = civilSeconds(time(0));
+    for (Symbol department : hospital.departments()) departments.code(department);
+    for (const Room& room : hospital.rooms()) {
+        uint16_t type = roomTypes.code(room.type);
+        beds.resize(roomTypes.size());
+        beds[type] = room.totalRooms;
+    }
+
+    const StaffDirectory& directory = hospital.staff();
+    for (size_t row = 0; row < directory.size(); ++row) {
+        addStaff(directory.names()[row], directory.departments()[row], directory.roles()[row],
+                 directory.timetables()[row]);
+    }
+    int32_t staffRows = (int32_t)staff.name.size();
+
+    // Room types of active histories are interned event subjects
+    unordered_map<uint32_t, uint16_t> roomOfSubject;
+    auto roomCode = [&](uint32_t subject) {
+        auto it = roomOfSubject.find(subject);
+        if (it != roomOfSubject.end()) return it->second;
+        uint16_t type = roomTypes.code(eventStore.name(subject));
+        roomOfSubject.emplace(subject, type);
+        return type;
+    };
+
+    // Cancelled appointments and the cancellations are left out
+    vector<BookingEvent> bookings;
+    vector<char> undone;
+    for (const Patient& patient : hospital.patients()) {
+        uint16_t department = departments.code(patient.department);
+        bookings.clear();
+        patient.history.forEach([&](const HistoryEvent& event) {
+            bookings.push_back({event.kind, civilSeconds((time_t)event.epoch) / 60, event.hour, (uint64_t)event.staffId});
+        });
+        matchCancellations(bookings, undone);
+        int64_t admitted = -1;
+        uint16_t room = 0;
+        size_t index = 0;
+        patient.history.forEach([&](const HistoryEvent& event) {
+            if (undone[index++]) return;
+            switch (event.kind) {
+            case EventKind::Hospitalized:
+                admitted = civilSeconds((time_t)event.epoch);
+                room = roomCode(event.subject);
+                break;
+            case EventKind::Discharged:
+                if (admitted >= 0) addStay(admitted, civilSeconds((time_t)event.epoch), room, department);
+                admitted = -1;
+                break;
+            case EventKind::Appointment:
+                addAppointment(civilSeconds((time_t)event.epoch),
+                               event.staffId >= 0 && event.staffId < staffRows ? event.staffId : -1, department);
+                break;
+            default:
+                break;
+            }
+        });
+        if (admitted >= 0) addStay(admitted, STILL_ADMITTED, room, department);
+    }
+
+    if (const PatientArchive* archive = hospital.patients().archive()) {
+        string name;
+        vector<ArchivedEvent> events;
+        archive->forEach([&](const ArchivedPatient& record) {
+            name.assign(record.field(ArchivedPatient::Department));
+            uint16_t department = departments.code(name);
+            events.clear();
+            bookings.clear();
+            for (uint32_t i = 0; i < record.historyCount(); ++i) {
+                events.push_back(record.event(i));
+                const ArchivedEvent& event = events.back();
+                bookings.push_back({event.kind, civilSeconds((time_t)event.epoch) / 60, event.hour, (uint64_t)event.staffId});
+            }
+            matchCancellations(bookings, undone);
+            int64_t admitted = -1;
+            uint16_t room = 0;
+            for (size_t i = 0; i < events.size(); ++i) {
+                const ArchivedEvent& event = events[i];
+                if (undone[i]) continue;
+                int64_t civil = civilSeconds((time_t)event.epoch);
+                if (event.kind == EventKind::Hospitalized) {
+                    admitted = civil;
+                    name.assign(event.subject);
+                    room = roomTypes.code(name);
+                } else if (event.kind == EventKind::Discharged) {
+                    if (admitted >= 0) addStay(admitted, civil, room, department);
+                    admitted = -1;
+                } else if (event.kind == EventKind::Appointment) {
+                    addAppointment(civil, event.staffId >= 0 && event.staffId < staffRows ? event.staffId : -1, department);
+                }
+            }
+        });
+    }
+    beds.resize(roomTypes.size()); // types seen only in history have no beds now
+}
+
+AnalyticsEngine::AnalyticsEngine(const AnalyticsStore& store, unsigned threads)
+    : store(store), threads(threads ? threads : 1) {}
+
+// Runs kernel(begin, end, partial) over contiguous shares of [0, rows),
+// one per thread, each with its own copy of `initial`
+template <class Partial, class Kernel>
+vector<Partial> AnalyticsEngine::scan(size_t rows, const Partial& initial, Kernel kernel) const {
+    size_t shares = max<size_t>(1, min<size_t>(threads, rows / MIN_ROWS_PER_THREAD));
+    vector<Partial> partials(shares, initial);
+    vector<thread> workers;
+    for (size_t s = 0; s < shares; ++s) {
+        size_t begin = rows * s / shares, end = rows * (s + 1) / shares;
+        if (s + 1 == shares) kernel(begin, end, partials[s]);
+        else workers.emplace_back([&kernel, &partials, s, begin, end] { kernel(begin, end, partials[s]); });
+    }
+    for (auto& worker : workers) worker.join();
+    return partials;
+}
+
+OccupancyReport AnalyticsEngine::occupancy(TimeRange range, int64_t bucketSeconds) const {
+    const AnalyticsStore::Stays& stays = store.stays;
+    size_t rows = stays.admitted.size();
+    OccupancyReport report;
+    for (uint16_t type = 0; type < store.roomTypes.size(); ++type) {
+        report.roomTypes.push_back(store.roomTypes.name(type));
+        report.beds.push_back(type < store.beds.size() ? store.beds[type] : 0);
+    }
+
+    if (range.from == INT64_MIN) {
+        vector<int64_t> firsts = scan(rows, INT64_MAX, [&](size_t begin, size_t end, int64_t& first) {
+            first = minimum(stays.admitted.data() + begin, end - begin, first);
+        });
+        int64_t first = *min_element(firsts.begin(), firsts.end());
+        range.from = first == INT64_MAX ? store.loadedAt : first;
+    }
+    if (range.to == INT64_MAX) range.to = max(store.loadedAt, range.from + 1);
+    if (bucketSeconds <= 0) {
+        range.from = floorDiv(range.from, SECONDS_PER_DAY) * SECONDS_PER_DAY;
+        int64_t days = (range.to - range.from + SECONDS_PER_DAY - 1) / SECONDS_PER_DAY;
+        bucketSeconds = (days + MAX_AUTO_BUCKETS - 1) / MAX_AUTO_BUCKETS * SECONDS_PER_DAY;
+    }
+    report.from = range.from;
+    report.to = range.to;
+    report.bucketSeconds = bucketSeconds;
+    report.buckets = range.to > range.from ? (size_t)((range.to - range.from + bucketSeconds - 1) / bucketSeconds) : 0;
+    size_t types = report.roomTypes.size(), buckets = report.buckets;
+    if (buckets == 0 || types == 0) return report;
+
+    // Bed-seconds in use per room type and bucket
+    int64_t now = store.loadedAt;
+    vector<vector<int64_t>> partials =
+        scan(rows, vector<int64_t>(types * buckets), [&](size_t begin, size_t end, vector<int64_t>& used) {
+            int64_t starts[BLOCK_ROWS], ends[BLOCK_ROWS];
+            for (size_t block = begin; block < end; block += BLOCK_ROWS) {
+                size_t count = min(BLOCK_ROWS, end - block);
+                clipStays(&stays.admitted[block], &stays.discharged[block], count, range.from, range.to, now, starts, ends);
+                for (size_t i = 0; i < count; ++i) {
+                    if (ends[i] <= starts[i]) continue;
+                    int64_t* row = &used[stays.roomType[block + i] * buckets];
+                    int64_t at = starts[i];
+                    size_t bucket = (size_t)((at - range.from) / bucketSeconds);
+                    while (at < ends[i]) {
+                        int64_t boundary = range.from + (int64_t)(bucket + 1) * bucketSeconds;
+                        int64_t until = ends[i] < boundary ? ends[i] : boundary;
+                        row[bucket++] += until - at;
+                        at = until;
+                    }
+                }
+            }
+        });
+
+    report.occupiedBeds.assign(types * buckets, 0);
+    for (size_t bucket = 0; bucket < buckets; ++bucket) {
+        int64_t start = range.from + (int64_t)bucket * bucketSeconds;
+        double length = (double)(min(range.to, start + bucketSeconds) - start);
+        for (size_t type = 0; type < types; ++type) {
+            int64_t total = 0;
+            for (const auto& used : partials) total += used[type * buckets + bucket];
+            report.occupiedBeds[type * buckets + bucket] = total / length;
+        }
+    }
+    return report;
+}
+
+StayLengthReport AnalyticsEngine::stayLengths(TimeRange range) const {
+    const AnalyticsStore::Stays& stays = store.stays;
+    size_t types = store.roomTypes.size(), departments = store.departments.size();
+    // seconds then counts, by room type then by department
+    size_t width = 2 * (types + departments);
+    vector<vector<int64_t>> partials =
+        scan(stays.admitted.size(), vector<int64_t>(width), [&](size_t begin, size_t end, vector<int64_t>& totals) {
+            int64_t lengths[BLOCK_ROWS];
+            int64_t kept[BLOCK_ROWS];
+            int64_t* typeSeconds = &totals[0];
+            int64_t* typeCounts = typeSeconds + types;
+            int64_t* departmentSeconds = typeCounts + types;
+            int64_t* departmentCounts = departmentSeconds + departments;
+            for (size_t block = begin; block < end; block += BLOCK_ROWS) {
+                size_t count = min(BLOCK_ROWS, end - block);
+                stayLengthsInRange(&stays.admitted[block], &stays.discharged[block], count, range.from, range.to, kept,
+                                   lengths);
+                const uint16_t* roomType = &stays.roomType[block];
+                const uint16_t* department = &stays.department[block];
+                for (size_t i = 0; i < count; ++i) {
+                    typeSeconds[roomType[i]] += lengths[i];
+                    typeCounts[roomType[i]] += kept[i];
+                    departmentSeconds[department[i]] += lengths[i];
+                    departmentCounts[department[i]] += kept[i];
+                }
+            }
+        });
+
+    vector<int64_t> totals(width);
+    for (const auto& partial : partials) {
+        for (size_t i = 0; i < width; ++i) totals[i] += partial[i];
+    }
+    StayLengthReport report;
+    report.overall.name = "All stays";
+    int64_t allSeconds = 0;
+    for (size_t type = 0; type < types; ++type) {
+        int64_t seconds = totals[type], count = totals[types + type];
+        report.byRoomType.push_back({store.roomTypes.name((uint16_t)type), (uint64_t)count, averageHours(seconds, count)});
+        allSeconds += seconds;
+        report.overall.stays += count;
+    }
+    report.overall.averageHours = averageHours(allSeconds, report.overall.stays);
+    for (size_t department = 0; department < departments; ++department) {
+        int64_t seconds = totals[2 * types + department], count = totals[2 * types + departments + department];
+        report.byDepartment.push_back(
+            {store.departments.name((uint16_t)department), (uint64_t)count, averageHours(seconds, count)});
+    }
+    return report;
+}
+
+LoadReport AnalyticsEngine::load(TimeRange range) const {
+    const AnalyticsStore::Stays& stays = store.stays;
+    const AnalyticsStore::Appointments& appointments = store.appointments;
+    size_t departments = store.departments.size(), members = store.staff.name.size();
+
+    vector<vector<uint64_t>> admissionPartials =
+        scan(stays.admitted.size(), vector<uint64_t>(departments), [&](size_t begin, size_t end, vector<uint64_t>& admissions) {
+            int64_t kept[BLOCK_ROWS];
+            for (size_t block = begin; block < end; block += BLOCK_ROWS) {
+                size_t count = min(BLOCK_ROWS, end - block);
+                keepInRange(&stays.admitted[block], count, range.from, range.to, kept);
+                const uint16_t* department = &stays.department[block];
+                for (size_t i = 0; i < count; ++i) admissions[department[i]] += kept[i];
+            }
+        });
+
+    // Appointments by department, then by staff row + 1; slot 0 holds
+    // those whose staff member is no longer known
+    size_t width = departments + members + 1;
+    vector<vector<uint64_t>> appointmentPartials =
+        scan(appointments.when.size(), vector<uint64_t>(width), [&](size_t begin, size_t end, vector<uint64_t>& counts) {
+            int64_t kept[BLOCK_ROWS];
+            uint64_t* byDepartment = &counts[0];
+            uint64_t* byStaff = byDepartment + departments;
+            for (size_t block = begin; block < end; block += BLOCK_ROWS) {
+                size_t count = min(BLOCK_ROWS, end - block);
+                keepInRange(&appointments.when[block], count, range.from, range.to, kept);
+                const uint16_t* department = &appointments.department[block];
+                const int32_t* staff = &appointments.staff[block];
+                for (size_t i = 0; i < count; ++i) {
+                    byDepartment[department[i]] += kept[i];
+                    byStaff[staff[i] + 1] += kept[i];
+                }
+            }
+        });
+
+    vector<uint64_t> admissions(departments), totals(width);
+    for (const auto& partial : admissionPartials) {
+        for (size_t i = 0; i < departments; ++i) admissions[i] += partial[i];
+    }
+    for (const auto& partial : appointmentPartials) {
+        for (size_t i = 0; i < width; ++i) totals[i] += partial[i];
+    }
+    LoadReport report;
+    for (size_t department = 0; department < departments; ++department) {
+        report.departments.push_back(
+            {store.departments.name((uint16_t)department), admissions[department], totals[department]});
+    }
+    for (size_t row = 0; row < members; ++row) {
+        uint16_t department = store.staff.department[row];
+        report.staff.push_back({store.staff.name[row],
+                                department == CodeTable::NONE ? string() : store.departments.name(department),
+                                (StaffRole)store.staff.role[row], totals[departments + 1 + row]});
+    }
+    stable_sort(report.staff.begin(), report.staff.end(), [](const LoadReport::Member& a, const LoadReport::Member& b) {
+        return a.appointments > b.appointments;
+    });
+    return report;
+}
+
+UtilizationReport AnalyticsEngine::utilization() const {
+    const AnalyticsStore::StaffRows& staff = store.staff;
+    size_t departments = store.departments.size();
+    UtilizationReport report;
+    for (size_t department = 0; department < departments; ++department) {
+        report.departments.push_back(store.departments.name((uint16_t)department));
+    }
+    report.staff.assign(departments, 0);
+    report.onShift.assign(departments * HOURS_IN_DAY, 0);
+    report.booked.assign(departments * HOURS_IN_DAY, 0);
+    for (size_t row = 0; row < staff.name.size(); ++row) {
+        uint16_t department = staff.department[row];
+        if (department == CodeTable::NONE) continue;
+        ++report.staff[department];
+        const uint16_t* onShift = &staff.onShift[row * HOURS_IN_DAY];
+        const uint16_t* booked = &staff.booked[row * HOURS_IN_DAY];
+        uint32_t* shiftTotals = &report.onShift[department * HOURS_IN_DAY];
+        uint32_t* bookedTotals = &report.booked[department * HOURS_IN_DAY];
+        for (int hour = 0; hour < HOURS_IN_DAY; ++hour) {
+            shiftTotals[hour] += onShift[hour];
+            bookedTotals[hour] += booked[hour];
+        }
+    }
+    return report;
+}
+
+} // namespace hms
@@ -0,0 +1,172 @@
+#ifndef HMS_ANALYTICS_H
+#define HMS_ANALYTICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "hospital.h"
+
+namespace hms {
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Reports over the full patient history. AnalyticsStore derives columns
+// from the hospital: one row per stay, per appointment and per staff
+// member, with departments and room types coded as small integers and
+// times kept as civil seconds (see history.h).
+//
+// AnalyticsEngine scans the columns on several threads, each taking a
+// contiguous share of the rows. A share is read in blocks: a branch-free
+// pass over the block's columns (which the compiler vectorizes) clips and
+// filters it into flat arrays, then a second pass adds them into the
+// thread's own group totals. Totals are merged once the threads finish.
+// ---------------------------------------------------------------------------
+
+// Symbols numbered densely in order of first use, so per-group totals
+// can be plain arrays
+class CodeTable {
+public:
+    static constexpr uint16_t NONE = 0xFFFF;
+
+    uint16_t code(Symbol symbol);
+    uint16_t find(Symbol symbol) const; // NONE if never coded
+    const string& name(uint16_t code) const { return symbolOf[code].str(); }
+    size_t size() const { return symbolOf.size(); }
+    void clear();
+
+private:
+    vector<Symbol> symbolOf;
+    vector<uint16_t> codeOf; // by symbol ID
+};
+
+// Half-open span [from, to) of civil seconds
+struct TimeRange {
+    int64_t from = INT64_MIN;
+    int64_t to = INT64_MAX;
+
+    bool bounded() const { return from != INT64_MIN && to != INT64_MAX; }
+};
+
+// Whole days "YYYY-MM-DD", both inclusive; an empty date leaves that end
+// open. False if a date is malformed.
+bool parseDateRange(const string& fromDate, const string& toDate, TimeRange& range);
+
+class AnalyticsStore {
+public:
+    static const int64_t STILL_ADMITTED = INT64_MAX; // discharge time of an open stay
+
+    CodeTable departments;
+    CodeTable roomTypes;
+    vector<int> beds;     // current bed count by room type code
+    int64_t loadedAt = 0; // civil time the store was loaded
+
+    struct Stays {
+        vector<int64_t> admitted;
+        vector<int64_t> discharged;
+        vector<uint16_t> roomType;
+        vector<uint16_t> department; // the patient's
+    } stays;
+
+    struct Appointments {
+        vector<int64_t> when;        // when it was booked
+        vector<int32_t> staff;       // staff row, -1 if unknown
+        vector<uint16_t> department; // the patient's
+    } appointments;
+
+    // Staff rows follow the directory's hiring order, so a row is the
+    // member's Staff::id
+    struct StaffRows {
+        vector<string> name;
+        vector<uint16_t> department; // CodeTable::NONE if unassigned
+        vector<uint8_t> role;        // StaffRole
+        vector<uint16_t> onShift;    // days working each hour, [row * HOURS_IN_DAY + hour]
+        vector<uint16_t> booked;     // days with an appointment each hour, same layout
+    } staff;
+
+    // Rebuilds every column from the hospital's rooms, staff, active and
+    // archived patients. Must not run alongside changes to the hospital.
+    void load(const Hospital& hospital);
+    void clear();
+
+    void addStay(int64_t admitted, int64_t discharged, uint16_t roomType, uint16_t department);
+    void addAppointment(int64_t when, int32_t staffRow, uint16_t department);
+    void addStaff(const string& name, Symbol department, StaffRole role, const Timetable& timetable);
+
+    size_t rows() const { return stays.admitted.size() + appointments.when.size() + staff.name.size(); }
+};
+
+struct OccupancyReport {
+    int64_t from = 0;             // civil start of the first bucket
+    int64_t to = 0;               // end of the last, which may be short
+    int64_t bucketSeconds = 86400;
+    size_t buckets = 0;
+    vector<string> roomTypes;
+    vector<int> beds;
+    vector<double> occupiedBeds; // average beds in use, [roomType * buckets + bucket]
+};
+
+struct StayLengthReport {
+    struct Row {
+        string name;
+        uint64_t stays = 0;
+        double averageHours = 0;
+    };
+    Row overall;
+    vector<Row> byRoomType;
+    vector<Row> byDepartment;
+};
+
+struct LoadReport {
+    struct Department {
+        string name;
+        uint64_t admissions = 0;
+        uint64_t appointments = 0;
+    };
+    struct Member {
+        string name;
+        string department;
+        StaffRole role;
+        uint64_t appointments = 0;
+    };
+    vector<Department> departments;
+    vector<Member> staff; // busiest first
+};
+
+struct UtilizationReport {
+    vector<string> departments;
+    vector<uint32_t> staff;   // members by department
+    vector<uint32_t> onShift; // member-days on shift, [department * HOURS_IN_DAY + hour]
+    vector<uint32_t> booked;  // of those, booked with an appointment
+};
+
+class AnalyticsEngine {
+public:
+    AnalyticsEngine(const AnalyticsStore& store, unsigned threads);
+
+    // Average beds in use by room type over buckets of `bucketSeconds`.
+    // An open range is closed by the first admission and the load time;
+    // bucketSeconds 0 picks whole days, enough for at most 31 buckets.
+    OccupancyReport occupancy(TimeRange range, int64_t bucketSeconds = 0) const;
+
+    // Stays that ended in the range
+    StayLengthReport stayLengths(TimeRange range) const;
+
+    // Admissions and appointments booked in the range
+    LoadReport load(TimeRange range) const;
+
+    // Staffed and booked hours of the day from the timetables
+    UtilizationReport utilization() const;
+
+private:
+    const AnalyticsStore& store;
+    unsigned threads;
+
+    template <class Partial, class Kernel>
+    vector<Partial> scan(size_t rows, const Partial& initial, Kernel kernel) const;
+};
+
+} // namespace hms
+
+#endif // HMS_ANALYTICS_H
@@ -0,0 +1,336 @@
+#ifndef HMS_ARCHIVE_H
+#define HMS_ARCHIVE_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "binary_io.h"
+#include "patient.h"
+
+namespace hms {
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Read-only archive of closed (discharged) patient records. The files are
+// memory-mapped and records are read in place; nothing is deserialized into
+// Patient objects. Records are only ever appended; a checkpoint writes the
+// new records after the old ones and rewrites just the ID index.
+//
+// Layout (little-endian):
+//   archive  magic "HMSARC03", then the records back to back
+//   record   u32 record length, i32 age, u32 history count, one
+//            {i64 epoch, i32 staff ID, i8 hour, u8 kind, 2 zero bytes} per history
+//            event, u32 end offset of each text field, then the text bytes.
+//            Text fields: id, name, reason, department, room type,
+//            hospitalization date, discharge date, then the subject of each
+//            history event (staff name, room type or note text)
+//   index    separate file: magic "HMSIDX01", u64 record count, u64 end of
+//            the last record, then one {u64 id hash, u64 record offset} per
+//            record, sorted by hash. Bytes past that end are an append that
+//            never committed and are overwritten by the next one.
+// ---------------------------------------------------------------------------
+
+// Flushes the directory holding `path`, so that a rename into it survives
+// a crash
+inline bool syncDirectoryOf(const string& path) {
+    size_t slash = path.rfind('/');
+    string directory = slash == string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+// A history event of an archived record, as HistoryEvent with the
+// subject's text in place of its interned ID
+struct ArchivedEvent {
+    int64_t epoch = 0;
+    int32_t staffId = -1;
+    int hour = -1;
+    EventKind kind = EventKind::Note;
+    string_view subject;
+};
+
+// View of one record inside a mapped archive
+class ArchivedPatient {
+public:
+    enum Field { Id, Name, Reason, Department, RoomType, HospitalizationDate, DischargeDate, FIXED_FIELDS };
+    static const size_t EVENT_SIZE = 16;
+
+    ArchivedPatient(const char* record = nullptr) : record(record) {}
+
+    bool valid() const { return record != nullptr; }
+    int age() const { return (int)read32(4); }
+    uint32_t historyCount() const { return read32(8); }
+
+    string_view field(Field which) const { return text(which); }
+    string_view id() const { return text(Id); }
+    string_view name() const { return text(Name); }
+
+    ArchivedEvent event(uint32_t i) const {
+        const char* entry = record + 12 + i * EVENT_SIZE;
+        ArchivedEvent event;
+        memcpy(&event.epoch, entry, 8);
+        memcpy(&event.staffId, entry + 8, 4);
+        event.hour = (int8_t)entry[12];
+        event.kind = (EventKind)entry[13];
+        event.subject = text(FIXED_FIELDS + i);
+        return event;
+    }
+
+    // The readable text of history event i
+    string history(uint32_t i) const {
+        ArchivedEvent entry = event(i);
+        return renderEvent(entry.kind, (time_t)entry.epoch, entry.hour, entry.subject);
+    }
+
+    // Bytes of the whole record
+    string_view raw() const { return string_view(record, read32(0)); }
+
+private:
+    const char* record;
+
+    uint32_t read32(size_t offset) const {
+        uint32_t value;
+        memcpy(&value, record + offset, sizeof(value));
+        return value;
+    }
+
+    string_view text(uint32_t i) const {
+        const size_t tableStart = 12 + historyCount() * EVENT_SIZE;
+        size_t fields = FIXED_FIELDS + historyCount();
+        const char* strings = record + tableStart + fields * 4;
+        uint32_t begin = i == 0 ? 0 : read32(tableStart + (i - 1) * 4);
+        uint32_t end = read32(tableStart + i * 4);
+        return string_view(strings + begin, end - begin);
+    }
+};
+
+class PatientArchive {
+public:
+    static constexpr const char* MAGIC = "HMSARC03";
+    static constexpr const char* INDEX_MAGIC = "HMSIDX01";
+    static const size_t HEADER_SIZE = 8;
+    static const size_t INDEX_HEADER_SIZE = 24;
+
+    ~PatientArchive() { unmap(); }
+
+    // Maps an existing archive; a missing file is an empty archive
+    bool open(const string& archivePath) {
+        unmap();
+        path = archivePath;
+        if (!map(path, base, length)) return false;
+        if (!map(indexPath(), index, indexLength)) {
+            unmap();
+            return false;
+        }
+        // Records without an index are an append that never committed
+        bool ok = (!base || (length >= HEADER_SIZE && memcmp(base, MAGIC, 8) == 0)) &&
+                  (!index || (base && indexLength >= INDEX_HEADER_SIZE && memcmp(index, INDEX_MAGIC, 8) == 0 &&
+                              indexLength == INDEX_HEADER_SIZE + size() * 16 && recordsEnd() <= length));
+        if (!ok) unmap();
+        return ok;
+    }
+
+    size_t size() const { return index ? (size_t)read64(index, 8) : 0; }
+    bool empty() const { return size() == 0; }
+
+    ArchivedPatient findById(string_view id) const {
+        if (!base) return ArchivedPatient();
+        uint64_t hash = fnv1a64(id.data(), id.size());
+        size_t lo = 0, hi = size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (indexHash(mid) < hash) lo = mid + 1;
+            else hi = mid;
+        }
+        for (; lo < size() && indexHash(lo) == hash; ++lo) {
+            ArchivedPatient record(base + indexOffset(lo));
+            if (record.id() == id) return record;
+        }
+        return ArchivedPatient();
+    }
+
+    bool contains(string_view id) const { return findById(id).valid(); }
+
+    // Visits records in file order
+    template <class Visitor>
+    void forEach(Visitor visit) const {
+        if (!base || !index) return;
+        size_t offset = HEADER_SIZE;
+        for (size_t i = 0; i < size(); ++i) {
+            ArchivedPatient record(base + offset);
+            visit(record);
+            offset += record.raw().size();
+        }
+    }
+
+    // Appends `closed` after the existing records, then writes a new index
+    // and remaps. Old records are neither read nor moved; patients whose ID
+    // is archived already are not added again.
+    bool append(const vector<const Patient*>& closed) {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+        if (fd < 0) return false;
+        bool created = !base;
+        uint64_t offset = base && index ? recordsEnd() : HEADER_SIZE;
+        string buffer;
+        if (created) buffer.assign(MAGIC, 8);
+        uint64_t writeAt = created ? 0 : offset;
+
+        vector<pair<uint64_t, uint64_t>> added;
+        bool ok = ftruncate(fd, (off_t)writeAt) == 0;
+        auto flush = [&]() {
+            ok = ok && writeAllAt(fd, buffer, writeAt);
+            writeAt += buffer.size();
+            buffer.clear();
+        };
+        for (const Patient* patient : closed) {
+            if (contains(patient->id)) continue;
+            string record = encode(*patient);
+            added.push_back({fnv1a64(patient->id.data(), patient->id.size()), offset});
+            buffer.append(record);
+            offset += record.size();
+            if (buffer.size() >= (1 << 20)) flush();
+        }
+        flush();
+        ok = ok && fsync(fd) == 0;
+        ::close(fd);
+        // A new archive file has to be in the directory before an index
+        // that points into it
+        ok = ok && (!created || syncDirectoryOf(path));
+        if (!ok) return false;
+
+        // Merge the new entries into the sorted index
+        sort(added.begin(), added.end());
+        size_t count = size() + added.size();
+        BinaryWriter out;
+        out.bytes.reserve(INDEX_HEADER_SIZE + count * 16);
+        out.bytes.append(INDEX_MAGIC, 8);
+        out.u64(count);
+        out.u64(offset);
+        size_t old = 0, fresh = 0;
+        while (old < size() || fresh < added.size()) {
+            if (fresh == added.size() || (old < size() && indexHash(old) <= added[fresh].first)) {
+                out.u64(indexHash(old));
+                out.u64(indexOffset(old));
+                ++old;
+            } else {
+                out.u64(added[fresh].first);
+                out.u64(added[fresh].second);
+                ++fresh;
+            }
+        }
+
+        string tempPath = indexPath() + ".tmp";
+        fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        ok = writeAllAt(fd, out.bytes, 0) && fsync(fd) == 0;
+        ::close(fd);
+        if (!ok || rename(tempPath.c_str(), indexPath().c_str()) != 0) return false;
+        // The new index is in place either way, so it is mapped either way
+        bool durable = syncDirectoryOf(path);
+        return open(path) && durable;
+    }
+
+private:
+    string path;
+    const char* base = nullptr;
+    size_t length = 0;
+    const char* index = nullptr;
+    size_t indexLength = 0;
+
+    string indexPath() const { return path + ".index"; }
+
+    static uint64_t read64(const char* from, size_t offset) {
+        uint64_t value;
+        memcpy(&value, from + offset, sizeof(value));
+        return value;
+    }
+
+    uint64_t recordsEnd() const { return read64(index, 16); }
+    uint64_t indexHash(size_t i) const { return read64(index, INDEX_HEADER_SIZE + i * 16); }
+    uint64_t indexOffset(size_t i) const { return read64(index, INDEX_HEADER_SIZE + i * 16 + 8); }
+
+    // Maps a whole file read-only; a missing or empty file maps to nullptr
+    static bool map(const string& file, const char*& to, size_t& size) {
+        int fd = ::open(file.c_str(), O_RDONLY);
+        if (fd < 0) return errno == ENOENT;
+        struct stat info;
+        bool ok = fstat(fd, &info) == 0;
+        if (ok && info.st_size > 0) {
+            void* mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            ok = mapped != MAP_FAILED;
+            if (ok) {
+                to = (const char*)mapped;
+                size = (size_t)info.st_size;
+            }
+        }
+        ::close(fd);
+        return ok;
+    }
+
+    void unmap() {
+        if (base) munmap((void*)base, length);
+        if (index) munmap((void*)index, indexLength);
+        base = index = nullptr;
+        length = indexLength = 0;
+    }
+
+    static bool writeAllAt(int fd, const string& bytes, uint64_t at) {
+        size_t written = 0;
+        while (written < bytes.size()) {
+            ssize_t n = pwrite(fd, bytes.data() + written, bytes.size() - written, (off_t)(at + written));
+            if (n <= 0) return false;
+            written += (size_t)n;
+        }
+        return true;
+    }
+
+    static string encode(const Patient& patient) {
+        vector<HistoryEvent> events;
+        patient.history.forEach([&events](const HistoryEvent& event) { events.push_back(event); });
+        vector<const string*> texts = {&patient.id, &patient.name, &patient.reasonForVisit, &patient.department.str(),
+                                       &patient.roomType.str(), &patient.hospitalizationDate, &patient.dischargeDate};
+        static const string none;
+        for (const HistoryEvent& event : events) {
+            texts.push_back(event.kind == EventKind::Discharged ? &none : &eventStore.name(event.subject));
+        }
+
+        BinaryWriter out;
+        out.u32(0); // length, patched below
+        out.i32(patient.age);
+        out.u32((uint32_t)events.size());
+        for (const HistoryEvent& event : events) {
+            out.i64(event.epoch);
+            out.i32(event.staffId);
+            out.u8((uint8_t)event.hour);
+            out.u8((uint8_t)event.kind);
+            out.u8(0);
+            out.u8(0);
+        }
+        uint32_t end = 0;
+        for (const string* text : texts) {
+            end += (uint32_t)text->size();
+            out.u32(end);
+        }
+        for (const string* text : texts) out.bytes.append(*text);
+        uint32_t total = (uint32_t)out.bytes.size();
+        memcpy(&out.bytes[0], &total, sizeof(total));
+        return out.bytes;
+    }
+};
+
+
+} // namespace hms
+
+#endif // HMS_ARCHIVE_H
@@ -0,0 +1,346 @@
+#include "batch.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <string_view>
+#include <thread>
+
+namespace hms {
+
+namespace {
+
+bool fail(string& error, const string& reason) {
+    error = reason;
+    return false;
+}
+
+bool check(HmsStatus status, string& error) {
+    if (status == HmsStatus::Ok) return true;
+    return fail(error, statusMessage(status));
+}
+
+bool arity(const vector<string>& f, size_t expected, string& error) {
+    if (f.size() == expected) return true;
+    return fail(error, f[0] + " expects " + to_string(expected - 1) + " fields");
+}
+
+bool toInt(const string& text, int& value, string& error) {
+    char* end = nullptr;
+    long parsed = strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0') return fail(error, "not a number: " + text);
+    value = (int)parsed;
+    return true;
+}
+
+bool toRole(const string& text, StaffRole& role, string& error) {
+    if (text == "doctor") role = StaffRole::Doctor;
+    else if (text == "nurse") role = StaffRole::Nurse;
+    else if (text == "technician") role = StaffRole::Technician;
+    else return fail(error, "unknown staff role " + text);
+    return true;
+}
+
+} // namespace
+
+BatchSummary BatchRunner::run(istream& in, ostream& status) {
+    BatchSummary summary;
+    auto started = chrono::steady_clock::now();
+    string line, error;
+    size_t lineNumber = 0;
+    while (getline(in, line)) {
+        ++lineNumber;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        if (hospital.checkpointDue()) hospital.checkpoint();
+        error.clear();
+        ++summary.commands;
+        if (execute(line, error)) {
+            status << lineNumber << " OK\n";
+        } else {
+            ++summary.failed;
+            status << lineNumber << " ERROR " << error << "\n";
+        }
+    }
+    summary.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    return summary;
+}
+
+BatchSummary BatchRunner::run(istream& in, ostream& status, unsigned desks) {
+    if (desks <= 1) return run(in, status);
+    BatchSummary summary;
+    auto started = chrono::steady_clock::now();
+    vector<string> lines;
+    vector<size_t> lineNumbers;
+    string line;
+    for (size_t lineNumber = 1; getline(in, line); ++lineNumber) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        lines.push_back(line);
+        lineNumbers.push_back(lineNumber);
+    }
+    vector<string> errors(lines.size());
+    vector<char> succeeded(lines.size());
+    vector<size_t> deskOf(lines.size());
+
+    string patientId;
+    size_t next = 0;
+    while (next < lines.size()) {
+        // Between runs no desk holds a patient an archiving checkpoint could drop
+        if (hospital.checkpointDue()) hospital.checkpoint();
+        if (!patientCommand(lines[next], patientId)) {
+            succeeded[next] = execute(lines[next], errors[next]);
+            ++next;
+            continue;
+        }
+        size_t first = next;
+        for (; next < lines.size() && patientCommand(lines[next], patientId); ++next) {
+            deskOf[next] = hash<string>()(patientId) % desks;
+        }
+        vector<thread> workers;
+        for (unsigned desk = 0; desk < desks; ++desk) {
+            workers.emplace_back([&, desk, first, next] {
+                BatchRunner runner(hospital);
+                for (size_t i = first; i < next; ++i) {
+                    if (deskOf[i] == desk) succeeded[i] = runner.execute(lines[i], errors[i]);
+                }
+            });
+        }
+        for (auto& worker : workers) worker.join();
+    }
+
+    for (size_t i = 0; i < lines.size(); ++i) {
+        ++summary.commands;
+        if (succeeded[i]) {
+            status << lineNumbers[i] << " OK\n";
+        } else {
+            ++summary.failed;
+            status << lineNumbers[i] << " ERROR " << errors[i] << "\n";
+        }
+    }
+    summary.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    return summary;
+}
+
+bool BatchRunner::execute(const string& line, string& error) {
+    split(line, fields);
+    return execute(fields, error);
+}
+
+bool BatchRunner::execute(const vector<string>& f, string& error) {
+    const string& op = f[0];
+    if (op == "register") {
+        if (!arity(f, 6, error)) return false;
+        Patient patient;
+        patient.id = f[1];
+        patient.name = f[2];
+        if (!toInt(f[3], patient.age, error)) return false;
+        patient.reasonForVisit = f[4];
+        if (!f[5].empty() && !hospital.hasDepartment(f[5])) return fail(error, "unknown department " + f[5]);
+        patient.department = f[5];
+        HmsStatus status = hospital.registerPatient(patient);
+        if (status == HmsStatus::DuplicateId) return fail(error, "duplicate patient ID " + f[1]);
+        return check(status, error);
+    }
+    if (op == "assign-department") {
+        Patient* patient;
+        if (!arity(f, 3, error) || !(patient = findPatient(f[1], error))) return false;
+        HmsStatus status = hospital.assignDepartment(*patient, f[2]);
+        if (status == HmsStatus::NotFound) return fail(error, "unknown department " + f[2]);
+        return check(status, error);
+    }
+    if (op == "schedule") {
+        Patient* patient;
+        StaffRef member;
+        int hour;
+        if (!arity(f, 4, error) || !(patient = findPatient(f[1], error)) ||
+            (!f[2].empty() && !(member = findStaff(f[2], error))) || !toInt(f[3], hour, error)) {
+            return false;
+        }
+        if (!member) {
+            if (patient->department.empty()) return check(HmsStatus::NoDepartment, error);
+            // Another desk may book the hour first; then try the next one open
+            HmsStatus status = HmsStatus::SlotUnavailable;
+            for (StaffRef open : staffAvailableAt(hospital.staffInDepartment(patient->department), hour)) {
+                if ((status = hospital.bookAppointment(*patient, open, hour, time(0))) != HmsStatus::SlotUnavailable) break;
+            }
+            if (status == HmsStatus::SlotUnavailable) return fail(error, "nobody in " + patient->department.str() + " is open at hour " + f[3]);
+            return check(status, error);
+        }
+        HmsStatus status = hospital.bookAppointment(*patient, member, hour, time(0));
+        if (status == HmsStatus::InvalidArgument) return fail(error, "staff member is not in " + patient->department.str());
+        return check(status, error);
+    }
+    if (op == "visit") {
+        Patient* patient;
+        StaffRef member;
+        int minutes;
+        if (!arity(f, 5, error) || !(patient = findPatient(f[1], error)) ||
+            (!f[2].empty() && !(member = findStaff(f[2], error))) || !toInt(f[4], minutes, error)) {
+            return false;
+        }
+        int64_t start = parseCivilMinute(f[3]);
+        if (start < 0) return fail(error, "not a time: " + f[3]);
+        HmsStatus status;
+        if (!member) {
+            if (patient->department.empty()) return check(HmsStatus::NoDepartment, error);
+            // Another desk may take the opening first; then look again
+            int attempts = 8;
+            do {
+                OpenSlot open = hospital.nextOpenSlot(patient->department, -1, start, minutes);
+                if (!open.member) return fail(error, "no opening in " + patient->department.str());
+                status = hospital.bookVisit(*patient, open.member, open.start, minutes);
+            } while (status == HmsStatus::SlotUnavailable && --attempts);
+            return check(status, error);
+        }
+        status = hospital.bookVisit(*patient, member, start, minutes);
+        if (status == HmsStatus::InvalidArgument) return fail(error, "staff member is not in " + patient->department.str());
+        return check(status, error);
+    }
+    if (op == "hospitalize") {
+        Patient* patient;
+        if (!arity(f, 3, error) || !(patient = findPatient(f[1], error))) return false;
+        int room = hospital.findRoom(f[2]);
+        if (room < 0) return fail(error, "unknown room type " + f[2]);
+        return check(hospital.hospitalize(*patient, room, time(0)), error);
+    }
+    if (op == "discharge") {
+        Patient* patient;
+        if (!arity(f, 2, error) || !(patient = findPatient(f[1], error))) return false;
+        return check(hospital.discharge(*patient, time(0)), error);
+    }
+    if (op == "update-timetable") {
+        StaffRef member;
+        int startHour, endHour;
+        if (!arity(f, 5, error) || !(member = findStaff(f[1], error)) || !toInt(f[2], startHour, error) ||
+            !toInt(f[3], endHour, error)) {
+            return false;
+        }
+        if (f[4] != "Work" && f[4] != "Free") return fail(error, "status must be Work or Free");
+        HmsStatus status = hospital.updateTimetable(member, startHour, endHour, parseSlotState(f[4]));
+        if (status == HmsStatus::InvalidArgument) return fail(error, "invalid hour range");
+        return check(status, error);
+    }
+    if (op == "configure-rooms") {
+        int total, occupied;
+        if (!arity(f, 4, error) || !toInt(f[2], total, error) || !toInt(f[3], occupied, error)) return false;
+        if (total < 0 || occupied < 0 || occupied > total) return fail(error, "invalid room counts");
+        int room = hospital.findRoom(f[1]);
+        if (room >= 0) return check(hospital.updateRoom(room, total, occupied), error);
+        return check(hospital.addRoomType(f[1], total, occupied), error);
+    }
+    if (op == "add-department") {
+        if (!arity(f, 2, error)) return false;
+        HmsStatus status = hospital.addDepartment(f[1]);
+        if (status != HmsStatus::Ok) return fail(error, "department exists or is empty");
+        return true;
+    }
+    if (op == "hire") {
+        if (!arity(f, 4, error)) return false;
+        StaffRole role;
+        if (!toRole(f[1], role, error)) return false;
+        if (!f[3].empty() && !hospital.hasDepartment(f[3])) return fail(error, "unknown department " + f[3]);
+        Staff member;
+        member.name = f[2];
+        member.department = f[3];
+        return check(hospital.hireStaff(role, move(member)), error);
+    }
+    if (op == "reassign-staff") {
+        StaffRef member;
+        if (!arity(f, 3, error) || !(member = findStaff(f[1], error))) return false;
+        HmsStatus status = hospital.reassignStaff(member, f[2]);
+        if (status == HmsStatus::NotFound) return fail(error, "unknown department " + f[2]);
+        return check(status, error);
+    }
+    if (op == "shift") {
+        StaffRef member;
+        ShiftTemplate shift;
+        if (!arity(f, 5, error) || !(member = findStaff(f[1], error))) return false;
+        if (!parseShift(f[2], f[3], f[4], shift)) return fail(error, "invalid shift " + f[2] + " " + f[3] + "-" + f[4]);
+        return check(hospital.addShift(member, shift), error);
+    }
+    if (op == "clear-shifts") {
+        StaffRef member;
+        if (!arity(f, 2, error) || !(member = findStaff(f[1], error))) return false;
+        return check(hospital.clearShifts(member), error);
+    }
+    if (op == "cancel-visit") {
+        StaffRef member;
+        if (!arity(f, 3, error) || !(member = findStaff(f[1], error))) return false;
+        int64_t start = parseCivilMinute(f[2]);
+        if (start < 0) return fail(error, "not a time: " + f[2]);
+        HmsStatus status = hospital.cancelVisit(member, start);
+        if (status == HmsStatus::NotFound) return fail(error, "no visit at " + f[2]);
+        return check(status, error);
+    }
+    if (op == "request") {
+        if (!arity(f, 6, error)) return false;
+        AppointmentRequest request;
+        request.patientId = f[1];
+        request.department = f[2];
+        StaffRole role;
+        if (!f[3].empty() && f[3] != "any") {
+            if (!toRole(f[3], role, error)) return false;
+            request.role = (int)role;
+        }
+        if ((!f[4].empty() && !toInt(f[4], request.earliestHour, error)) ||
+            (!f[5].empty() && !toInt(f[5], request.latestHour, error))) {
+            return false;
+        }
+        requests.push_back(request);
+        return true;
+    }
+    if (op == "assign-requests") {
+        if (!arity(f, 1, error)) return false;
+        vector<AppointmentOutcome> outcomes = scheduleAppointments(hospital, requests, time(0));
+        size_t unplaced = 0;
+        for (const AppointmentOutcome& outcome : outcomes) unplaced += outcome.status != HmsStatus::Ok;
+        size_t total = requests.size();
+        requests.clear();
+        if (unplaced) return fail(error, to_string(unplaced) + " of " + to_string(total) + " requests not booked");
+        return true;
+    }
+    return fail(error, "unknown command " + op);
+}
+
+void BatchRunner::split(const string& line, vector<string>& fields) {
+    fields.clear();
+    size_t start = 0;
+    while (true) {
+        size_t bar = line.find('|', start);
+        fields.emplace_back(line, start, bar == string::npos ? string::npos : bar - start);
+        if (bar == string::npos) break;
+        start = bar + 1;
+    }
+}
+
+bool BatchRunner::patientCommand(const string& line, string& patientId) {
+    size_t bar = line.find('|');
+    if (bar == string::npos) return false;
+    string_view op(line.data(), bar);
+    if (op != "register" && op != "assign-department" && op != "schedule" && op != "visit" &&
+        op != "hospitalize" && op != "discharge") {
+        return false;
+    }
+    size_t end = line.find('|', bar + 1);
+    patientId.assign(line, bar + 1, end == string::npos ? string::npos : end - bar - 1);
+    return true;
+}
+
+Patient* BatchRunner::findPatient(const string& id, string& error) {
+    Patient* patient = hospital.findPatient(id);
+    if (!patient) fail(error, "unknown patient " + id);
+    return patient;
+}
+
+StaffRef BatchRunner::findStaff(const string& key, string& error) {
+    StaffRef member = hospital.findStaff(key);
+    if (!member && !key.empty() && key.find_first_not_of("0123456789") == string::npos) {
+        member = hospital.findStaff((size_t)strtoul(key.c_str(), nullptr, 10));
+    }
+    if (!member) fail(error, "unknown staff member " + key);
+    return member;
+}
+
+} // namespace hms
@@ -0,0 +1,101 @@
+#ifndef HMS_BATCH_H
+#define HMS_BATCH_H
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "hospital.h"
+#include "scheduler.h"
+
+namespace hms {
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Batch mode: executes one command per line without prompts. Fields are
+// separated by '|'; blank lines and lines starting with '#' are skipped.
+//
+//   add-department|NAME
+//   hire|doctor|nurse|technician|NAME|DEPARTMENT
+//   reassign-staff|STAFF|DEPARTMENT          (moves a staff member; bookings
+//                                            already made stay)
+//   configure-rooms|TYPE|TOTAL|OCCUPIED      (adds or updates a room type)
+//   register|ID|NAME|AGE|REASON|DEPARTMENT
+//   assign-department|ID|DEPARTMENT
+//   schedule|ID|STAFF|HOUR                   (STAFF is a staff ID or name; an
+//                                            empty STAFF takes the first
+//                                            department member open at HOUR)
+//   hospitalize|ID|ROOM TYPE
+//   discharge|ID
+//   update-timetable|STAFF|START|END|Work/Free
+//   request|ID|DEPARTMENT|ROLE|EARLIEST|LATEST  (queues an appointment
+//                                            request; empty fields mean the
+//                                            patient's department, any role
+//                                            and the whole day)
+//   assign-requests                          (books all queued requests at
+//                                            once, see scheduleAppointments)
+//   shift|STAFF|DAYS|START|END               (adds a weekly shift: DAYS as
+//                                            daily, Mon-Fri or Sat,Sun; START
+//                                            and END as HH:MM)
+//   clear-shifts|STAFF                       (back to the timetable's hours)
+//   visit|ID|STAFF|START|MINUTES             (books a dated visit, START as
+//                                            YYYY-MM-DD HH:MM; an empty STAFF
+//                                            takes the department's first
+//                                            opening at or after START)
+//   cancel-visit|STAFF|START
+//
+// Each command reports "<line> OK" or "<line> ERROR <reason>".
+//
+// With several desks, the commands that act on one patient (register,
+// assign-department, schedule, visit, hospitalize, discharge) run in parallel,
+// spread over the desks by patient ID so each patient's commands keep
+// their order. Every other command waits for the running ones and then
+// runs alone. Desks that race for the same slot or the last room are
+// served in whichever order they get there.
+//
+// When the hospital is due a checkpoint it takes one before the next
+// command, or with several desks once the running commands are done.
+// ---------------------------------------------------------------------------
+
+struct BatchSummary {
+    size_t commands = 0;
+    size_t failed = 0;
+    double seconds = 0;
+};
+
+class BatchRunner {
+public:
+    explicit BatchRunner(Hospital& hospital) : hospital(hospital) {}
+
+    BatchSummary run(istream& in, ostream& status);
+
+    // Runs the whole script on `desks` threads; reports in line order
+    BatchSummary run(istream& in, ostream& status, unsigned desks);
+
+    // Runs one command line; on failure `error` says why
+    bool execute(const string& line, string& error);
+
+    // Runs one parsed command; on failure `error` says why
+    bool execute(const vector<string>& fields, string& error);
+
+    // True for the commands that act on one patient, whose ID is then
+    // their first field
+    static bool patientCommand(const string& line, string& patientId);
+
+    // Splits a command line at each '|'
+    static void split(const string& line, vector<string>& fields);
+
+private:
+    Hospital& hospital;
+    vector<string> fields;
+    vector<AppointmentRequest> requests; // queued until assign-requests
+
+    Patient* findPatient(const string& id, string& error);
+    StaffRef findStaff(const string& key, string& error);
+};
+
+} // namespace hms
+
+#endif // HMS_BATCH_H
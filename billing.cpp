@@ -0,0 +1,351 @@
+#include "billing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <thread>
+
+namespace hms {
+
+namespace {
+
+const size_t INVOICES_PER_CHUNK = 1024;
+const int64_t SECONDS_PER_HOUR = 3600;
+
+bool fail(string& error, const string& reason) {
+    error = reason;
+    return false;
+}
+
+// Decimal amount with at most two fractional digits
+bool parseAmount(const string& text, int64_t& minorUnits) {
+    int64_t whole = 0, fraction = 0;
+    size_t i = 0, digits = 0;
+    for (; i < text.size() && isdigit((unsigned char)text[i]); ++i, ++digits) whole = whole * 10 + (text[i] - '0');
+    if (i < text.size() && text[i] == '.') {
+        int places = 0;
+        for (++i; i < text.size() && isdigit((unsigned char)text[i]) && places < 2; ++i, ++places, ++digits) {
+            fraction = fraction * 10 + (text[i] - '0');
+        }
+        if (places == 1) fraction *= 10;
+    }
+    if (digits == 0 || i != text.size() || whole > INT64_MAX / 1000) return false;
+    minorUnits = whole * 100 + fraction;
+    return true;
+}
+
+bool parseRole(const string& text, StaffRole& role) {
+    if (text == "doctor") role = StaffRole::Doctor;
+    else if (text == "nurse") role = StaffRole::Nurse;
+    else if (text == "technician") role = StaffRole::Technician;
+    else return false;
+    return true;
+}
+
+vector<string> splitFields(const string& line, char separator) {
+    vector<string> fields;
+    stringstream in(line);
+    string field;
+    while (getline(in, field, separator)) fields.push_back(field);
+    if (!line.empty() && line.back() == separator) fields.emplace_back();
+    return fields;
+}
+
+// Started hours of a stay; a stay always costs at least one hour
+int64_t billedHours(int64_t seconds) {
+    return seconds <= 0 ? 1 : (seconds + SECONDS_PER_HOUR - 1) / SECONDS_PER_HOUR;
+}
+
+// Civil start of an appointment at `hour` recorded at civil time `civil`:
+// a visit records its own start, a scheduled hour the time it was booked
+int64_t appointmentStart(int64_t civil, int hour) {
+    int64_t slot = (civil / 86400 - (civil % 86400 < 0)) * 86400 + (int64_t)hour * SECONDS_PER_HOUR;
+    return civil / SECONDS_PER_HOUR == slot / SECONDS_PER_HOUR ? civil : slot;
+}
+
+void writeJsonString(ostream& out, string_view text) {
+    out << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') out << '\\' << c;
+        else if ((unsigned char)c < 0x20) {
+            const char* hex = "0123456789abcdef";
+            out << "\\u00" << hex[(c >> 4) & 0xF] << hex[c & 0xF];
+        } else out << c;
+    }
+    out << '"';
+}
+
+bool inRange(string_view date, const string& fromDate, const string& toDate) {
+    date = date.substr(0, 10);
+    return (fromDate.empty() || date >= fromDate) && (toDate.empty() || date <= toDate);
+}
+
+} // namespace
+
+string formatAmount(int64_t minorUnits) {
+    string sign = minorUnits < 0 ? "-" : "";
+    uint64_t magnitude = minorUnits < 0 ? -(uint64_t)minorUnits : (uint64_t)minorUnits;
+    string cents = to_string(magnitude % 100);
+    return sign + to_string(magnitude / 100) + "." + (cents.size() < 2 ? "0" : "") + cents;
+}
+
+bool Tariffs::load(istream& in, string& error) {
+    string line;
+    for (size_t lineNumber = 1; getline(in, line); ++lineNumber) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        vector<string> f = splitFields(line, '|');
+        string where = "line " + to_string(lineNumber) + ": ";
+        int64_t amount;
+        if (f[0] == "room") {
+            if (f.size() != 3 || f[1].empty() || !parseAmount(f[2], amount)) {
+                return fail(error, where + "expected room|TYPE|RATE");
+            }
+            rooms[f[1]] = amount;
+        } else if (f[0] == "appointment") {
+            StaffRole role;
+            if (f.size() != 3 || !parseRole(f[1], role) || !parseAmount(f[2], amount)) {
+                return fail(error, where + "expected appointment|doctor/nurse/technician|FEE");
+            }
+            appointments[(int)role] = amount;
+            anyAppointmentFee = true;
+        } else if (f[0] == "service") {
+            if (f.size() != 4 || f[1].empty() || !parseAmount(f[2], amount)) {
+                return fail(error, where + "expected service|CATEGORY|FEE|DEPARTMENT,...");
+            }
+            services.push_back({f[1], amount});
+            for (const string& department : splitFields(f[3], ',')) {
+                if (!department.empty()) serviceOfDepartment[department] = services.size() - 1;
+            }
+        } else {
+            return fail(error, where + "unknown tariff " + f[0]);
+        }
+    }
+    return true;
+}
+
+bool Tariffs::loadFile(const string& path, string& error) {
+    ifstream in(path);
+    if (!in) return true;
+    return load(in, error);
+}
+
+int64_t Tariffs::roomRate(Symbol type) const {
+    auto it = rooms.find(type);
+    return it == rooms.end() ? 0 : it->second;
+}
+
+const ServiceTariff* Tariffs::service(Symbol department) const {
+    auto it = serviceOfDepartment.find(department);
+    return it == serviceOfDepartment.end() ? nullptr : &services[it->second];
+}
+
+int64_t Invoice::total() const {
+    int64_t sum = 0;
+    for (const InvoiceItem& item : items) sum += item.amount();
+    return sum;
+}
+
+void writeInvoiceJson(ostream& out, const Invoice& invoice) {
+    out << "{\"patient\":";
+    writeJsonString(out, invoice.patientId);
+    out << ",\"name\":";
+    writeJsonString(out, invoice.patientName);
+    out << ",\"department\":";
+    writeJsonString(out, invoice.department);
+    out << ",\"discharged\":";
+    writeJsonString(out, invoice.dischargeDate);
+    out << ",\"items\":[";
+    for (size_t i = 0; i < invoice.items.size(); ++i) {
+        const InvoiceItem& item = invoice.items[i];
+        out << (i ? "," : "") << "{\"description\":";
+        writeJsonString(out, item.description);
+        out << ",\"quantity\":" << item.quantity << ",\"rate\":" << formatAmount(item.rate)
+            << ",\"amount\":" << formatAmount(item.amount()) << "}";
+    }
+    out << "],\"total\":" << formatAmount(invoice.total()) << "}\n";
+}
+
+BillingEngine::BillingEngine(const Hospital& hospital, const Tariffs& tariffs)
+    : hospital(hospital), tariffs(tariffs) {
+    const StaffDirectory& directory = hospital.staff();
+    roleById.reserve(directory.size());
+    for (size_t row = 0; row < directory.size(); ++row) roleById.push_back((int8_t)directory.roles()[row]);
+}
+
+void BillingEngine::addService(Invoice& invoice, Symbol department) const {
+    const ServiceTariff* service = tariffs.service(department);
+    if (service) invoice.items.push_back({service->category + " services (" + invoice.department + ")", 1, service->fee});
+}
+
+void BillingEngine::addAppointment(Invoice& invoice, const string& staffName, int role, int hour) const {
+    int64_t fee = role >= 0 ? tariffs.appointmentFee((StaffRole)role) : 0;
+    invoice.items.push_back(
+        {string("Appointment with ") + (role >= 0 ? roleName((StaffRole)role) : "Staff") + " " + staffName + " at hour " + to_string(hour), 1, fee});
+}
+
+Invoice BillingEngine::price(const Patient& patient) const {
+    Invoice invoice;
+    invoice.patientId = patient.id;
+    invoice.patientName = patient.name;
+    invoice.department = patient.department;
+    invoice.dischargeDate = patient.dischargeDate;
+    addService(invoice, patient.department);
+    // Appointments after the last discharge belong to a later invoice, and
+    // cancelled ones are not billed
+    int64_t discharged = -1;
+    vector<BookingEvent> bookings;
+    patient.history.forEach([&](const HistoryEvent& event) {
+        int64_t civil = civilSeconds((time_t)event.epoch);
+        if (event.kind == EventKind::Discharged) discharged = civil;
+        bookings.push_back({event.kind, civil / 60, event.hour, (uint64_t)event.staffId});
+    });
+    vector<char> undone;
+    matchCancellations(bookings, undone);
+    int64_t admitted = -1;
+    uint32_t room = 0;
+    size_t index = 0;
+    patient.history.forEach([&](const HistoryEvent& event) {
+        if (undone[index++]) return;
+        switch (event.kind) {
+        case EventKind::Hospitalized:
+            admitted = event.epoch;
+            room = event.subject;
+            break;
+        case EventKind::Discharged:
+            if (admitted >= 0) {
+                Symbol type(eventStore.name(room));
+                invoice.items.push_back({"Stay in " + type.str(), billedHours(event.epoch - admitted), tariffs.roomRate(type)});
+                admitted = -1;
+            }
+            break;
+        case EventKind::Appointment: {
+            if (discharged >= 0 && appointmentStart(civilSeconds((time_t)event.epoch), event.hour) > discharged) break;
+            int role = event.staffId >= 0 && (size_t)event.staffId < roleById.size() ? roleById[event.staffId] : -1;
+            addAppointment(invoice, eventStore.name(event.subject), role, event.hour);
+            break;
+        }
+        default:
+            break;
+        }
+    });
+    return invoice;
+}
+
+Invoice BillingEngine::price(const ArchivedPatient& patient) const {
+    Invoice invoice;
+    invoice.patientId = string(patient.id());
+    invoice.patientName = string(patient.name());
+    invoice.department = string(patient.field(ArchivedPatient::Department));
+    invoice.dischargeDate = string(patient.field(ArchivedPatient::DischargeDate));
+    addService(invoice, Symbol(invoice.department));
+    int64_t discharged = -1;
+    vector<ArchivedEvent> events;
+    vector<BookingEvent> bookings;
+    for (uint32_t i = 0; i < patient.historyCount(); ++i) {
+        ArchivedEvent event = patient.event(i);
+        int64_t civil = civilSeconds((time_t)event.epoch);
+        if (event.kind == EventKind::Discharged) discharged = civil;
+        events.push_back(event);
+        bookings.push_back({event.kind, civil / 60, event.hour, (uint64_t)event.staffId});
+    }
+    vector<char> undone;
+    matchCancellations(bookings, undone);
+    int64_t admitted = -1;
+    Symbol room;
+    for (size_t i = 0; i < events.size(); ++i) {
+        if (undone[i]) continue;
+        const ArchivedEvent& event = events[i];
+        if (event.kind == EventKind::Hospitalized) {
+            admitted = event.epoch;
+            room = Symbol(string(event.subject));
+        } else if (event.kind == EventKind::Discharged) {
+            if (admitted >= 0) {
+                invoice.items.push_back({"Stay in " + room.str(), billedHours(event.epoch - admitted), tariffs.roomRate(room)});
+            }
+            admitted = -1;
+        } else if (event.kind == EventKind::Appointment &&
+                   (discharged < 0 || appointmentStart(civilSeconds((time_t)event.epoch), event.hour) <= discharged)) {
+            int role = event.staffId >= 0 && (size_t)event.staffId < roleById.size() ? roleById[event.staffId] : -1;
+            addAppointment(invoice, string(event.subject), role, event.hour);
+        }
+    }
+    return invoice;
+}
+
+BillingSummary BillingEngine::run(const string& fromDate, const string& toDate, ostream& out, unsigned threads) {
+    BillingSummary summary;
+    auto started = chrono::steady_clock::now();
+
+    // Active records first, then the archive; both in storage order
+    vector<const Patient*> active;
+    for (const Patient& patient : hospital.patients()) {
+        if (!patient.hospitalized && !patient.dischargeDate.empty() &&
+            inRange(patient.dischargeDate, fromDate, toDate)) {
+            active.push_back(&patient);
+        }
+    }
+    vector<ArchivedPatient> archived;
+    if (const PatientArchive* archive = hospital.patients().archive()) {
+        archive->forEach([&](const ArchivedPatient& record) {
+            if (inRange(record.field(ArchivedPatient::DischargeDate), fromDate, toDate)) archived.push_back(record);
+        });
+    }
+
+    // Workers claim chunks in order and the caller writes them in order as
+    // they complete, so output streams while later chunks are priced
+    size_t stays = active.size() + archived.size();
+    size_t chunks = (stays + INVOICES_PER_CHUNK - 1) / INVOICES_PER_CHUNK;
+    vector<string> output(chunks);
+    vector<int64_t> totals(chunks);
+    vector<char> done(chunks);
+    atomic<size_t> nextChunk{0};
+    mutex guard;
+    condition_variable finished;
+
+    auto work = [&] {
+        ostringstream text;
+        for (size_t chunk; (chunk = nextChunk.fetch_add(1)) < chunks;) {
+            text.str(string());
+            int64_t total = 0;
+            size_t end = min(stays, (chunk + 1) * INVOICES_PER_CHUNK);
+            for (size_t i = chunk * INVOICES_PER_CHUNK; i < end; ++i) {
+                Invoice invoice = i < active.size() ? price(*active[i]) : price(archived[i - active.size()]);
+                total += invoice.total();
+                writeInvoiceJson(text, invoice);
+            }
+            lock_guard<mutex> lock(guard);
+            output[chunk] = text.str();
+            totals[chunk] = total;
+            done[chunk] = 1;
+            finished.notify_all();
+        }
+    };
+    if (threads == 0) threads = 1;
+    vector<thread> workers;
+    for (unsigned t = 0; t < threads && t < chunks; ++t) workers.emplace_back(work);
+
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        string text;
+        {
+            unique_lock<mutex> lock(guard);
+            finished.wait(lock, [&] { return done[chunk] != 0; });
+            text.swap(output[chunk]);
+        }
+        out << text;
+        summary.total += totals[chunk];
+    }
+    for (auto& worker : workers) worker.join();
+
+    summary.invoices = stays;
+    summary.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    return summary;
+}
+
+} // namespace hms
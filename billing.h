@@ -0,0 +1,122 @@
+#ifndef HMS_BILLING_H
+#define HMS_BILLING_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "hospital.h"
+
+namespace hms {
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Billing. Amounts are integers in minor currency units (paisa); a tariff
+// of 250.50 is stored as 25050. Invoices are priced from what the core
+// already records: admission and discharge events, and booked appointments.
+// ---------------------------------------------------------------------------
+
+// "1234.50" for 123450
+string formatAmount(int64_t minorUnits);
+
+struct ServiceTariff {
+    string category;
+    int64_t fee = 0;
+};
+
+// Prices by room type, staff role and service category. Tariff files have
+// one entry per line, fields separated by '|', '#' starting a comment:
+//
+//   room|TYPE|RATE                       per started hour in a room of TYPE
+//   appointment|doctor|FEE               per appointment with a doctor
+//                                        (also nurse, technician)
+//   service|CATEGORY|FEE|DEPT,DEPT,...   once per stay for patients of the
+//                                        listed departments
+class Tariffs {
+public:
+    bool load(istream& in, string& error);
+
+    // A missing file leaves the tariffs empty and is not an error
+    bool loadFile(const string& path, string& error);
+
+    bool empty() const { return rooms.empty() && !anyAppointmentFee && services.empty(); }
+
+    int64_t roomRate(Symbol type) const;
+    int64_t appointmentFee(StaffRole role) const { return appointments[(int)role]; }
+    const ServiceTariff* service(Symbol department) const; // nullptr if not billed
+
+private:
+    unordered_map<Symbol, int64_t> rooms;
+    array<int64_t, STAFF_ROLE_COUNT> appointments{};
+    bool anyAppointmentFee = false;
+    vector<ServiceTariff> services;
+    unordered_map<Symbol, size_t> serviceOfDepartment;
+};
+
+struct InvoiceItem {
+    string description;
+    int64_t quantity = 1;
+    int64_t rate = 0;
+
+    int64_t amount() const { return quantity * rate; }
+};
+
+struct Invoice {
+    string patientId;
+    string patientName;
+    string department;
+    string dischargeDate;
+    vector<InvoiceItem> items;
+
+    int64_t total() const;
+};
+
+// One invoice per line as a JSON object
+void writeInvoiceJson(ostream& out, const Invoice& invoice);
+
+struct BillingSummary {
+    size_t invoices = 0;
+    int64_t total = 0;
+    double seconds = 0;
+};
+
+// Prices stays against a set of tariffs. Staff roles are looked up once
+// when the engine is made, so hire no staff while it is in use.
+//
+// A stay is charged per started hour between each admission and the
+// discharge that ended it, per appointment up to the last discharge by
+// the role of the staff member, and once for the service of the
+// patient's department.
+class BillingEngine {
+public:
+    BillingEngine(const Hospital& hospital, const Tariffs& tariffs);
+
+    Invoice price(const Patient& patient) const;
+
+    // Archived records keep their history as text, which is parsed back
+    Invoice price(const ArchivedPatient& patient) const;
+
+    // Close of day: prices every discharged patient, active or archived,
+    // whose discharge date lies in [fromDate, toDate] ("YYYY-MM-DD", empty
+    // for no bound) on `threads` threads. Invoices are streamed to `out` as
+    // JSON lines in registry then archive order. Must not run alongside
+    // changes to the hospital.
+    BillingSummary run(const string& fromDate, const string& toDate, ostream& out, unsigned threads);
+
+private:
+    const Hospital& hospital;
+    const Tariffs& tariffs;
+    vector<int8_t> roleById;                    // StaffRole by staff ID
+
+    void addService(Invoice& invoice, Symbol department) const;
+    void addAppointment(Invoice& invoice, const string& staffName, int role, int hour) const;
+};
+
+} // namespace hms
+
+#endif // HMS_BILLING_H
@@ -0,0 +1,108 @@
+#ifndef HMS_BINARY_IO_H
+#define HMS_BINARY_IO_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace hms {
+using namespace std;
+
+// Binary encoding shared by the snapshot, the write-ahead log and the
+// patient archive.
+
+inline uint32_t crc32(const char* data, size_t length) {
+    static uint32_t table[256];
+    static bool ready = false;
+    if (!ready) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        ready = true;
+    }
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; ++i) {
+        crc = table[(crc ^ (uint8_t)data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Little-endian encoder into a growable byte buffer
+class BinaryWriter {
+public:
+    string bytes;
+
+    void u8(uint8_t value) { bytes.push_back((char)value); }
+    void u32(uint32_t value) { raw(&value, sizeof(value)); }
+    void u64(uint64_t value) { raw(&value, sizeof(value)); }
+    void i32(int32_t value) { raw(&value, sizeof(value)); }
+    void i64(int64_t value) { raw(&value, sizeof(value)); }
+    void str(const string& value) {
+        u32((uint32_t)value.size());
+        bytes.append(value);
+    }
+    void bits(const vector<uint64_t>& words) {
+        u32((uint32_t)words.size());
+        for (uint64_t word : words) u64(word);
+    }
+
+private:
+    void raw(const void* data, size_t size) { bytes.append((const char*)data, size); }
+};
+
+// Bounds-checked decoder; once a read runs past the end `ok` turns false
+// and every later read returns a zero value.
+class BinaryReader {
+public:
+    BinaryReader(const char* data, size_t size) : data(data), size(size) {}
+
+    bool ok = true;
+
+    uint8_t u8() { uint8_t v = 0; raw(&v, 1); return v; }
+    uint32_t u32() { uint32_t v = 0; raw(&v, sizeof(v)); return v; }
+    uint64_t u64() { uint64_t v = 0; raw(&v, sizeof(v)); return v; }
+    int32_t i32() { int32_t v = 0; raw(&v, sizeof(v)); return v; }
+    int64_t i64() { int64_t v = 0; raw(&v, sizeof(v)); return v; }
+    string str() {
+        uint32_t length = u32();
+        if (!ok || length > size - pos) { ok = false; return string(); }
+        string value(data + pos, length);
+        pos += length;
+        return value;
+    }
+    vector<uint64_t> bits() {
+        uint32_t count = u32();
+        if (!ok || count > (size - pos) / 8) { ok = false; return {}; }
+        vector<uint64_t> words(count);
+        for (auto& word : words) word = u64();
+        return words;
+    }
+    bool atEnd() const { return pos == size; }
+
+private:
+    const char* data;
+    size_t size;
+    size_t pos = 0;
+
+    void raw(void* out, size_t count) {
+        if (!ok || count > size - pos) { ok = false; return; }
+        memcpy(out, data + pos, count);
+        pos += count;
+    }
+};
+
+inline uint64_t fnv1a64(const char* data, size_t length) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (uint8_t)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+} // namespace hms
+
+#endif // HMS_BINARY_IO_H
@@ -0,0 +1,206 @@
+#include "calendar.h"
+
+#include <cstdio>
+
+#include "history.h"
+
+namespace hms {
+
+namespace {
+
+const char* const WEEKDAY_NAMES[] = {"Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun"};
+
+int parseWeekday(string_view name) {
+    for (int day = 0; day < 7; ++day) {
+        if (name == WEEKDAY_NAMES[day]) return day;
+    }
+    return -1;
+}
+
+// "HH:MM" as a minute of the day
+bool parseClock(string_view text, int& minute) {
+    if (text.size() != 5 || text[2] != ':') return false;
+    for (size_t i : {0, 1, 3, 4}) {
+        if (text[i] < '0' || text[i] > '9') return false;
+    }
+    int hour = (text[0] - '0') * 10 + (text[1] - '0');
+    int minutes = (text[3] - '0') * 10 + (text[4] - '0');
+    if (hour >= HOURS_IN_DAY || minutes >= 60) return false;
+    minute = hour * 60 + minutes;
+    return true;
+}
+
+string formatClock(int minute) {
+    char buffer[8];
+    snprintf(buffer, sizeof(buffer), "%02d:%02d", minute / 60 % HOURS_IN_DAY, minute % 60);
+    return string(buffer);
+}
+
+} // namespace
+
+string formatCivilMinute(int64_t minute) {
+    return formatCivilDate(minute * 60) + " " + formatClock((int)(minute - dayOf(minute) * MINUTES_IN_DAY));
+}
+
+int64_t parseCivilMinute(string_view text) {
+    if (text.size() != 10 && text.size() != 16) return -1;
+    int64_t midnight = civilSeconds(text.substr(0, 10));
+    if (midnight == -1) return -1; // a real midnight is a multiple of a day
+    int minute = 0;
+    if (text.size() == 16 && (text[10] != ' ' || !parseClock(text.substr(11), minute))) return -1;
+    return midnight / 60 + minute;
+}
+
+string formatShift(const ShiftTemplate& shift) {
+    string days;
+    if ((shift.weekdays & 0x7F) == 0x7F) {
+        days = "daily";
+    } else {
+        for (int day = 0; day < 7;) {
+            if (!(shift.weekdays >> day & 1)) {
+                ++day;
+                continue;
+            }
+            int last = day;
+            while (last + 1 < 7 && (shift.weekdays >> (last + 1) & 1)) ++last;
+            if (!days.empty()) days += ",";
+            days += WEEKDAY_NAMES[day];
+            if (last > day) days += string(last > day + 1 ? "-" : ",") + WEEKDAY_NAMES[last];
+            day = last + 1;
+        }
+    }
+    return days + " " + formatClock(shift.startMinute) + "-" + formatClock(shift.startMinute + shift.minutes);
+}
+
+bool parseShift(string_view weekdays, string_view start, string_view end, ShiftTemplate& shift) {
+    uint8_t days = 0;
+    if (weekdays == "daily") {
+        days = 0x7F;
+    } else {
+        while (!weekdays.empty()) {
+            size_t comma = weekdays.find(',');
+            string_view part = weekdays.substr(0, comma);
+            weekdays = comma == string_view::npos ? string_view() : weekdays.substr(comma + 1);
+            size_t dash = part.find('-');
+            int first = parseWeekday(part.substr(0, dash));
+            int last = dash == string_view::npos ? first : parseWeekday(part.substr(dash + 1));
+            if (first < 0 || last < first) return false;
+            for (int day = first; day <= last; ++day) days |= 1 << day;
+        }
+    }
+    int startMinute, endMinute;
+    if (!days || !parseClock(start, startMinute) || !parseClock(end, endMinute)) return false;
+    shift.weekdays = days;
+    shift.startMinute = (int16_t)startMinute;
+    shift.minutes = (int16_t)(endMinute > startMinute ? endMinute - startMinute : endMinute + MINUTES_IN_DAY - startMinute);
+    return true;
+}
+
+vector<ShiftTemplate> dailyShifts(const Timetable& timetable) {
+    vector<ShiftTemplate> shifts;
+    dailyShifts(timetable, shifts);
+    return shifts;
+}
+
+void dailyShifts(const Timetable& timetable, vector<ShiftTemplate>& shifts) {
+    shifts.clear();
+    for (int hour = 0; hour < HOURS_IN_DAY;) {
+        if (timetable.isFree(hour)) {
+            ++hour;
+            continue;
+        }
+        int end = hour;
+        while (end < HOURS_IN_DAY && !timetable.isFree(end)) ++end;
+        ShiftTemplate shift;
+        shift.startMinute = (int16_t)(hour * 60);
+        shift.minutes = (int16_t)((end - hour) * 60);
+        shifts.push_back(shift);
+        hour = end;
+    }
+}
+
+bool coveredByShifts(const vector<ShiftTemplate>& shifts, int64_t start, int64_t end) {
+    bool covered = false;
+    forEachWorkSpan(shifts, start, end, [&](int64_t spanStart, int64_t spanEnd) {
+        covered = spanStart == start && spanEnd == end;
+        return false;
+    });
+    return covered;
+}
+
+void Calendar::addShift(const ShiftTemplate& shift) {
+    auto at = upper_bound(shiftList.begin(), shiftList.end(), shift,
+                          [](const ShiftTemplate& a, const ShiftTemplate& b) { return a.startMinute < b.startMinute; });
+    shiftList.insert(at, shift);
+}
+
+int64_t Calendar::clashEnd(int64_t start, int64_t end) const {
+    auto block = busy.lower_bound(end);
+    if (block == busy.begin()) return -1;
+    --block;
+    return block->second > start ? block->second : -1;
+}
+
+// Joins [start, end) with the blocks it touches
+void Calendar::markBusy(int64_t start, int64_t end) {
+    auto block = busy.lower_bound(start);
+    if (block != busy.begin() && prev(block)->second >= start) {
+        --block;
+        start = block->first;
+    }
+    while (block != busy.end() && block->first <= end) {
+        end = max(end, block->second);
+        block = busy.erase(block);
+    }
+    busy.emplace(start, end);
+}
+
+bool Calendar::book(int64_t start, int64_t end, const string& patientId, bool hourly) {
+    if (start >= end || clashEnd(start, end) >= 0) return false;
+    visitTree.emplace(start, Visit{end, patientId, hourly});
+    markBusy(start, end);
+    return true;
+}
+
+bool Calendar::cancel(int64_t start) {
+    auto visit = visitTree.find(start);
+    if (visit == visitTree.end()) return false;
+    visitTree.erase(visit);
+    // Split the block that held it back into runs of the visits left
+    auto block = prev(busy.upper_bound(start));
+    int64_t blockStart = block->first, blockEnd = block->second;
+    busy.erase(block);
+    for (auto it = visitTree.lower_bound(blockStart); it != visitTree.end() && it->first < blockEnd; ++it) {
+        markBusy(it->first, it->second.end);
+    }
+    return true;
+}
+
+void Calendar::dropBefore(int64_t minute) {
+    // Visits do not overlap, so they end in the order they start
+    auto it = visitTree.begin();
+    while (it != visitTree.end() && it->second.end <= minute) ++it;
+    if (it == visitTree.begin()) return;
+    visitTree.erase(visitTree.begin(), it);
+    busy.clear();
+    for (const auto& visit : visitTree) markBusy(visit.first, visit.second.end);
+}
+
+int64_t Calendar::nextOpen(const vector<ShiftTemplate>& shifts, int64_t from, int minutes, int64_t before) const {
+    int64_t found = -1;
+    if (minutes <= 0 || from >= before) return found;
+    forEachWorkSpan(shifts, from, before + minutes, [&](int64_t start, int64_t end) {
+        for (int64_t at = start; at < before && at + minutes <= end;) {
+            int64_t busyUntil = clashEnd(at, at + minutes);
+            if (busyUntil < 0) {
+                found = at;
+                return false;
+            }
+            at = busyUntil;
+        }
+        return true;
+    });
+    return found;
+}
+
+} // namespace hms
@@ -0,0 +1,145 @@
+#ifndef HMS_CALENDAR_H
+#define HMS_CALENDAR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "timetable.h"
+
+namespace hms {
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Dated staff calendars. Times are civil minutes: civil seconds (see
+// history.h) divided by 60, so whole days start at local midnight.
+//
+// A member works the union of their shift templates, each repeating on
+// chosen weekdays. Templates are expanded only over the span a query looks
+// at, never stored per day. Visits are booked intervals in a tree ordered
+// by start. They never overlap, and a second tree holds the busy blocks
+// that back-to-back visits merge into, so a booking or a conflict check is
+// one O(log n) lookup of the block that starts last before the interval
+// ends, and a search for free time skips a whole block at a time.
+// ---------------------------------------------------------------------------
+
+const int MINUTES_IN_DAY = HOURS_IN_DAY * 60;
+
+inline int64_t dayOf(int64_t minute) {
+    return minute / MINUTES_IN_DAY - (minute % MINUTES_IN_DAY < 0);
+}
+
+// 0 for Monday; 1970-01-01 was a Thursday
+inline int weekdayOf(int64_t day) {
+    return (int)((day % 7 + 10) % 7);
+}
+
+// "YYYY-MM-DD HH:MM" of a civil minute
+string formatCivilMinute(int64_t minute);
+
+// Civil minute of "YYYY-MM-DD HH:MM" (or "YYYY-MM-DD" at midnight); -1 if
+// malformed
+int64_t parseCivilMinute(string_view text);
+
+struct ShiftTemplate {
+    uint8_t weekdays = 0x7F; // bit d set: repeats on weekday d, 0 = Monday
+    int16_t startMinute = 0; // minute of the day the shift starts
+    int16_t minutes = 0;     // length, up to a whole day; may run past midnight
+
+    bool valid() const {
+        return (weekdays & 0x7F) && startMinute >= 0 && startMinute < MINUTES_IN_DAY && minutes > 0 &&
+               minutes <= MINUTES_IN_DAY;
+    }
+};
+
+// "Mon-Fri 08:00-16:00"
+string formatShift(const ShiftTemplate& shift);
+
+// Weekdays as "daily", "Mon-Fri", "Sat,Sun" or a mix of both; start and
+// end as "HH:MM", an end at or before the start running into the next day.
+// False if any part is malformed.
+bool parseShift(string_view weekdays, string_view start, string_view end, ShiftTemplate& shift);
+
+// Every-day shifts over the hours a timetable's first day is not Free,
+// one per run of consecutive hours
+vector<ShiftTemplate> dailyShifts(const Timetable& timetable);
+void dailyShifts(const Timetable& timetable, vector<ShiftTemplate>& shifts); // replaces the contents
+
+// Calls visitor(start, end) for each span of [from, to) covered by the
+// shifts, merged where they touch or overlap and in order, until it
+// returns false. `shifts` must be ordered by start minute.
+template <class Visitor>
+void forEachWorkSpan(const vector<ShiftTemplate>& shifts, int64_t from, int64_t to, Visitor visitor) {
+    if (shifts.empty() || from >= to) return;
+    int64_t spanStart = 0, spanEnd = INT64_MIN;
+    // A shift may start the day before `from` and run into it
+    for (int64_t day = dayOf(from) - 1; day * MINUTES_IN_DAY < to; ++day) {
+        int weekday = weekdayOf(day);
+        for (const ShiftTemplate& shift : shifts) {
+            if (!(shift.weekdays >> weekday & 1)) continue;
+            int64_t start = day * MINUTES_IN_DAY + shift.startMinute, end = start + shift.minutes;
+            if (start >= to) break;
+            if (end <= from) continue;
+            if (start <= spanEnd) {
+                spanEnd = max(spanEnd, end);
+                continue;
+            }
+            if (spanEnd > spanStart && !visitor(max(spanStart, from), min(spanEnd, to))) return;
+            spanStart = start;
+            spanEnd = end;
+        }
+    }
+    if (spanEnd > spanStart) visitor(max(spanStart, from), min(spanEnd, to));
+}
+
+// True when [start, end) lies within one span of the shifts
+bool coveredByShifts(const vector<ShiftTemplate>& shifts, int64_t start, int64_t end);
+
+struct Visit {
+    int64_t end = 0;
+    string patientId;
+    bool hourly = false; // holds a timetable hour (Hospital::bookAppointment)
+};
+
+// One member's shift templates and booked visits. Not synchronized; the
+// Hospital guards each calendar with a lock of its own.
+class Calendar {
+public:
+    // Ordered by start minute
+    const vector<ShiftTemplate>& shifts() const { return shiftList; }
+    void addShift(const ShiftTemplate& shift);
+    void clearShifts() { shiftList.clear(); }
+
+    // Visits by start minute
+    const map<int64_t, Visit>& visits() const { return visitTree; }
+
+    // End of the busy block overlapping [start, end), or -1 if none does
+    int64_t clashEnd(int64_t start, int64_t end) const;
+
+    // False if the interval overlaps a visit; shifts are not checked
+    bool book(int64_t start, int64_t end, const string& patientId, bool hourly = false);
+    bool cancel(int64_t start);
+
+    // Forgets visits that ended by `minute`
+    void dropBefore(int64_t minute);
+
+    // Earliest start at or after `from` and before `before` of `minutes`
+    // inside `shifts` that overlaps no visit, or -1. `shifts` are the
+    // member's working templates, which the Hospital picks (see
+    // Hospital::bookVisit).
+    int64_t nextOpen(const vector<ShiftTemplate>& shifts, int64_t from, int minutes, int64_t before) const;
+
+private:
+    vector<ShiftTemplate> shiftList;
+    map<int64_t, Visit> visitTree;
+    map<int64_t, int64_t> busy; // end of each run of touching visits, by start
+
+    void markBusy(int64_t start, int64_t end);
+};
+
+} // namespace hms
+
+#endif // HMS_CALENDAR_H
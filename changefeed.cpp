@@ -0,0 +1,180 @@
+#include "changefeed.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "calendar.h"
+#include "staff.h"
+#include "symbols.h"
+#include "timetable.h"
+
+namespace hms {
+
+const char* changeKindName(ChangeKind kind) {
+    switch (kind) {
+    case ChangeKind::DepartmentAdded: return "department-added";
+    case ChangeKind::RoomUpdated: return "room-updated";
+    case ChangeKind::StaffHired: return "staff-hired";
+    case ChangeKind::TimetableEdited: return "timetable-edited";
+    case ChangeKind::ShiftsChanged: return "shifts-changed";
+    case ChangeKind::PatientRegistered: return "patient-registered";
+    case ChangeKind::DepartmentAssigned: return "department-assigned";
+    case ChangeKind::AppointmentBooked: return "appointment-booked";
+    case ChangeKind::VisitBooked: return "visit-booked";
+    case ChangeKind::VisitCancelled: return "visit-cancelled";
+    case ChangeKind::Hospitalized: return "hospitalized";
+    case ChangeKind::Discharged: return "discharged";
+    case ChangeKind::StaffReassigned: return "staff-reassigned";
+    }
+    return "unknown";
+}
+
+void ChangeEvent::setPatient(string_view id) {
+    patientIdLength = (uint8_t)min<size_t>(id.size(), 255);
+    memcpy(patientId, id.data(), min(id.size(), PATIENT_ID_BYTES));
+}
+
+string formatChange(const ChangeEvent& event) {
+    string line = to_string(event.sequence) + "|" + changeKindName(event.kind);
+    auto field = [&](const string& text) { line += "|" + text; };
+    auto symbol = [&] { field(Symbol::fromId(event.symbol).str()); };
+    if (event.patientIdLength) field(string(event.patient()));
+    switch (event.kind) {
+    case ChangeKind::DepartmentAdded:
+    case ChangeKind::DepartmentAssigned:
+        symbol();
+        break;
+    case ChangeKind::RoomUpdated:
+        symbol();
+        field(to_string(event.first));
+        field(to_string(event.second));
+        break;
+    case ChangeKind::StaffHired:
+        field(to_string(event.staff));
+        field(roleName((StaffRole)event.first));
+        symbol();
+        break;
+    case ChangeKind::TimetableEdited:
+        field(to_string(event.staff));
+        field(to_string(event.hour));
+        field(to_string(event.first));
+        field(slotStateName((SlotState)event.second));
+        break;
+    case ChangeKind::ShiftsChanged:
+        field(to_string(event.staff));
+        field(to_string(event.first));
+        break;
+    case ChangeKind::PatientRegistered:
+        symbol();
+        field(to_string(event.first));
+        break;
+    case ChangeKind::AppointmentBooked:
+        field(to_string(event.staff));
+        field(to_string(event.hour));
+        break;
+    case ChangeKind::VisitBooked:
+        field(to_string(event.staff));
+        field(formatCivilMinute(event.first));
+        field(to_string(event.second));
+        break;
+    case ChangeKind::VisitCancelled:
+        field(to_string(event.staff));
+        field(formatCivilMinute(event.first));
+        break;
+    case ChangeKind::Hospitalized:
+    case ChangeKind::Discharged:
+        if (event.symbol) symbol();
+        field(to_string(event.first));
+        break;
+    case ChangeKind::StaffReassigned:
+        field(to_string(event.staff));
+        symbol();
+        break;
+    }
+    return line;
+}
+
+ChangeFeed::ChangeFeed() : slots(make_unique<Slot[]>(CAPACITY)) {}
+
+uint64_t ChangeFeed::publish(ChangeEvent event) {
+    uint64_t sequence = claimed.fetch_add(1, memory_order_acq_rel) + 1;
+    event.sequence = sequence;
+    Slot& slot = slots[sequence & (CAPACITY - 1)];
+    // A publisher a whole lap ahead lets the one before it finish the slot
+    uint64_t previous = sequence > CAPACITY ? 2 * (sequence - CAPACITY) + 2 : 0;
+    while (slot.version.load(memory_order_acquire) != previous) this_thread::yield();
+
+    uint64_t words[8];
+    memcpy(words, &event, sizeof(words));
+    slot.version.store(2 * sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (size_t i = 0; i < slot.words.size(); ++i) slot.words[i].store(words[i + 1], memory_order_relaxed);
+    slot.version.store(2 * sequence + 2, memory_order_seq_cst);
+
+    if (sleepers.load(memory_order_seq_cst) > 0) {
+        lock_guard<mutex> lock(sleepLock);
+        published.notify_all();
+    }
+    return sequence;
+}
+
+uint64_t ChangeFeed::oldestSequence() const {
+    uint64_t last = lastSequence();
+    return last > CAPACITY ? last - CAPACITY + 1 : 1;
+}
+
+bool ChangeFeed::read(uint64_t sequence, ChangeEvent& event, bool& lost) const {
+    const Slot& slot = slots[sequence & (CAPACITY - 1)];
+    const uint64_t done = 2 * sequence + 2;
+    uint64_t version = slot.version.load(memory_order_acquire);
+    lost = version > done;
+    if (version != done) return false;
+    uint64_t words[8];
+    words[0] = sequence;
+    for (size_t i = 0; i < slot.words.size(); ++i) words[i + 1] = slot.words[i].load(memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if (slot.version.load(memory_order_relaxed) != done) {
+        lost = true; // overwritten while it was copied
+        return false;
+    }
+    memcpy(&event, words, sizeof(words));
+    return true;
+}
+
+bool ChangeFeed::waitFor(uint64_t sequence, chrono::milliseconds timeout) const {
+    const Slot& slot = slots[sequence & (CAPACITY - 1)];
+    auto ready = [&] { return slot.version.load(memory_order_seq_cst) >= 2 * sequence + 2; };
+    if (ready()) return true;
+    // Publishers look for sleepers after publishing; counting first means
+    // one of the two always sees the other
+    sleepers.fetch_add(1, memory_order_seq_cst);
+    bool woken;
+    {
+        unique_lock<mutex> lock(sleepLock);
+        woken = published.wait_for(lock, timeout, ready);
+    }
+    sleepers.fetch_sub(1, memory_order_seq_cst);
+    return woken;
+}
+
+ChangeSubscription::ChangeSubscription(const ChangeFeed& feed, uint64_t next)
+    : feed(feed), position(next ? next : feed.lastSequence() + 1) {}
+
+bool ChangeSubscription::poll(vector<ChangeEvent>& out, size_t limit) {
+    ChangeEvent event;
+    bool lost;
+    for (size_t n = 0; n < limit; ++n) {
+        if (feed.read(position, event, lost)) {
+            out.push_back(event);
+            ++position;
+            continue;
+        }
+        if (!lost) break;
+        position = max(position + 1, feed.oldestSequence());
+        return false;
+    }
+    return true;
+}
+
+} // namespace hms
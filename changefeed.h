@@ -0,0 +1,157 @@
+#ifndef HMS_CHANGEFEED_H
+#define HMS_CHANGEFEED_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace hms {
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Change feed. Every change the Hospital makes is published as a small
+// fixed-size event into a ring holding the last CAPACITY of them, which
+// any number of subscribers read at their own pace without taking a lock.
+//
+// Events are numbered from 1 in the order they are published, and the
+// events about one patient, staff member or room type in the order the
+// changes were made. Publishers never wait for subscribers: one that falls
+// more than CAPACITY events behind loses the ones overwritten, is told so,
+// and has to read the state afresh. Numbering starts over in each process.
+// ---------------------------------------------------------------------------
+
+enum class ChangeKind : uint8_t {
+    DepartmentAdded = 1,
+    RoomUpdated,
+    StaffHired,
+    TimetableEdited,
+    ShiftsChanged,
+    PatientRegistered,
+    DepartmentAssigned,
+    AppointmentBooked,
+    VisitBooked,
+    VisitCancelled,
+    Hospitalized,
+    Discharged,
+    StaffReassigned,
+};
+
+const char* changeKindName(ChangeKind kind);
+
+// What the fields hold, by kind (the others stay at their defaults):
+//
+//   kind                symbol       staff  hour   first          second
+//   DepartmentAdded     department
+//   RoomUpdated         room type                  total beds     occupied
+//   StaffHired          department   ID            role
+//   TimetableEdited                  ID     start  end hour       SlotState
+//   ShiftsChanged                    ID            templates
+//   PatientRegistered   department                 age
+//   DepartmentAssigned  department
+//   AppointmentBooked   department   ID     hour
+//   VisitBooked         department   ID            start minute   minutes
+//   VisitCancelled                   ID            start minute
+//   Hospitalized        room type                  bed
+//   Discharged          room type                  bed (-1: none)
+//   StaffReassigned     department   ID
+//
+// Patient events also carry the patient's ID. Symbols are IDs in the
+// symbol table; start minutes are civil minutes (see calendar.h).
+struct ChangeEvent {
+    static const size_t PATIENT_ID_BYTES = 28;
+
+    uint64_t sequence = 0;
+    int64_t time = 0; // when the change was made, seconds since the epoch
+    ChangeKind kind = ChangeKind::DepartmentAdded;
+    uint8_t patientIdLength = 0; // of the whole ID, which is kept up to PATIENT_ID_BYTES
+    int16_t hour = -1;
+    int32_t staff = -1;
+    uint32_t symbol = 0;
+    int32_t first = 0;
+    int32_t second = 0;
+    char patientId[PATIENT_ID_BYTES] = {};
+
+    ChangeEvent() = default;
+    ChangeEvent(ChangeKind kind, time_t when) : time(when), kind(kind) {}
+
+    void setPatient(string_view id);
+    string_view patient() const {
+        return string_view(patientId, min<size_t>(patientIdLength, PATIENT_ID_BYTES));
+    }
+    bool patientTruncated() const { return patientIdLength > PATIENT_ID_BYTES; }
+};
+static_assert(sizeof(ChangeEvent) == 64, "one cache line per event");
+
+// "SEQ|KIND|..." with the fields the kind uses, names for symbols
+string formatChange(const ChangeEvent& event);
+
+class ChangeFeed {
+public:
+    static const size_t CAPACITY = size_t(1) << 16;
+
+    ChangeFeed();
+
+    // Numbers the event and makes it visible; returns its sequence
+    uint64_t publish(ChangeEvent event);
+
+    uint64_t lastSequence() const { return claimed.load(memory_order_acquire); } // 0 before any
+    uint64_t oldestSequence() const; // oldest one still held
+
+    // Copies the event numbered `sequence`. Fails when it is not published
+    // yet (`lost` false) or has been overwritten (`lost` true).
+    bool read(uint64_t sequence, ChangeEvent& event, bool& lost) const;
+
+    // Waits until `sequence` is published or the timeout passes
+    bool waitFor(uint64_t sequence, chrono::milliseconds timeout) const;
+
+private:
+    // The event minus its sequence, written and read word by word under
+    // a per-slot version: 2 * sequence + 1 while it is written, + 2 once
+    // done, so a reader can tell a stale or torn copy from a good one
+    struct alignas(64) Slot {
+        atomic<uint64_t> version{0};
+        array<atomic<uint64_t>, 7> words;
+    };
+    static_assert(sizeof(Slot) == 64, "one cache line per slot");
+
+    unique_ptr<Slot[]> slots;
+    atomic<uint64_t> claimed{0};
+    alignas(64) mutable atomic<int> sleepers{0};
+    mutable mutex sleepLock;
+    mutable condition_variable published;
+};
+
+// One reader's position in a feed
+class ChangeSubscription {
+public:
+    // Starts at `next`; 0 starts after the last event published
+    ChangeSubscription(const ChangeFeed& feed, uint64_t next = 0);
+
+    // Appends up to `limit` events in order. False if events were lost
+    // since the last call; the subscription then continues with the
+    // oldest event held, and the reader should read the state afresh.
+    bool poll(vector<ChangeEvent>& out, size_t limit = 1024);
+
+    // Waits until the next event is published or the timeout passes
+    bool wait(chrono::milliseconds timeout) const { return feed.waitFor(position, timeout); }
+
+    uint64_t next() const { return position; }
+
+private:
+    const ChangeFeed& feed;
+    uint64_t position;
+};
+
+} // namespace hms
+
+#endif // HMS_CHANGEFEED_H
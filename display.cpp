@@ -0,0 +1,234 @@
+#include "display.h"
+
+#include <iomanip>
+#include <sstream>
+
+namespace hms {
+
+// Function to display a room type and its occupancy
+void displayRoom(const Room& room, ostream& out) {
+    out << "Room Type: " << room.type 
+        << " | Total: " << room.totalRooms 
+        << " | Occupied: " << room.occupiedRooms 
+        << " | Available: " << room.availableRooms() << "\n";
+}
+// Room Management table: one row per room type
+void displayRoomTable(const vector<Room>& rooms, ostream& out) {
+    vector<RoomLoad> loads;
+    for (const auto& room : rooms) {
+        RoomLoad load;
+        load.type = room.type;
+        load.total = room.totalRooms;
+        load.free = room.availableRooms();
+        loads.push_back(load);
+    }
+    displayRoomTable(loads, out);
+}
+
+void displayRoomTable(const vector<RoomLoad>& rooms, ostream& out) {
+    out << "+-------------------+--------+------------+------------+\n";
+    out << "| Room Type         | Total  | Occupied   | Available  |\n";
+    out << "+-------------------+--------+------------+------------+\n";
+
+    for (const auto& room : rooms) {
+        out << "| " << setw(17) << left << room.type
+            << "| " << setw(6) << room.total
+            << "| " << setw(10) << room.total - room.free
+            << "| " << setw(10) << room.free << " |\n";
+    }
+
+    out << "+-------------------+--------+------------+------------+\n";
+}
+
+// Status board: totals, rooms, admissions and open/booked hours by department
+void displayStatusBoard(const StatusView& view, ostream& out) {
+    int week = 0;
+    for (int count : view.discharges) week += count;
+    out << "\n--- Status Board ---\n";
+    out << "Free beds: " << view.freeBeds << " | Admitted: " << view.admitted
+        << " | Discharged today: " << view.discharges[0] << " | Last 7 days: " << week << "\n";
+    displayRoomTable(view.rooms, out);
+    out << setw(24) << left << "Department" << right << setw(9) << "Admitted" << "\n";
+    for (const auto& load : view.departments) {
+        string name = load.department.empty() ? "(none)" : load.department.str().substr(0, 23);
+        out << setw(24) << left << name << right << setw(9) << load.admitted << "\n";
+    }
+    out << "\nOpen / booked hours\n" << setw(24) << left << "Hour" << right;
+    for (int hour = 0; hour < HOURS_IN_DAY; ++hour) out << setw(4) << hour;
+    out << "\n";
+    for (const auto& load : view.departments) {
+        if (load.department.empty()) continue;
+        out << setw(24) << left << load.department.str().substr(0, 23) << right;
+        for (int hour = 0; hour < HOURS_IN_DAY; ++hour) out << setw(4) << load.openSlots[hour];
+        out << "\n" << setw(24) << "";
+        for (int hour = 0; hour < HOURS_IN_DAY; ++hour) out << setw(4) << load.bookedSlots[hour];
+        out << "\n";
+    }
+    out << left;
+}
+
+// Display the timetable
+void displayTimetable(StaffRef staffMember, ostream& out) {
+    out << "\nTimetable for " << staffMember.name() << ":\n";
+    out << "+---------------------------------------------------------------------------------------------------------+\n";
+    out << "| Hour   |  0   1   2   3   4   5   6   7   8   9  10  11  12  13  14  15  16  17  18  19  20  21  22  23  |\n";
+    out << "+---------------------------------------------------------------------------------------------------------+\n";
+    char status[] = "| Status |  X   X   X   X   X   X   X   X   X   X   X   X   X   X   X   X   X   X   X   X   X   X   X   X  |\n";
+    for (int hour = 0; hour < HOURS_IN_DAY; ++hour) {
+        if (staffMember.timetable().isFree(hour)) status[12 + 4 * hour] = '#';
+    }
+    out << status;
+    out << "+---------------------------------------------------------------------------------------------------------+\n";
+}
+
+void displayCalendar(const string& name, const vector<ShiftTemplate>& shifts,
+                     const vector<pair<int64_t, Visit>>& visits, int64_t from, int days, ostream& out) {
+    static const char* weekdays[] = {"Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun"};
+    auto clock = [](int64_t minute) { return formatCivilMinute(minute).substr(11); };
+    out << "\nCalendar for " << name << ":\n";
+    size_t next = 0;
+    for (int64_t day = dayOf(from), last = day + days; day < last; ++day) {
+        int64_t midnight = day * MINUTES_IN_DAY;
+        out << formatCivilDate(midnight * 60) << " " << weekdays[weekdayOf(day)] << "  ";
+        bool working = false;
+        forEachWorkSpan(shifts, midnight, midnight + MINUTES_IN_DAY, [&](int64_t start, int64_t end) {
+            out << (working ? ", " : "") << clock(start) << "-" << (end == midnight + MINUTES_IN_DAY ? "24:00" : clock(end));
+            working = true;
+            return true;
+        });
+        out << (working ? "\n" : "off\n");
+        for (; next < visits.size() && visits[next].first < midnight + MINUTES_IN_DAY; ++next) {
+            out << "    " << clock(visits[next].first) << "-" << clock(visits[next].second.end) << "  "
+                << visits[next].second.patientId << "\n";
+        }
+    }
+}
+
+void displayPatientChart(const Patient& patient, ostream& out) {
+    out<< "\n=============================================\n"
+        <<setw(20)<<left<< "Name:" << patient.name << "\n"
+        <<setw(20)<<left<< "Age:" << patient.age << "\n"
+        <<setw(20)<<left<< "Reason for Visit:" << patient.reasonForVisit << "\n"
+        <<setw(20)<<left<< "Assigned Department:" << patient.department << "\n"
+        <<setw(20)<<left<< "Hospitalized:" << (patient.hospitalized ? "Yes" : "No") << "\n";
+    if (patient.hospitalized){
+        out<<setw(20)<<left<<"Assigned Room:"<<patient.roomType<<", bed "<<patient.bed + 1<<"\n";
+        out<<setw(20)<<left<<"Hospitalization Date:"<<patient.hospitalizationDate<<"\n";
+    }
+    out<<setw(20)<<left<<"Discharge Date:"<<(!patient.dischargeDate.empty()?patient.dischargeDate:"N/A")<<"\n";
+    out<<"\n--- Patient History ---\n";
+    for(const auto& event:patient.history){
+        out<<"  - "<<event<<"\n";
+    }
+    out<<"=============================================\n";
+}
+
+// Renders an archived record straight from the mapped archive bytes
+void displayPatientChart(const ArchivedPatient& patient, ostream& out) {
+    string_view dischargeDate = patient.field(ArchivedPatient::DischargeDate);
+    out<< "\n=============================================\n"
+        <<setw(20)<<left<< "Name:" << patient.name() << "\n"
+        <<setw(20)<<left<< "Age:" << patient.age() << "\n"
+        <<setw(20)<<left<< "Reason for Visit:" << patient.field(ArchivedPatient::Reason) << "\n"
+        <<setw(20)<<left<< "Assigned Department:" << patient.field(ArchivedPatient::Department) << "\n"
+        <<setw(20)<<left<< "Hospitalized:" << "No" << "\n";
+    out<<setw(20)<<left<<"Discharge Date:"<<(!dischargeDate.empty()?dischargeDate:"N/A")<<"\n";
+    out<<"\n--- Patient History ---\n";
+    for(uint32_t i=0;i<patient.historyCount();++i){
+        out<<"  - "<<patient.history(i)<<"\n";
+    }
+    out<<"=============================================\n";
+}
+
+// Itemized invoice, one line per charge
+void displayInvoice(const Invoice& invoice, ostream& out) {
+    out << "\n--- Invoice for " << invoice.patientName << " (" << invoice.patientId << ") ---\n";
+    for (const auto& item : invoice.items) {
+        out << "  " << setw(44) << left << item.description << right << setw(6) << item.quantity << " x "
+            << setw(10) << formatAmount(item.rate) << setw(12) << formatAmount(item.amount()) << "\n";
+    }
+    out << "Total cost: Pkr" << formatAmount(invoice.total()) << "\n" << left;
+}
+
+// One row per bucket: average beds in use and the share of today's beds
+void displayOccupancy(const OccupancyReport& report, ostream& out) {
+    int64_t days = report.bucketSeconds / 86400;
+    out << "\n--- Occupancy by Room Type (average beds in use";
+    if (days > 1) out << ", " << days << " days per row";
+    out << ") ---\n" << setw(12) << left << "From";
+    for (const auto& type : report.roomTypes) out << right << setw(18) << type.substr(0, 17);
+    out << "\n" << setw(12) << left << "Beds now";
+    for (int beds : report.beds) out << right << setw(18) << beds;
+    out << "\n";
+    for (size_t bucket = 0; bucket < report.buckets; ++bucket) {
+        out << setw(12) << left << formatCivilDate(report.from + (int64_t)bucket * report.bucketSeconds) << right;
+        for (size_t type = 0; type < report.roomTypes.size(); ++type) {
+            double used = report.occupiedBeds[type * report.buckets + bucket];
+            ostringstream cell;
+            cell << fixed << setprecision(1) << used;
+            if (report.beds[type] > 0) cell << " (" << setprecision(0) << 100 * used / report.beds[type] << "%)";
+            out << setw(18) << cell.str();
+        }
+        out << "\n";
+    }
+    out << left;
+}
+
+void displayStayLengths(const StayLengthReport& report, ostream& out) {
+    auto rows = [&out](const char* heading, const vector<StayLengthReport::Row>& rows) {
+        out << setw(24) << left << heading << right << setw(10) << "Stays" << setw(14) << "Avg hours" << setw(12)
+            << "Avg days" << "\n";
+        for (const auto& row : rows) {
+            out << setw(24) << left << row.name.substr(0, 23) << right << setw(10) << row.stays << fixed
+                << setprecision(1) << setw(14) << row.averageHours << setw(12) << row.averageHours / 24 << "\n";
+        }
+        out << "\n";
+    };
+    out << "\n--- Average Length of Stay ---\n";
+    rows("", {report.overall});
+    rows("Room Type", report.byRoomType);
+    rows("Department", report.byDepartment);
+    out << left;
+}
+
+void displayLoad(const LoadReport& report, size_t staffRows, ostream& out) {
+    out << "\n--- Department Load ---\n"
+        << setw(24) << left << "Department" << right << setw(12) << "Admissions" << setw(14) << "Appointments" << "\n";
+    for (const auto& department : report.departments) {
+        out << setw(24) << left << department.name.substr(0, 23) << right << setw(12) << department.admissions
+            << setw(14) << department.appointments << "\n";
+    }
+    out << "\n--- Busiest Staff ---\n"
+        << setw(24) << left << "Name" << setw(12) << "Role" << setw(20) << "Department" << right << setw(14)
+        << "Appointments" << "\n";
+    for (size_t i = 0; i < report.staff.size() && i < staffRows; ++i) {
+        const auto& member = report.staff[i];
+        out << setw(24) << left << member.name.substr(0, 23) << setw(12) << roleName(member.role) << setw(20)
+            << member.department.substr(0, 19) << right << setw(14) << member.appointments << "\n";
+    }
+    out << left;
+}
+
+// Two rows per department: staff on shift each hour, and the share of
+// those hours booked with appointments
+void displayUtilization(const UtilizationReport& report, ostream& out) {
+    out << "\n--- Hourly Utilization (staff on shift / % booked) ---\n" << setw(24) << left << "Hour" << right;
+    for (int hour = 0; hour < HOURS_IN_DAY; ++hour) out << setw(4) << hour;
+    out << "\n";
+    for (size_t department = 0; department < report.departments.size(); ++department) {
+        if (report.staff[department] == 0) continue;
+        const uint32_t* onShift = &report.onShift[department * HOURS_IN_DAY];
+        const uint32_t* booked = &report.booked[department * HOURS_IN_DAY];
+        out << setw(24) << left << report.departments[department].substr(0, 23) << right;
+        for (int hour = 0; hour < HOURS_IN_DAY; ++hour) out << setw(4) << onShift[hour];
+        out << "\n" << setw(24) << "";
+        for (int hour = 0; hour < HOURS_IN_DAY; ++hour) {
+            if (onShift[hour] == 0) out << setw(4) << "-";
+            else out << setw(4) << 100 * booked[hour] / onShift[hour];
+        }
+        out << "\n";
+    }
+    out << left;
+}
+
+} // namespace hms
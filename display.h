@@ -0,0 +1,38 @@
+#ifndef HMS_DISPLAY_H
+#define HMS_DISPLAY_H
+
+#include <iostream>
+#include <vector>
+
+#include "analytics.h"
+#include "archive.h"
+#include "billing.h"
+#include "patient.h"
+#include "room.h"
+#include "staff.h"
+#include "statusboard.h"
+
+namespace hms {
+using namespace std;
+
+// Console rendering shared by the menus and the benchmarks
+
+void displayRoom(const Room& room, ostream& out = cout);
+void displayRoomTable(const vector<Room>& rooms, ostream& out = cout);
+void displayRoomTable(const vector<RoomLoad>& rooms, ostream& out = cout);
+void displayStatusBoard(const StatusView& view, ostream& out = cout);
+void displayTimetable(StaffRef staffMember, ostream& out = cout);
+// Working hours and visits for `days` days from the civil minute `from`
+void displayCalendar(const string& name, const vector<ShiftTemplate>& shifts,
+                     const vector<pair<int64_t, Visit>>& visits, int64_t from, int days, ostream& out = cout);
+void displayPatientChart(const Patient& patient, ostream& out = cout);
+void displayPatientChart(const ArchivedPatient& patient, ostream& out = cout);
+void displayInvoice(const Invoice& invoice, ostream& out = cout);
+void displayOccupancy(const OccupancyReport& report, ostream& out = cout);
+void displayStayLengths(const StayLengthReport& report, ostream& out = cout);
+void displayLoad(const LoadReport& report, size_t staffRows = 20, ostream& out = cout);
+void displayUtilization(const UtilizationReport& report, ostream& out = cout);
+
+} // namespace hms
+
+#endif // HMS_DISPLAY_H
@@ -0,0 +1,123 @@
+#include "history.h"
+
+#include <cctype>
+#include <cstdio>
+
+namespace hms {
+
+EventStore eventStore;
+
+string formatDateTime(time_t when) {
+    char buffer[80];
+    struct tm local;
+    localtime_r(&when, &local);
+    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &local);
+    return string(buffer);
+}
+
+// The UTC offset only changes on the hour, so it is looked up once per
+// hour seen rather than per call
+int64_t civilSeconds(time_t when) {
+    thread_local int64_t cachedHour = INT64_MIN, cachedOffset = 0;
+    int64_t hour = (int64_t)when / 3600 - ((int64_t)when % 3600 < 0);
+    if (hour != cachedHour) {
+        struct tm local;
+        localtime_r(&when, &local);
+        cachedOffset = local.tm_gmtoff;
+        cachedHour = hour;
+    }
+    return (int64_t)when + cachedOffset;
+}
+
+int64_t civilSeconds(string_view text) {
+    if (text.size() != 10 && text.size() < 19) return -1;
+    auto number = [&text](size_t at, size_t length) {
+        int value = 0;
+        for (size_t i = at; i < at + length; ++i) {
+            if (!isdigit((unsigned char)text[i])) return -1;
+            value = value * 10 + (text[i] - '0');
+        }
+        return value;
+    };
+    int year = number(0, 4), month = number(5, 2), day = number(8, 2);
+    int hour = 0, minute = 0, second = 0;
+    if (text.size() >= 19) {
+        hour = number(11, 2);
+        minute = number(14, 2);
+        second = number(17, 2);
+    }
+    if (year < 0 || month < 1 || month > 12 || day < 1 || hour < 0 || minute < 0 || second < 0) return -1;
+    // days from civil, proleptic Gregorian calendar
+    year -= month <= 2;
+    int64_t era = year / 400;
+    int64_t yearOfEra = year - era * 400;
+    int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    int64_t days = era * 146097 + dayOfEra - 719468;
+    return days * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+// Reading the civil time as UTC is off by the UTC offset; a second pass
+// picks up the offset in force at the first guess
+time_t epochOfCivil(int64_t civil) {
+    int64_t when = civil;
+    for (int pass = 0; pass < 2; ++pass) when = civil - (civilSeconds((time_t)when) - when);
+    return (time_t)when;
+}
+
+string renderEvent(EventKind kind, time_t epoch, int hour, string_view subject) {
+    string when = formatDateTime(epoch);
+    switch (kind) {
+    case EventKind::Appointment:
+        return "Appointment scheduled with " + string(subject) + " at hour " + to_string(hour) + " on " + when;
+    case EventKind::Hospitalized:
+        return "Hospitalized in " + string(subject) + " on " + when;
+    case EventKind::Discharged:
+        return "Discharged on " + when;
+    case EventKind::Cancelled:
+        return "Visit with " + string(subject) + " on " + when.substr(0, 16) + " cancelled";
+    default:
+        return string(subject);
+    }
+}
+
+void matchCancellations(const vector<BookingEvent>& events, vector<char>& undone) {
+    const int64_t minutesInDay = 24 * 60;
+    auto dayOf = [&](int64_t minute) { return minute / minutesInDay - (minute % minutesInDay < 0); };
+    undone.assign(events.size(), 0);
+    for (size_t i = 0; i < events.size(); ++i) {
+        const BookingEvent& cancel = events[i];
+        if (cancel.kind != EventKind::Cancelled || cancel.minute < 0) continue;
+        int64_t day = dayOf(cancel.minute);
+        for (size_t j = i; j-- > 0;) {
+            const BookingEvent& booking = events[j];
+            if (booking.kind != EventKind::Appointment || undone[j] || booking.staff != cancel.staff ||
+                booking.minute < 0) {
+                continue;
+            }
+            if (booking.minute == cancel.minute ||
+                (dayOf(booking.minute) == day && day * minutesInDay + booking.hour * 60 == cancel.minute)) {
+                undone[i] = undone[j] = 1;
+                break;
+            }
+        }
+    }
+}
+
+string formatCivilDate(int64_t civil) {
+    // civil from days, the inverse of the above
+    int64_t days = civil / 86400 - (civil % 86400 < 0) + 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t dayOfEra = days - era * 146097;
+    int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int64_t monthIndex = (5 * dayOfYear + 2) / 153;
+    int day = (int)(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+    int month = (int)(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+    int64_t year = yearOfEra + era * 400 + (month <= 2);
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%04lld-%02d-%02d", (long long)year, month, day);
+    return string(buffer);
+}
+
+} // namespace hms
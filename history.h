@@ -0,0 +1,236 @@
+#ifndef HMS_HISTORY_H
+#define HMS_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace hms {
+using namespace std;
+
+// Formats a timestamp as "YYYY-MM-DD HH:MM:SS" local time
+string formatDateTime(time_t when);
+
+// "Civil" seconds: a local wall clock time counted from 1970-01-01
+// 00:00:00 with no time zone applied, so whole days start at local
+// midnight. Differences are durations, off by the shift across a DST change.
+int64_t civilSeconds(time_t when);
+
+// Civil seconds of "YYYY-MM-DD HH:MM:SS" text as formatDateTime writes it,
+// or of "YYYY-MM-DD" at midnight; -1 if malformed
+int64_t civilSeconds(string_view text);
+
+// "YYYY-MM-DD" of the day holding a civil time
+string formatCivilDate(int64_t civil);
+
+// The Unix time of a civil time, the inverse of civilSeconds(time_t); a
+// wall clock hour skipped or repeated by a DST change maps to a neighbour
+time_t epochOfCivil(int64_t civil);
+
+// ---------------------------------------------------------------------------
+// Patient history. Events are stored as typed records in one global columnar
+// store; each patient only keeps the head, tail and length of its chain.
+// Names referenced by events (staff, room types, free-text notes) are
+// interned once, and the readable text is produced only when displayed.
+// A cancelled visit keeps the staff name and the visit's start, so
+// cancelling adds no names.
+// ---------------------------------------------------------------------------
+
+enum class EventKind : uint8_t { Note = 0, Appointment, Hospitalized, Discharged, Cancelled };
+
+struct HistoryEvent {
+    int64_t epoch = 0;     // seconds since the Unix epoch; a cancelled visit's start
+    int32_t staffId = -1;  // StaffDirectory ID for appointments and cancellations
+    uint32_t subject = 0;  // interned staff name, room type or note text
+    int8_t hour = -1;      // appointment hour
+    EventKind kind = EventKind::Note;
+};
+
+// The readable text of an event; `subject` is the text its subject names
+string renderEvent(EventKind kind, time_t epoch, int hour, string_view subject);
+
+// What pairing a cancellation with the booking it undid needs of an event
+struct BookingEvent {
+    EventKind kind = EventKind::Note;
+    int64_t minute = -1; // civil minute of the event's time, -1 if unknown
+    int hour = -1;       // appointment hour
+    uint64_t staff = 0;  // the member's directory ID, or a hash of the name
+};
+
+// Sets undone[i] for each Cancelled event of a history and for the
+// Appointment it undid: the latest earlier one with the same member
+// starting at the cancelled minute, a visit at its own time or an hourly
+// booking at its hour of that day. Events are in history order.
+void matchCancellations(const vector<BookingEvent>& events, vector<char>& undone);
+
+// Thread-safe: appends and interning take the store's lock exclusively,
+// reads take it shared.
+class EventStore {
+public:
+    static constexpr uint32_t NONE = 0xFFFFFFFFu;
+
+    uint32_t intern(const string& name) {
+        {
+            shared_lock<shared_mutex> read(guard);
+            auto it = nameIds.find(name);
+            if (it != nameIds.end()) return it->second;
+        }
+        lock_guard<shared_mutex> write(guard);
+        auto it = nameIds.find(name);
+        if (it != nameIds.end()) return it->second;
+        uint32_t id = (uint32_t)names.size();
+        names.push_back(name);
+        nameIds.emplace(names.back(), id);
+        return id;
+    }
+
+    // Names are never removed and the deque keeps them in place, so the
+    // reference stays valid after the lock is released
+    const string& name(uint32_t id) const {
+        shared_lock<shared_mutex> read(guard);
+        return names[id];
+    }
+
+    // Appends an event and links it after `previous` (NONE for a new chain)
+    uint32_t append(uint32_t previous, const HistoryEvent& event) {
+        lock_guard<shared_mutex> write(guard);
+        return appendLocked(previous, event);
+    }
+
+    HistoryEvent at(uint32_t index) const {
+        shared_lock<shared_mutex> read(guard);
+        return atLocked(index);
+    }
+
+    uint32_t next(uint32_t index) const {
+        shared_lock<shared_mutex> read(guard);
+        return nexts[index];
+    }
+
+    size_t size() const {
+        shared_lock<shared_mutex> read(guard);
+        return kinds.size();
+    }
+
+    string render(const HistoryEvent& event) const {
+        return renderEvent(event.kind, (time_t)event.epoch, event.hour, name(event.subject));
+    }
+
+    // Rebuilds the columns keeping only the chains still referenced.
+    // `heads` are updated in place to the new positions. Callers must make
+    // sure no history is appended to or walked meanwhile.
+    template <class Histories>
+    void compact(Histories& histories) {
+        lock_guard<shared_mutex> write(guard);
+        EventStore kept;
+        for (auto* history : histories) {
+            uint32_t previous = NONE, head = NONE;
+            for (uint32_t i = history->head; i != NONE; i = nexts[i]) {
+                previous = kept.appendLocked(previous, atLocked(i));
+                if (head == NONE) head = previous;
+            }
+            history->head = head;
+            history->tail = previous;
+        }
+        epochs.swap(kept.epochs);
+        staffIds.swap(kept.staffIds);
+        subjects.swap(kept.subjects);
+        hours.swap(kept.hours);
+        kinds.swap(kept.kinds);
+        nexts.swap(kept.nexts);
+    }
+
+private:
+    mutable shared_mutex guard;
+    vector<int64_t> epochs;
+    vector<int32_t> staffIds;
+    vector<uint32_t> subjects;
+    vector<int8_t> hours;
+    vector<EventKind> kinds;
+    vector<uint32_t> nexts;
+    deque<string> names;
+    unordered_map<string, uint32_t> nameIds;
+
+    uint32_t appendLocked(uint32_t previous, const HistoryEvent& event) {
+        uint32_t index = (uint32_t)kinds.size();
+        epochs.push_back(event.epoch);
+        staffIds.push_back(event.staffId);
+        subjects.push_back(event.subject);
+        hours.push_back(event.hour);
+        kinds.push_back(event.kind);
+        nexts.push_back(NONE);
+        if (previous != NONE) nexts[previous] = index;
+        return index;
+    }
+
+    HistoryEvent atLocked(uint32_t index) const {
+        HistoryEvent event;
+        event.epoch = epochs[index];
+        event.staffId = staffIds[index];
+        event.subject = subjects[index];
+        event.hour = hours[index];
+        event.kind = kinds[index];
+        return event;
+    }
+};
+
+// Shared by every patient history in the process
+extern EventStore eventStore;
+
+// One patient's chain in the event store. Iterating yields rendered text so
+// existing `for (const auto& event : history)` loops keep working.
+class PatientHistory {
+public:
+    void append(const HistoryEvent& event) {
+        tail = eventStore.append(tail, event);
+        if (head == EventStore::NONE) head = tail;
+        ++count;
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // Calls visit(const HistoryEvent&) for each event, oldest first
+    template <class Visitor>
+    void forEach(Visitor visit) const {
+        for (uint32_t i = head; i != EventStore::NONE; i = eventStore.next(i)) visit(eventStore.at(i));
+    }
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = string;
+        using difference_type = ptrdiff_t;
+        using pointer = const string*;
+        using reference = string;
+
+        explicit const_iterator(uint32_t index) : index(index) {}
+        string operator*() const { return eventStore.render(eventStore.at(index)); }
+        const_iterator& operator++() { index = eventStore.next(index); return *this; }
+        bool operator!=(const const_iterator& other) const { return index != other.index; }
+        bool operator==(const const_iterator& other) const { return index == other.index; }
+    private:
+        uint32_t index;
+    };
+
+    const_iterator begin() const { return const_iterator(head); }
+    const_iterator end() const { return const_iterator(EventStore::NONE); }
+
+private:
+    friend class EventStore;
+    uint32_t head = EventStore::NONE;
+    uint32_t tail = EventStore::NONE;
+    uint32_t count = 0;
+};
+
+} // namespace hms
+
+#endif // HMS_HISTORY_H
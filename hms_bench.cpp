@@ -0,0 +1,491 @@
+// Benchmarks for the HMS hot paths.
+//
+//   hms_bench [--patients N,N,...] [--staff N,N,...] [--json] [--seed N]
+//             [--no-metrics]
+//
+// Every operation is timed on its own, so latencies include one clock
+// read (about 20 ns). Allocations are counted by replacing the global
+// operator new. With --json each result is one JSON object per line;
+// otherwise a table is printed.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "analytics.h"
+#include "batch.h"
+#include "billing.h"
+#include "changefeed.h"
+#include "display.h"
+#include "hospital.h"
+#include "importer.h"
+#include "metrics.h"
+#include "scheduler.h"
+using namespace std;
+using namespace hms;
+
+static atomic<uint64_t> allocations{0};
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+
+// GCC sees free() given a pointer from operator new and warns of a
+// mismatch; this is the malloc that operator new above returned
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+#pragma GCC diagnostic pop
+
+namespace {
+
+struct Result {
+    string name;
+    size_t patients = 0;
+    size_t staff = 0;
+    size_t ops = 0;
+    double opsPerSecond = 0;
+    double p50 = 0; // nanoseconds
+    double p99 = 0;
+    double allocsPerOp = 0;
+};
+
+bool jsonOutput = false;
+uint64_t seed = 42;
+
+void report(const Result& r) {
+    if (jsonOutput) {
+        printf("{\"benchmark\":\"%s\",\"patients\":%zu,\"staff\":%zu,\"ops\":%zu,"
+               "\"ops_per_sec\":%.0f,\"p50_ns\":%.0f,\"p99_ns\":%.0f,\"allocs_per_op\":%.2f}\n",
+               r.name.c_str(), r.patients, r.staff, r.ops, r.opsPerSecond, r.p50, r.p99, r.allocsPerOp);
+    } else {
+        printf("%-22s %10zu %7zu %10zu %14.0f %9.0f %9.0f %8.2f\n", r.name.c_str(), r.patients, r.staff, r.ops,
+               r.opsPerSecond, r.p50, r.p99, r.allocsPerOp);
+    }
+    fflush(stdout);
+}
+
+double percentile(vector<uint32_t>& samples, double fraction) {
+    if (samples.empty()) return 0;
+    size_t rank = min(samples.size() - 1, (size_t)(fraction * samples.size()));
+    nth_element(samples.begin(), samples.begin() + rank, samples.end());
+    return samples[rank];
+}
+
+// Runs op(i) for i in [0, ops) and reports it
+template <class Op>
+void measure(const string& name, size_t patients, size_t staff, size_t ops, Op op) {
+    vector<uint32_t> samples(ops);
+    uint64_t totalNs = 0;
+    uint64_t allocsBefore = allocations.load(memory_order_relaxed);
+    for (size_t i = 0; i < ops; ++i) {
+        auto start = chrono::steady_clock::now();
+        op(i);
+        uint64_t ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        samples[i] = (uint32_t)min<uint64_t>(ns, UINT32_MAX);
+        totalNs += ns;
+    }
+    // the samples vector was allocated before the baseline was taken
+    uint64_t allocs = allocations.load(memory_order_relaxed) - allocsBefore;
+
+    Result r;
+    r.name = name;
+    r.patients = patients;
+    r.staff = staff;
+    r.ops = ops;
+    r.opsPerSecond = totalNs ? ops * 1e9 / totalNs : 0;
+    r.p50 = percentile(samples, 0.50);
+    r.p99 = percentile(samples, 0.99);
+    r.allocsPerOp = ops ? (double)allocs / ops : 0;
+    report(r);
+}
+
+// Discards output, for timing what is written rather than the writing
+struct NullBuffer : streambuf {
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize count) override { return count; }
+};
+
+const int DEPARTMENTS = 20;
+const int ROOM_TYPES = 8;
+
+string departmentName(size_t i) { return "Department " + to_string(i % DEPARTMENTS); }
+string patientId(size_t i) { return "P" + to_string(i); }
+string patientName(size_t i) { return "Patient " + to_string(i); }
+
+void setUpDepartments(Hospital& hospital) {
+    for (int d = 0; d < DEPARTMENTS; ++d) hospital.addDepartment(departmentName(d));
+}
+
+// Registration, lookups, hospitalization, discharge, the room table and
+// the status board
+void patientBenchmarks(size_t patients) {
+    Hospital hospital;
+    setUpDepartments(hospital);
+    size_t bedsPerType = patients / ROOM_TYPES + 1;
+    for (int t = 0; t < ROOM_TYPES; ++t) hospital.addRoomType("Ward " + to_string(t), (int)bedsPerType, 0);
+
+    vector<Patient> incoming(patients);
+    for (size_t i = 0; i < patients; ++i) {
+        incoming[i].id = patientId(i);
+        incoming[i].name = patientName(i);
+        incoming[i].age = (int)(i % 90);
+        incoming[i].reasonForVisit = "checkup";
+        incoming[i].department = departmentName(i);
+    }
+    measure("register", patients, 0, patients, [&](size_t i) { hospital.registerPatient(incoming[i]); });
+    incoming.clear();
+    incoming.shrink_to_fit();
+
+    size_t lookups = min<size_t>(patients, 1000000);
+    mt19937_64 rng(seed);
+    vector<string> ids(lookups), names(lookups);
+    for (size_t i = 0; i < lookups; ++i) {
+        size_t pick = rng() % patients;
+        ids[i] = patientId(pick);
+        names[i] = patientName(pick);
+    }
+    measure("lookup_id", patients, 0, lookups, [&](size_t i) { hospital.findPatient(ids[i]); });
+    measure("lookup_name", patients, 0, lookups, [&](size_t i) { hospital.findPatientByName(names[i]); });
+
+    measure("search", patients, 0, min<size_t>(lookups, 100000), [&](size_t i) {
+        hospital.searchPatients(i % 2 ? names[i] : "patient " + ids[i].substr(1, 3));
+    });
+
+    vector<Patient*> admitted(lookups);
+    for (size_t i = 0; i < lookups; ++i) admitted[i] = hospital.findPatient(patientId(i));
+    measure("hospitalize", patients, 0, lookups,
+            [&](size_t i) { hospital.hospitalize(*admitted[i], i % ROOM_TYPES, (time_t)i); });
+    measure("discharge", patients, 0, lookups, [&](size_t i) { hospital.discharge(*admitted[i], (time_t)i); });
+
+    Tariffs tariffs;
+    string error;
+    istringstream tariffFile("room|Ward 0|100\nroom|Ward 3|250.50\nservice|Medical|500|Department 1,Department 2\n");
+    tariffs.load(tariffFile, error);
+    NullBuffer discard;
+    ostream invoices(&discard);
+    measure("close_of_day", patients, 0, 1, [&](size_t) {
+        BillingEngine(hospital, tariffs).run("", "", invoices, thread::hardware_concurrency());
+    });
+
+    AnalyticsStore store;
+    measure("analytics_load", patients, 0, 1, [&](size_t) { store.load(hospital); });
+
+    ostringstream screen;
+    measure("room_table_render", patients, 0, 10000, [&](size_t) {
+        screen.str(string());
+        displayRoomTable(hospital.rooms(), screen);
+    });
+    measure("status_board", patients, 0, 10000, [&](size_t) {
+        screen.str(string());
+        displayStatusBoard(hospital.statusBoard(time(0)), screen);
+    });
+}
+
+// Department-filtered staff search, timetable edits and the status board
+void staffBenchmarks(size_t staffCount) {
+    Hospital hospital;
+    setUpDepartments(hospital);
+    vector<StaffRef> hired(staffCount);
+    for (size_t i = 0; i < staffCount; ++i) {
+        Staff member;
+        member.name = "Staff " + to_string(i);
+        member.department = departmentName(i);
+        hospital.hireStaff((StaffRole)(i % STAFF_ROLE_COUNT), move(member), &hired[i]);
+    }
+
+    size_t ops = 100000;
+    vector<string> departments;
+    for (int d = 0; d < DEPARTMENTS; ++d) departments.push_back(departmentName(d));
+    measure("staff_in_department", 0, staffCount, ops,
+            [&](size_t i) { hospital.staffInDepartment(departments[i % DEPARTMENTS]); });
+
+    mt19937_64 rng(seed);
+    vector<int> starts(ops), ends(ops);
+    for (size_t i = 0; i < ops; ++i) {
+        starts[i] = (int)(rng() % HOURS_IN_DAY);
+        ends[i] = starts[i] + (int)(rng() % (HOURS_IN_DAY - starts[i]));
+    }
+    measure("timetable_update", 0, staffCount, ops, [&](size_t i) {
+        hospital.updateTimetable(hired[i % staffCount], starts[i], ends[i], i % 2 ? SlotState::Work : SlotState::Free);
+    });
+
+    ostringstream screen;
+    measure("status_board", 0, staffCount, 10000, [&](size_t) {
+        screen.str(string());
+        displayStatusBoard(hospital.statusBoard(time(0)), screen);
+    });
+}
+
+// A synthetic day through the batch command interpreter: intake, an
+// appointment, admission and discharge for every patient
+void batchBenchmark(size_t patients, size_t staffCount) {
+    Hospital hospital;
+    BatchRunner runner(hospital);
+    string error;
+    setUpDepartments(hospital);
+    for (size_t i = 0; i < staffCount; ++i) {
+        runner.execute("hire|doctor|Doctor " + to_string(i) + "|" + departmentName(i), error);
+        runner.execute("update-timetable|Doctor " + to_string(i) + "|0|23|Work", error);
+    }
+    runner.execute("configure-rooms|Ward|" + to_string(patients) + "|0", error);
+
+    vector<string> script;
+    script.reserve(patients * 4);
+    for (size_t i = 0; i < patients; ++i) {
+        script.push_back("register|" + patientId(i) + "|" + patientName(i) + "|40|checkup|" + departmentName(i));
+        script.push_back("schedule|" + patientId(i) + "|Doctor " + to_string(i % staffCount) + "|" +
+                         to_string(i / staffCount % HOURS_IN_DAY));
+        script.push_back("hospitalize|" + patientId(i) + "|Ward");
+        script.push_back("discharge|" + patientId(i));
+    }
+    measure("batch_day", patients, staffCount, script.size(), [&](size_t i) { runner.execute(script[i], error); });
+}
+
+// Dated visits: the department's first opening of 30 minutes, then the
+// booking, on calendars that fill up as the run goes. Half the staff add
+// weekday night shifts to the day hours of their timetables.
+void calendarBenchmark(size_t patients, size_t staffCount) {
+    Hospital hospital;
+    setUpDepartments(hospital);
+    ShiftTemplate night;
+    parseShift("Mon-Fri", "20:00", "04:00", night);
+    for (size_t i = 0; i < staffCount; ++i) {
+        Staff member;
+        member.name = "Staff " + to_string(i);
+        member.department = departmentName(i);
+        member.timetable.setHours(8, 15, SlotState::Work);
+        StaffRef hired;
+        hospital.hireStaff((StaffRole)(i % STAFF_ROLE_COUNT), move(member), &hired);
+        if (i % 2) hospital.addShift(hired, night);
+    }
+    vector<Patient*> registered(patients);
+    for (size_t i = 0; i < patients; ++i) {
+        Patient patient;
+        patient.id = patientId(i);
+        patient.department = departmentName(i);
+        hospital.registerPatient(patient, &registered[i]);
+    }
+
+    const int64_t monday = parseCivilMinute("2030-01-07");
+    measure("visit_book", patients, staffCount, patients, [&](size_t i) {
+        Patient& patient = *registered[i];
+        OpenSlot open = hospital.nextOpenSlot(patient.department, -1, monday + (int64_t)(i % 97) * 60, 30);
+        if (open.member) hospital.bookVisit(patient, open.member, open.start, 30);
+    });
+    vector<Symbol> departments;
+    for (int d = 0; d < DEPARTMENTS; ++d) departments.push_back(departmentName(d));
+    measure("next_open_slot", patients, staffCount, 100000, [&](size_t i) {
+        hospital.nextOpenSlot(departments[i % DEPARTMENTS], -1, monday + (int64_t)(i % 97) * 60, 30);
+    });
+}
+
+// One scheduler run over a morning's queue: every request wants a role
+// or any staff in its department within a few hours, against staff on
+// staggered 12 hour shifts
+void schedulerBenchmark(size_t requestCount, size_t staffCount) {
+    Hospital hospital;
+    setUpDepartments(hospital);
+    for (size_t i = 0; i < staffCount; ++i) {
+        Staff member;
+        member.name = "Staff " + to_string(i);
+        member.department = departmentName(i);
+        int start = (int)(i % 3) * 6;
+        member.timetable.setHours(start, start + 11, SlotState::Work);
+        hospital.hireStaff((StaffRole)(i % STAFF_ROLE_COUNT), move(member));
+    }
+    mt19937_64 rng(seed);
+    vector<AppointmentRequest> requests(requestCount);
+    for (size_t i = 0; i < requestCount; ++i) {
+        Patient patient;
+        patient.id = patientId(i);
+        patient.name = patientName(i);
+        patient.department = departmentName(rng() % DEPARTMENTS);
+        hospital.registerPatient(patient);
+        requests[i].patientId = patient.id;
+        requests[i].role = (int)(rng() % (STAFF_ROLE_COUNT + 1)) - 1;
+        requests[i].earliestHour = (int)(rng() % (HOURS_IN_DAY - 4));
+        requests[i].latestHour = requests[i].earliestHour + 1 + (int)(rng() % 4);
+    }
+    measure("schedule_requests", requestCount, staffCount, 1,
+            [&](size_t) { scheduleAppointments(hospital, requests, 0); });
+}
+
+// Management reports over `rows` synthetic history rows, half stays and
+// half appointments spread over a year
+void analyticsBenchmark(size_t rows, size_t staffCount) {
+    AnalyticsStore store;
+    for (int d = 0; d < DEPARTMENTS; ++d) store.departments.code(departmentName(d));
+    for (int t = 0; t < ROOM_TYPES; ++t) store.roomTypes.code("Ward " + to_string(t));
+    store.beds.assign(ROOM_TYPES, 1000);
+    for (size_t i = 0; i < staffCount; ++i) {
+        Timetable timetable;
+        int start = (int)(i % 3) * 8;
+        timetable.setHours(start, start + 7, SlotState::Work);
+        store.addStaff("Staff " + to_string(i), departmentName(i), (StaffRole)(i % STAFF_ROLE_COUNT), timetable);
+    }
+    const int64_t year = 365 * 86400, start = civilSeconds("2024-01-01");
+    store.loadedAt = start + year;
+    mt19937_64 rng(seed);
+    for (size_t i = 0; i < rows / 2; ++i) {
+        int64_t admitted = start + (int64_t)(rng() % year);
+        int64_t discharged = i % 50 ? admitted + (int64_t)(rng() % (14 * 86400)) : AnalyticsStore::STILL_ADMITTED;
+        store.addStay(admitted, discharged, (uint16_t)(rng() % ROOM_TYPES), (uint16_t)(rng() % DEPARTMENTS));
+        store.addAppointment(start + (int64_t)(rng() % year), (int32_t)(rng() % staffCount),
+                             (uint16_t)(rng() % DEPARTMENTS));
+    }
+
+    AnalyticsEngine engine(store, thread::hardware_concurrency());
+    TimeRange quarter;
+    parseDateRange("2024-04-01", "2024-06-30", quarter);
+    measure("report_occupancy", rows, staffCount, 5, [&](size_t) { engine.occupancy(TimeRange()); });
+    measure("report_stays", rows, staffCount, 5, [&](size_t) { engine.stayLengths(quarter); });
+    measure("report_load", rows, staffCount, 5, [&](size_t) { engine.load(quarter); });
+    measure("report_heatmap", rows, staffCount, 5, [&](size_t) { engine.utilization(); });
+}
+
+// The change feed on its own: publishing, then reading back what is still
+// held in batches of 256, and publishing while another thread follows
+void changeFeedBenchmark(size_t events) {
+    auto feed = make_unique<ChangeFeed>();
+    ChangeEvent change(ChangeKind::Hospitalized, 0);
+    change.setPatient("P123456");
+    measure("change_publish", events, 0, events, [&](size_t i) {
+        change.first = (int32_t)i;
+        feed->publish(change);
+    });
+    ChangeSubscription subscription(*feed, feed->oldestSequence());
+    vector<ChangeEvent> batch;
+    batch.reserve(256);
+    measure("change_poll_256", events, 0, ChangeFeed::CAPACITY / 256, [&](size_t) {
+        batch.clear();
+        subscription.poll(batch, 256);
+    });
+
+    atomic<bool> done{false};
+    thread follower([&] {
+        ChangeSubscription follow(*feed);
+        vector<ChangeEvent> seen;
+        seen.reserve(1024);
+        while (!done.load(memory_order_relaxed)) {
+            seen.clear();
+            if (follow.poll(seen) && seen.empty()) follow.wait(chrono::milliseconds(10));
+        }
+    });
+    measure("change_publish_follow", events, 0, events, [&](size_t i) {
+        change.first = (int32_t)i;
+        feed->publish(change);
+    });
+    done = true;
+    follower.join();
+}
+
+vector<size_t> parseList(const char* text) {
+    vector<size_t> values;
+    stringstream in(text);
+    string item;
+    while (getline(in, item, ',')) {
+        if (!item.empty()) values.push_back(strtoull(item.c_str(), nullptr, 10));
+    }
+    return values;
+}
+
+} // namespace
+
+// Bulk import into an empty hospital, from CSV files and again from segment
+// files: the departments, rooms and staff roster in one go, then the
+// patients in batches of IMPORT_BATCH rows
+const size_t IMPORT_BATCH = 10000;
+
+void importBenchmark(size_t patients, size_t staffCount) {
+    static const char* const roles[] = {"doctor", "nurse", "technician"};
+    for (ImportFormat format : {ImportFormat::Csv, ImportFormat::Segments}) {
+        bool csv = format == ImportFormat::Csv;
+        char comma = csv ? ',' : '|';
+        auto line = [&](const char* segment, string row) {
+            if (!csv) replace(row.begin(), row.end(), ',', '|');
+            return (csv ? "" : string(segment) + comma) + row + "\n";
+        };
+        vector<string> roster(3), batches;
+        roster[0] = csv ? "department\n" : "MSH|^~\\&|HMS\n";
+        for (int d = 0; d < DEPARTMENTS; ++d) roster[0] += line("DEP", departmentName(d));
+        if (csv) roster[1] = "type,total,occupied\n";
+        roster[1] += line("ROM", "Ward," + to_string(patients) + ",0") + line("ROM", "ICU,100,0");
+        if (csv) roster[2] = "role,name,department,start,end\n";
+        for (size_t i = 0; i < staffCount; ++i) {
+            roster[2] += line("STF", string(roles[i % 3]) + ",Doctor " + to_string(i) + "," + departmentName(i) + ",8,17");
+        }
+        for (size_t i = 0; i < patients; ++i) {
+            if (i % IMPORT_BATCH == 0) batches.push_back(csv ? "id,name,age,reason,department\n" : "");
+            batches.back() += line("PID", patientId(i) + "," + patientName(i) + ",40,checkup," + departmentName(i));
+        }
+
+        Hospital hospital;
+        Importer importer(hospital, max(thread::hardware_concurrency(), 1u));
+        ostringstream errors;
+        string error;
+        auto load = [&](const string& text) {
+            istringstream file(text);
+            importer.read(file, format, "bench", error);
+        };
+        measure(csv ? "import_roster_csv" : "import_roster_segments", 0, staffCount, 1, [&](size_t) {
+            for (const string& file : roster) load(file);
+            importer.commit(errors);
+        });
+        measure(csv ? "import_csv" : "import_segments", patients, staffCount, batches.size(), [&](size_t i) {
+            load(batches[i]);
+            importer.commit(errors);
+        });
+    }
+}
+
+int main(int argc, char* argv[]) {
+    vector<size_t> patientScales = {1000, 10000, 100000, 1000000};
+    vector<size_t> staffScales = {100, 1000, 50000};
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--json") jsonOutput = true;
+        else if (arg == "--patients" && i + 1 < argc) patientScales = parseList(argv[++i]);
+        else if (arg == "--staff" && i + 1 < argc) staffScales = parseList(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--no-metrics") setMetricsEnabled(false);
+        else {
+            cerr << "usage: hms_bench [--patients N,N,...] [--staff N,N,...] [--json] [--seed N] [--no-metrics]\n";
+            return 1;
+        }
+    }
+
+    if (!jsonOutput) {
+        printf("%-22s %10s %7s %10s %14s %9s %9s %8s\n", "benchmark", "patients", "staff", "ops", "ops/s", "p50 ns",
+               "p99 ns", "allocs");
+    }
+    for (size_t patients : patientScales) {
+        if (patients) patientBenchmarks(patients);
+    }
+    for (size_t staff : staffScales) {
+        if (staff) staffBenchmarks(staff);
+    }
+    if (!patientScales.empty() && !staffScales.empty()) {
+        batchBenchmark(min<size_t>(patientScales.back(), 100000), staffScales.front());
+        schedulerBenchmark(min<size_t>(patientScales.back(), 10000), min<size_t>(staffScales.back(), 1000));
+        calendarBenchmark(min<size_t>(patientScales.back(), 100000), min<size_t>(staffScales.back(), 1000));
+        analyticsBenchmark(10 * patientScales.back(), min<size_t>(staffScales.back(), 1000));
+        changeFeedBenchmark(min<size_t>(patientScales.back(), 1000000));
+        importBenchmark(patientScales.back(), min<size_t>(staffScales.back(), 20000));
+    }
+    return 0;
+}
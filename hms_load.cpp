@@ -0,0 +1,246 @@
+// Load client for HMS --serve.
+//
+//   hms_load ADDRESS [--connections N] [--depth N] [--patients N] [--json]
+//
+// Sets up ten departments with staff and a ward over one connection, then
+// takes --patients patients through a stay (register, lookup, a dated
+// visit with the department's first opening, hospitalize, discharge),
+// spread over the connections. Each connection keeps --depth commands in
+// flight. Latency runs from writing a command to reading its reply.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "calendar.h"
+#include "history.h"
+#include "metrics.h"
+#include "server.h"
+using namespace std;
+using namespace hms;
+
+namespace {
+
+const int DEPARTMENTS = 10;
+const int STAFF_PER_DEPARTMENT = 20;
+const int STEPS = 5; // commands per patient
+const char* const STEP_NAMES[STEPS] = {"register", "lookup", "visit", "hospitalize", "discharge"};
+
+uint64_t nowNs() {
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+string departmentName(size_t i) { return "Load " + to_string(i % DEPARTMENTS); }
+
+struct Tally {
+    array<uint64_t, LATENCY_BUCKETS> latency{};
+    uint64_t replies = 0;
+    uint64_t maxNs = 0;
+    array<uint64_t, STEPS> errors{};
+    array<string, STEPS> firstError;
+};
+
+bool sendAll(int fd, const string& bytes) {
+    for (size_t sent = 0; sent < bytes.size();) {
+        ssize_t n = send(fd, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        sent += (size_t)n;
+    }
+    return true;
+}
+
+// Sends the commands in order with up to `depth` awaiting replies
+bool drive(int fd, size_t total, size_t depth, const function<string(size_t)>& command,
+           const function<void(size_t, bool, string_view, uint64_t)>& replied) {
+    vector<uint64_t> sentAt(total);
+    string out, in;
+    char buffer[65536];
+    size_t next = 0, done = 0;
+    while (done < total) {
+        out.clear();
+        uint64_t now = nowNs();
+        for (; next < total && next - done < depth; ++next) {
+            encodeRequest(out, (uint32_t)next, command(next));
+            sentAt[next] = now;
+        }
+        if (!out.empty() && !sendAll(fd, out)) return false;
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received <= 0) return false;
+        in.append(buffer, (size_t)received);
+        now = nowNs();
+        size_t used = 0;
+        Frame frame;
+        long length;
+        while ((length = decodeFrame(in.data() + used, in.size() - used, frame)) > 0) {
+            used += (size_t)length;
+            if (frame.tag >= total || frame.body.empty()) return false;
+            replied(frame.tag, frame.body[0] == 0, frame.body.substr(1), now - sentAt[frame.tag]);
+            ++done;
+        }
+        if (length < 0) return false;
+        in.erase(0, used);
+    }
+    return true;
+}
+
+// Departments, staff on call around the clock and a ward, unless a
+// previous run made them
+bool setUp(const string& address, size_t beds, string& error) {
+    int fd = connectSocket(address, error);
+    if (fd < 0) return false;
+    vector<string> commands;
+    bool fresh = true, ok = true;
+    commands.push_back("add-department|" + departmentName(0));
+    drive(fd, 1, 1, [&](size_t) { return commands[0]; }, [&](size_t, bool done, string_view, uint64_t) { fresh = done; });
+    if (fresh) {
+        commands.clear();
+        for (int d = 1; d < DEPARTMENTS; ++d) commands.push_back("add-department|" + departmentName(d));
+        for (int d = 0; d < DEPARTMENTS; ++d) {
+            for (int s = 0; s < STAFF_PER_DEPARTMENT; ++s) {
+                string name = "Load Staff " + to_string(d) + "-" + to_string(s);
+                commands.push_back(string(s % 4 ? "hire|nurse|" : "hire|doctor|") + name + "|" + departmentName(d));
+                commands.push_back("shift|" + name + "|daily|00:00|00:00");
+            }
+        }
+        commands.push_back("configure-rooms|Load Ward|" + to_string(beds) + "|0");
+        ok = drive(fd, commands.size(), 64, [&](size_t i) { return commands[i]; },
+                   [&](size_t i, bool done, string_view text, uint64_t) {
+                       if (!done && error.empty()) error = commands[i] + ": " + string(text);
+                   });
+        ok = ok && error.empty();
+    }
+    close(fd);
+    return ok;
+}
+
+double percentileUs(const array<uint64_t, LATENCY_BUCKETS>& latency, uint64_t count, double fraction) {
+    uint64_t rank = (uint64_t)(fraction * count), seen = 0;
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; ++bucket) {
+        seen += latency[bucket];
+        if (seen > rank) return bucketFloor(bucket) / 1000.0;
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argv[1][0] == '-') {
+        cerr << "usage: hms_load ADDRESS [--connections N] [--depth N] [--patients N] [--json]\n";
+        return 1;
+    }
+    string address = argv[1];
+    size_t connections = 8, depth = 32, patients = 50000;
+    bool json = false;
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--json") json = true;
+        else if (arg == "--connections" && i + 1 < argc) connections = max(atoi(argv[++i]), 1);
+        else if (arg == "--depth" && i + 1 < argc) depth = min(max(atoi(argv[++i]), 1), 1024);
+        else if (arg == "--patients" && i + 1 < argc) patients = max(atoi(argv[++i]), 1);
+        else {
+            cerr << "unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+    string error;
+    if (!setUp(address, max<size_t>(connections * depth, 1000), error)) {
+        cerr << "setup failed: " << error << "\n";
+        return 1;
+    }
+
+    // Patient IDs are unique to the run, visits start tomorrow
+    string prefix = "L" + to_string(time(0) % 1000000) + "-" + to_string(getpid() % 1000) + "-";
+    string visitDay = formatCivilDate(civilSeconds(time(0)) + 86400);
+
+    vector<Tally> tallies(connections);
+    vector<char> failed(connections);
+    vector<thread> clients;
+    uint64_t started = nowNs();
+    for (size_t c = 0; c < connections; ++c) {
+        clients.emplace_back([&, c] {
+            string connectError;
+            int fd = connectSocket(address, connectError);
+            if (fd < 0) {
+                failed[c] = true;
+                return;
+            }
+            size_t mine = patients / connections + (c < patients % connections);
+            Tally& tally = tallies[c];
+            auto command = [&](size_t i) {
+                size_t patient = (i / STEPS) * connections + c;
+                string id = prefix + to_string(patient);
+                switch (i % STEPS) {
+                case 0: return "register|" + id + "|Load Patient " + to_string(patient) + "|40|checkup|" +
+                               departmentName(patient);
+                case 1: return "lookup|" + id;
+                case 2: return "visit|" + id + "||" + visitDay + " 08:00|15";
+                case 3: return "hospitalize|" + id + "|Load Ward";
+                default: return "discharge|" + id;
+                }
+            };
+            auto replied = [&](size_t i, bool ok, string_view text, uint64_t ns) {
+                ++tally.replies;
+                ++tally.latency[latencyBucket(ns)];
+                tally.maxNs = max(tally.maxNs, ns);
+                if (ok) return;
+                if (!tally.errors[i % STEPS]++) tally.firstError[i % STEPS] = string(text);
+            };
+            failed[c] = !drive(fd, mine * STEPS, depth, command, replied);
+            close(fd);
+        });
+    }
+    for (auto& client : clients) client.join();
+    double seconds = (nowNs() - started) / 1e9;
+
+    Tally total;
+    for (const Tally& tally : tallies) {
+        total.replies += tally.replies;
+        total.maxNs = max(total.maxNs, tally.maxNs);
+        for (int b = 0; b < LATENCY_BUCKETS; ++b) total.latency[b] += tally.latency[b];
+        for (int s = 0; s < STEPS; ++s) {
+            if (total.firstError[s].empty()) total.firstError[s] = tally.firstError[s];
+            total.errors[s] += tally.errors[s];
+        }
+    }
+    size_t lost = count(failed.begin(), failed.end(), (char)true);
+    double p50 = percentileUs(total.latency, total.replies, 0.50);
+    double p99 = percentileUs(total.latency, total.replies, 0.99);
+    double p999 = percentileUs(total.latency, total.replies, 0.999);
+    double perSecond = seconds > 0 ? total.replies / seconds : 0;
+    uint64_t errors = 0;
+    for (uint64_t e : total.errors) errors += e;
+
+    if (json) {
+        printf("{\"connections\":%zu,\"depth\":%zu,\"requests\":%llu,\"errors\":%llu,\"seconds\":%.3f,"
+               "\"requests_per_sec\":%.0f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"max_us\":%.1f}\n",
+               connections, depth, (unsigned long long)total.replies, (unsigned long long)errors, seconds, perSecond,
+               p50, p99, p999, total.maxNs / 1000.0);
+    } else {
+        printf("%zu connections, depth %zu: %llu requests in %.2f s, %.0f requests/s\n", connections, depth,
+               (unsigned long long)total.replies, seconds, perSecond);
+        printf("latency p50 %.0f us, p99 %.0f us, p99.9 %.0f us, max %.0f us\n", p50, p99, p999,
+               total.maxNs / 1000.0);
+        for (int s = 0; s < STEPS; ++s) {
+            if (total.errors[s]) {
+                printf("%s: %llu errors, e.g. %s\n", STEP_NAMES[s], (unsigned long long)total.errors[s],
+                       total.firstError[s].c_str());
+            }
+        }
+    }
+    if (lost) cerr << lost << " connections failed\n";
+    return lost ? 1 : 0;
+}
@@ -0,0 +1,1226 @@
+#include "hospital.h"
+
+#include <cstdint>
+
+#include "metrics.h"
+
+namespace hms {
+
+const char* statusMessage(HmsStatus status) {
+    switch (status) {
+    case HmsStatus::Ok: return "OK";
+    case HmsStatus::NotFound: return "not found";
+    case HmsStatus::DuplicateId: return "already exists";
+    case HmsStatus::InvalidArgument: return "invalid argument";
+    case HmsStatus::NoDepartment: return "patient has no department";
+    case HmsStatus::SlotUnavailable: return "the selected time is not available";
+    case HmsStatus::NoRoomAvailable: return "no room available";
+    case HmsStatus::AlreadyHospitalized: return "patient is already hospitalized";
+    case HmsStatus::StorageError: return "storage error";
+    case HmsStatus::NotHospitalized: return "patient is not hospitalized";
+    }
+    return "unknown status";
+}
+
+namespace {
+
+void encodeTimetable(BinaryWriter& out, const Timetable& table) {
+    out.i32(table.dayCount());
+    out.i32(table.slotsPerHour());
+    out.bits(table.workBits());
+    out.bits(table.bookedBits());
+}
+
+void decodeTimetable(BinaryReader& in, Timetable& table) {
+    int days = in.i32();
+    int perHour = in.i32();
+    vector<uint64_t> work = in.bits();
+    vector<uint64_t> booked = in.bits();
+    table = Timetable(days, perHour);
+    table.assignBits(work, booked);
+}
+
+void encodePatientFields(BinaryWriter& out, const Patient& patient) {
+    out.str(patient.id);
+    out.str(patient.name);
+    out.i32(patient.age);
+    out.str(patient.reasonForVisit);
+    out.str(patient.department);
+}
+
+void decodePatientFields(BinaryReader& in, Patient& patient) {
+    patient.id = in.str();
+    patient.name = in.str();
+    patient.age = in.i32();
+    patient.reasonForVisit = in.str();
+    patient.department = in.str();
+}
+
+void encodeStaff(BinaryWriter& out, const StaffDirectory& directory, size_t row) {
+    out.u8((uint8_t)directory.roles()[row]);
+    out.str(directory.names()[row]);
+    out.str(directory.departments()[row]);
+    encodeTimetable(out, directory.timetables()[row]);
+}
+
+void encodeShift(BinaryWriter& out, const ShiftTemplate& shift) {
+    out.u8(shift.weekdays);
+    out.i32(shift.startMinute);
+    out.i32(shift.minutes);
+}
+
+bool decodeShift(BinaryReader& in, ShiftTemplate& shift) {
+    shift.weekdays = in.u8();
+    shift.startMinute = (int16_t)in.i32();
+    shift.minutes = (int16_t)in.i32();
+    return in.ok && shift.valid();
+}
+
+void encodeCalendar(BinaryWriter& out, const Calendar& calendar) {
+    out.u32((uint32_t)calendar.shifts().size());
+    for (const ShiftTemplate& shift : calendar.shifts()) encodeShift(out, shift);
+    out.u32((uint32_t)calendar.visits().size());
+    for (const auto& visit : calendar.visits()) {
+        out.i64(visit.first);
+        out.i64(visit.second.end);
+        out.str(visit.second.patientId);
+        out.u8(visit.second.hourly);
+    }
+}
+
+void decodeCalendar(BinaryReader& in, Calendar& calendar) {
+    for (uint32_t n = in.u32(); n > 0 && in.ok; --n) {
+        ShiftTemplate shift;
+        if (decodeShift(in, shift)) calendar.addShift(shift);
+    }
+    for (uint32_t n = in.u32(); n > 0 && in.ok; --n) {
+        int64_t start = in.i64();
+        int64_t end = in.i64();
+        string patientId = in.str();
+        bool hourly = in.u8() != 0;
+        if (in.ok) calendar.book(start, end, patientId, hourly);
+    }
+}
+
+bool decodeStaff(BinaryReader& in, Staff& member, StaffRole& role) {
+    role = (StaffRole)in.u8();
+    member.name = in.str();
+    member.department = in.str();
+    decodeTimetable(in, member.timetable);
+    return in.ok && (int)role < STAFF_ROLE_COUNT;
+}
+
+} // namespace
+
+Hospital::Hospital() = default;
+
+Hospital::~Hospital() {
+    close();
+}
+
+// Consecutive records of the registry land on consecutive stripes
+mutex& Hospital::lockFor(const Patient& patient) const {
+    return patientLocks[(uintptr_t)&patient / sizeof(Patient) % PATIENT_LOCK_STRIPES].lock;
+}
+
+mutex& Hospital::calendarLockFor(StaffRef member) const {
+    return calendarLocks[(size_t)member.id() % CALENDAR_LOCK_STRIPES].lock;
+}
+
+void Hospital::log(LogOp op, const BinaryWriter& payload) {
+    if (journal) journal->append(op, payload.bytes);
+}
+
+void Hospital::publish(const ChangeEvent& change) {
+    if (live()) feed.publish(change);
+}
+
+// --- Persistence -------------------------------------------------------------
+
+HmsStatus Hospital::open(const string& dataDirectory) {
+    storage.reset(new Storage(dataDirectory));
+    journal = nullptr;
+    recovering = true;
+    bool ok = storage->recover([this](BinaryReader& in) { return loadSnapshot(in); },
+                               [this](LogOp op, BinaryReader& in) { replay(op, in); });
+    recovering = false;
+    if (ok) dropArchivedPatients();
+    for (auto& room : roomList) room.rebuildFreeList();
+    searchIndex.rebuild(registry);
+    if (!ok) {
+        storage.reset();
+        return HmsStatus::StorageError;
+    }
+    registry.attachArchive(&storage->archive());
+    recountBoard();
+    journal = &storage->journal();
+    return HmsStatus::Ok;
+}
+
+HmsStatus Hospital::checkpoint() {
+    if (!storage) return HmsStatus::StorageError;
+    lock_guard<shared_mutex> structure(structureLock);
+    lock_guard<shared_mutex> records(registryLock);
+    if (!journal->sync()) return HmsStatus::StorageError;
+    archiveClosedPatients();
+    compactHistory();
+    trimCalendars();
+    searchIndex.rebuild(registry);
+    bool ok = storage->checkpoint([this](BinaryWriter& out) { writeSnapshot(out); });
+    return ok ? HmsStatus::Ok : HmsStatus::StorageError;
+}
+
+bool Hospital::checkpointDue() {
+    return storage && storage->checkpointDue();
+}
+
+void Hospital::close() {
+    journal = nullptr;
+    if (storage) storage->close();
+}
+
+const string& Hospital::dataDirectory() const {
+    static const string none;
+    return storage ? storage->directory() : none;
+}
+
+HmsStatus Hospital::syncLog() {
+    return !journal || journal->sync() ? HmsStatus::Ok : HmsStatus::StorageError;
+}
+
+uint64_t Hospital::logPosition() const {
+    return journal ? journal->lastLsn() : appliedLsn.load(memory_order_acquire);
+}
+
+// --- Replication -------------------------------------------------------------
+
+bool Hospital::startReplica(const string& snapshot, uint64_t& lsn) {
+    if (storage || !empty()) return false;
+    recovering = true;
+    lsn = 0;
+    if (!snapshot.empty() && !decodeSnapshot(snapshot, [this](BinaryReader& in) { return loadSnapshot(in); }, lsn)) {
+        return false;
+    }
+    for (auto& room : roomList) room.rebuildFreeList();
+    searchIndex.rebuild(registry);
+    recountBoard();
+    appliedLsn = lsn;
+    replica = true;
+    return true;
+}
+
+// Records arrive in log order on one thread, so they replay as they would
+// from the replica's own log
+void Hospital::applyReplicated(uint64_t lsn, LogOp op, BinaryReader& payload) {
+    if (!replica || lsn <= appliedLsn.load(memory_order_relaxed)) return;
+    replay(op, payload);
+    appliedLsn.store(lsn, memory_order_release);
+}
+
+// A record is closed once the patient is discharged and not in a room
+void Hospital::archiveClosedPatients() {
+    vector<const Patient*> closed;
+    for (const auto& patient : registry) {
+        if (!patient.hospitalized && !patient.dischargeDate.empty()) closed.push_back(&patient);
+    }
+    if (closed.empty() || !storage->archive().append(closed)) return;
+    vector<string> ids;
+    for (const Patient* patient : closed) {
+        countArchived(*patient);
+        ids.push_back(patient->id);
+    }
+    for (const auto& id : ids) registry.remove(id);
+    // Days the board no longer shows
+    while (!archivedDischarges.empty() &&
+           archivedDischarges.begin()->first + (int64_t)StatusBoard::DISCHARGE_DAYS <= archivedDischarges.rbegin()->first) {
+        archivedDischarges.erase(archivedDischarges.begin());
+    }
+}
+
+void Hospital::countArchived(const Patient& patient) {
+    patient.history.forEach([this](const HistoryEvent& event) {
+        if (event.kind == EventKind::Discharged) ++archivedDischarges[dayOf(civilSeconds((time_t)event.epoch) / 60)];
+    });
+}
+
+// A crash after the archive was replaced but before the snapshot was
+// written leaves its new records in the snapshot or log as well; the
+// archived copies are the ones kept
+void Hospital::dropArchivedPatients() {
+    const PatientArchive& archive = storage->archive();
+    if (archive.empty()) return;
+    vector<string> archived;
+    for (const auto& patient : registry) {
+        if (!archive.contains(patient.id)) continue;
+        countArchived(patient);
+        archived.push_back(patient.id);
+    }
+    for (const auto& id : archived) registry.remove(id);
+}
+
+// Drops events of archived patients once they make up most of the store
+void Hospital::compactHistory() {
+    size_t liveEvents = 0;
+    vector<PatientHistory*> histories;
+    for (auto& patient : registry) {
+        liveEvents += patient.history.size();
+        histories.push_back(&patient.history);
+    }
+    if (eventStore.size() > 2 * liveEvents) eventStore.compact(histories);
+}
+
+// Visits that are over stay in the patients' histories only
+void Hospital::trimCalendars() {
+    int64_t now = civilSeconds(time(0)) / 60;
+    for (size_t row = 0; row < directory.size(); ++row) directory.calendar(row).dropBefore(now);
+}
+
+// Counts the status board from the state loaded; archived patients count
+// through the discharge days the snapshot carries
+void Hospital::recountBoard() {
+    board.clear();
+    for (const auto& room : roomList) board.bedsFreed(room.availableRooms());
+    for (size_t row = 0; row < directory.size(); ++row) {
+        board.countHours(directory.departments()[row], directory.timetables()[row], 1);
+    }
+    for (const Patient& patient : registry) {
+        if (patient.hospitalized) board.admitted(patient.department, 1);
+        patient.history.forEach([this](const HistoryEvent& event) {
+            if (event.kind == EventKind::Discharged) board.discharged(dayOf(civilSeconds((time_t)event.epoch) / 60));
+        });
+    }
+    for (const auto& day : archivedDischarges) {
+        for (int n = 0; n < day.second; ++n) board.discharged(day.first);
+    }
+}
+
+// Snapshot body after the LSN: departments, rooms, staff, calendars,
+// patients, then discharges of archived patients by day
+void Hospital::writeSnapshot(BinaryWriter& out) const {
+    out.u32((uint32_t)departmentList.size());
+    for (const auto& department : departmentList) out.str(department);
+    out.u32((uint32_t)roomList.size());
+    for (const auto& room : roomList) {
+        out.str(room.type);
+        out.i32(room.totalRooms);
+        string beds;
+        for (int bed = 0; bed < room.totalRooms; ++bed) beds.push_back((char)room.bedState(bed));
+        out.str(beds);
+    }
+    out.u32((uint32_t)directory.size());
+    for (size_t row = 0; row < directory.size(); ++row) encodeStaff(out, directory, row);
+    out.u32((uint32_t)directory.size());
+    for (const Calendar& calendar : directory.calendars()) encodeCalendar(out, calendar);
+    out.u32((uint32_t)registry.size());
+    for (const auto& patient : registry) {
+        encodePatientFields(out, patient);
+        out.u8(patient.hospitalized);
+        out.str(patient.roomType);
+        out.i32(patient.bed);
+        out.str(patient.hospitalizationDate);
+        out.str(patient.dischargeDate);
+        out.u32((uint32_t)patient.history.size());
+        patient.history.forEach([&](const HistoryEvent& event) {
+            out.u8((uint8_t)event.kind);
+            out.i64(event.epoch);
+            out.i32(event.staffId);
+            out.str(eventStore.name(event.subject));
+            out.i32(event.hour);
+        });
+    }
+    out.u32((uint32_t)archivedDischarges.size());
+    for (const auto& day : archivedDischarges) {
+        out.i64(day.first);
+        out.i32(day.second);
+    }
+}
+
+bool Hospital::loadSnapshot(BinaryReader& in) {
+    for (uint32_t n = in.u32(); n > 0 && in.ok; --n) addDepartment(in.str());
+    for (uint32_t n = in.u32(); n > 0 && in.ok; --n) {
+        string type = in.str();
+        int total = in.i32();
+        string beds = in.str();
+        if (!in.ok || (int)beds.size() != total) return false;
+        Room room(type, total);
+        for (int bed = 0; bed < total; ++bed) room.markBed(bed, (BedState)beds[bed]);
+        roomList.push_back(room);
+    }
+    for (uint32_t n = in.u32(); n > 0 && in.ok; --n) {
+        Staff member;
+        StaffRole role;
+        if (decodeStaff(in, member, role)) hireStaff(role, move(member));
+    }
+    for (uint32_t row = 0, n = in.u32(); row < n && in.ok; ++row) {
+        Calendar calendar;
+        decodeCalendar(in, calendar);
+        if (row < directory.size()) directory.calendar(row) = move(calendar);
+    }
+    for (uint32_t n = in.u32(); n > 0 && in.ok; --n) {
+        Patient patient;
+        decodePatientFields(in, patient);
+        patient.hospitalized = in.u8() != 0;
+        patient.roomType = in.str();
+        patient.bed = in.i32();
+        patient.hospitalizationDate = in.str();
+        patient.dischargeDate = in.str();
+        for (uint32_t events = in.u32(); events > 0 && in.ok; --events) {
+            HistoryEvent event;
+            event.kind = (EventKind)in.u8();
+            event.epoch = in.i64();
+            event.staffId = in.i32();
+            event.subject = eventStore.intern(in.str());
+            event.hour = (int8_t)in.i32();
+            patient.addEvent(event);
+        }
+        if (in.ok) registry.add(patient);
+    }
+    for (uint32_t n = in.u32(); n > 0 && in.ok; --n) {
+        int64_t day = in.i64();
+        archivedDischarges[day] = in.i32();
+    }
+    return in.ok;
+}
+
+// Applies one log record through the same operations the callers use;
+// records that no longer fit the state are skipped
+void Hospital::replay(LogOp op, BinaryReader& in) {
+    switch (op) {
+    case LogOp::AddDepartment: {
+        string name = in.str();
+        if (in.ok) addDepartment(name);
+        break;
+    }
+    case LogOp::AddRoom: {
+        string type = in.str();
+        int total = in.i32();
+        int occupied = in.i32();
+        if (in.ok) addRoomType(type, total, occupied);
+        break;
+    }
+    case LogOp::UpdateRoom: {
+        uint32_t index = in.u32();
+        int total = in.i32();
+        int occupied = in.i32();
+        if (in.ok) updateRoom(index, total, occupied);
+        break;
+    }
+    case LogOp::AddStaff: {
+        Staff member;
+        StaffRole role;
+        if (decodeStaff(in, member, role)) hireStaff(role, move(member));
+        break;
+    }
+    case LogOp::RegisterPatient: {
+        Patient patient;
+        decodePatientFields(in, patient);
+        if (in.ok) registerPatient(patient);
+        break;
+    }
+    case LogOp::AssignDepartment: {
+        Patient* patient = registry.findById(in.str());
+        string department = in.str();
+        if (in.ok && patient) assignDepartment(*patient, department);
+        break;
+    }
+    case LogOp::ScheduleAppointment: {
+        Patient* patient = registry.findById(in.str());
+        uint32_t staffId = in.u32();
+        int hour = in.i32();
+        time_t when = (time_t)in.i64();
+        if (in.ok && patient && staffId < directory.size()) {
+            bookAppointment(*patient, directory.member(staffId), hour, when);
+        }
+        break;
+    }
+    case LogOp::Hospitalize: {
+        Patient* patient = registry.findById(in.str());
+        uint32_t roomIndex = in.u32();
+        int bed = in.i32();
+        time_t when = (time_t)in.i64();
+        if (!in.ok || !patient) break;
+        // A replica's server reads the patient meanwhile, as hospitalize() locks
+        shared_lock<shared_mutex> structure(structureLock);
+        lock_guard<mutex> record(lockFor(*patient));
+        if (!patient->hospitalized && roomIndex < roomList.size() && bed >= 0 &&
+            bed < roomList[roomIndex].totalRooms) {
+            markBed(roomIndex, bed, BedState::Patient);
+            admit(*patient, roomIndex, bed, when);
+        }
+        break;
+    }
+    case LogOp::Discharge: {
+        Patient* patient = registry.findById(in.str());
+        time_t when = (time_t)in.i64();
+        if (in.ok && patient) discharge(*patient, when);
+        break;
+    }
+    case LogOp::UpdateTimetable: {
+        uint32_t staffId = in.u32();
+        int startHour = in.i32();
+        int endHour = in.i32();
+        SlotState state = (SlotState)in.u8();
+        if (in.ok && staffId < directory.size()) {
+            updateTimetable(directory.member(staffId), startHour, endHour, state);
+        }
+        break;
+    }
+    case LogOp::AddShift: {
+        uint32_t staffId = in.u32();
+        ShiftTemplate shift;
+        if (decodeShift(in, shift) && staffId < directory.size()) addShift(directory.member(staffId), shift);
+        break;
+    }
+    case LogOp::ClearShifts: {
+        uint32_t staffId = in.u32();
+        if (in.ok && staffId < directory.size()) clearShifts(directory.member(staffId));
+        break;
+    }
+    case LogOp::BookVisit: {
+        Patient* patient = registry.findById(in.str());
+        uint32_t staffId = in.u32();
+        int64_t start = in.i64();
+        int minutes = in.i32();
+        if (in.ok && patient && staffId < directory.size()) {
+            bookVisit(*patient, directory.member(staffId), start, minutes);
+        }
+        break;
+    }
+    case LogOp::BulkAdd: {
+        BulkRecords records;
+        for (uint32_t n = in.u32(); n > 0 && in.ok; --n) records.departments.push_back(in.str());
+        for (uint32_t n = in.u32(); n > 0 && in.ok; --n) {
+            BulkRecords::RoomCount count;
+            count.type = in.str();
+            count.total = in.i32();
+            count.occupied = in.i32();
+            records.rooms.push_back(count);
+        }
+        for (uint32_t n = in.u32(); n > 0 && in.ok; --n) {
+            BulkRecords::Hire hire;
+            if (decodeStaff(in, hire.member, hire.role)) records.staff.push_back(move(hire));
+        }
+        for (uint32_t n = in.u32(); n > 0 && in.ok; --n) {
+            Patient patient;
+            decodePatientFields(in, patient);
+            records.patients.push_back(move(patient));
+        }
+        if (in.ok) bulkAdd(records);
+        break;
+    }
+    case LogOp::CancelVisit: {
+        uint32_t staffId = in.u32();
+        int64_t start = in.i64();
+        if (in.ok && staffId < directory.size()) cancelVisit(directory.member(staffId), start);
+        break;
+    }
+    case LogOp::ReassignStaff: {
+        uint32_t staffId = in.u32();
+        string department = in.str();
+        if (in.ok && staffId < directory.size()) reassignStaff(directory.member(staffId), department);
+        break;
+    }
+    }
+}
+
+// --- Configuration -----------------------------------------------------------
+
+HmsStatus Hospital::addDepartment(const string& name) {
+    if (name.empty()) return HmsStatus::InvalidArgument;
+    lock_guard<shared_mutex> structure(structureLock);
+    Symbol department(name);
+    if (!departmentSet.insert(department).second) return HmsStatus::DuplicateId;
+    departmentList.push_back(department);
+    BinaryWriter rec;
+    rec.str(name);
+    log(LogOp::AddDepartment, rec);
+    ChangeEvent change(ChangeKind::DepartmentAdded, time(0));
+    change.symbol = department.id();
+    publish(change);
+    return HmsStatus::Ok;
+}
+
+HmsStatus Hospital::addRoomType(const string& type, int total, int occupied) {
+    OperationTimer timer(Operation::RoomUpdate, !recovering);
+    if (type.empty() || total < 0 || occupied < 0 || occupied > total) {
+        return timer.result(HmsStatus::InvalidArgument);
+    }
+    lock_guard<shared_mutex> structure(structureLock);
+    if (roomIndex(type) >= 0) return timer.result(HmsStatus::DuplicateId);
+    roomList.push_back(Room(type, total, occupied));
+    if (live()) board.bedsFreed(roomList.back().availableRooms());
+    BinaryWriter rec;
+    rec.str(type);
+    rec.i32(total);
+    rec.i32(occupied);
+    log(LogOp::AddRoom, rec);
+    ChangeEvent change(ChangeKind::RoomUpdated, time(0));
+    change.symbol = roomList.back().type.id();
+    change.first = total;
+    change.second = occupied;
+    publish(change);
+    return timer.result(HmsStatus::Ok);
+}
+
+HmsStatus Hospital::updateRoom(size_t index, int total, int occupied) {
+    OperationTimer timer(Operation::RoomUpdate, !recovering);
+    if (total < 0 || occupied < 0) return timer.result(HmsStatus::InvalidArgument);
+    lock_guard<shared_mutex> structure(structureLock);
+    if (index >= roomList.size()) return timer.result(HmsStatus::NotFound);
+    int wasFree = roomList[index].availableRooms();
+    if (!roomList[index].resize(total, occupied)) return timer.result(HmsStatus::InvalidArgument);
+    if (live()) board.bedsFreed(roomList[index].availableRooms() - wasFree);
+    BinaryWriter rec;
+    rec.u32((uint32_t)index);
+    rec.i32(total);
+    rec.i32(occupied);
+    log(LogOp::UpdateRoom, rec);
+    ChangeEvent change(ChangeKind::RoomUpdated, time(0));
+    change.symbol = roomList[index].type.id();
+    change.first = total;
+    change.second = occupied;
+    publish(change);
+    return timer.result(HmsStatus::Ok);
+}
+
+int Hospital::findRoom(const string& type) const {
+    Symbol symbol;
+    if (!Symbol::find(type, symbol)) return -1;
+    shared_lock<shared_mutex> structure(structureLock);
+    return roomIndex(symbol);
+}
+
+// Callers hold structureLock
+int Hospital::roomIndex(Symbol type) const {
+    for (size_t i = 0; i < roomList.size(); ++i) {
+        if (roomList[i].type == type) return (int)i;
+    }
+    return -1;
+}
+
+BedState Hospital::bedState(size_t roomIndex, int bed) const {
+    shared_lock<shared_mutex> structure(structureLock);
+    if (roomIndex >= roomList.size() || bed < 0 || bed >= roomList[roomIndex].totalRooms) return BedState::Free;
+    return roomList[roomIndex].bedState(bed);
+}
+
+HmsStatus Hospital::hireStaff(StaffRole role, Staff member, StaffRef* hired) {
+    if (member.name.empty() || (int)role >= STAFF_ROLE_COUNT) return HmsStatus::InvalidArgument;
+    lock_guard<shared_mutex> structure(structureLock);
+    StaffRef added = directory.add(role, move(member));
+    if (live()) board.countHours(added.department(), added.timetable(), 1);
+    BinaryWriter rec;
+    encodeStaff(rec, directory, (size_t)added.id());
+    log(LogOp::AddStaff, rec);
+    ChangeEvent change(ChangeKind::StaffHired, time(0));
+    change.staff = added.id();
+    change.symbol = added.department().id();
+    change.first = (int32_t)role;
+    publish(change);
+    if (hired) *hired = added;
+    return HmsStatus::Ok;
+}
+
+HmsStatus Hospital::updateTimetable(StaffRef member, int startHour, int endHour, SlotState state) {
+    OperationTimer timer(Operation::TimetableEdit, !recovering);
+    if (!member || startHour < 0 || endHour < startHour || endHour >= HOURS_IN_DAY) {
+        return timer.result(HmsStatus::InvalidArgument);
+    }
+    lock_guard<shared_mutex> structure(structureLock);
+    if (live()) board.countHours(member.department(), member.timetable(), -1, startHour, endHour);
+    member.timetable().setHours(startHour, endHour, state);
+    if (live()) board.countHours(member.department(), member.timetable(), 1, startHour, endHour);
+    BinaryWriter rec;
+    rec.u32((uint32_t)member.id());
+    rec.i32(startHour);
+    rec.i32(endHour);
+    rec.u8((uint8_t)state);
+    log(LogOp::UpdateTimetable, rec);
+    ChangeEvent change(ChangeKind::TimetableEdited, time(0));
+    change.staff = member.id();
+    change.hour = (int16_t)startHour;
+    change.first = endHour;
+    change.second = (int32_t)state;
+    publish(change);
+    return timer.result(HmsStatus::Ok);
+}
+
+HmsStatus Hospital::reassignStaff(StaffRef member, const string& department) {
+    if (!member) return HmsStatus::InvalidArgument;
+    Symbol symbol;
+    if (!Symbol::find(department, symbol)) return HmsStatus::NotFound;
+    lock_guard<shared_mutex> structure(structureLock);
+    if (!departmentSet.count(symbol)) return HmsStatus::NotFound;
+    if (live()) board.countHours(member.department(), member.timetable(), -1);
+    directory.reassign(member, symbol);
+    if (live()) board.countHours(symbol, member.timetable(), 1);
+    BinaryWriter rec;
+    rec.u32((uint32_t)member.id());
+    rec.str(department);
+    log(LogOp::ReassignStaff, rec);
+    ChangeEvent change(ChangeKind::StaffReassigned, time(0));
+    change.staff = member.id();
+    change.symbol = symbol.id();
+    publish(change);
+    return HmsStatus::Ok;
+}
+
+HmsStatus Hospital::bulkAdd(BulkRecords& records) {
+    lock_guard<shared_mutex> structure(structureLock);
+    lock_guard<shared_mutex> registered(registryLock);
+    records.addedDepartments = 0;
+    records.rejectedRooms.clear();
+    records.rejectedStaff.clear();
+    records.rejectedPatients.clear();
+    // The record holds what was added, each section behind its count
+    bool logging = journal != nullptr;
+    BinaryWriter sections[4];
+    uint32_t counts[4] = {};
+    time_t now = time(0);
+
+    for (const string& name : records.departments) {
+        if (name.empty()) continue;
+        Symbol department(name);
+        if (!departmentSet.insert(department).second) continue;
+        departmentList.push_back(department);
+        ++records.addedDepartments;
+        if (logging) sections[0].str(name);
+        ++counts[0];
+        ChangeEvent change(ChangeKind::DepartmentAdded, now);
+        change.symbol = department.id();
+        publish(change);
+    }
+
+    for (size_t i = 0; i < records.rooms.size(); ++i) {
+        const BulkRecords::RoomCount& count = records.rooms[i];
+        bool ok = !count.type.empty() && count.total >= 0 && count.occupied >= 0 && count.occupied <= count.total;
+        int index = ok ? roomIndex(Symbol(count.type)) : -1;
+        int wasFree = 0;
+        if (ok && index >= 0) {
+            wasFree = roomList[index].availableRooms();
+            ok = roomList[index].resize(count.total, count.occupied);
+        } else if (ok) {
+            index = (int)roomList.size();
+            roomList.push_back(Room(count.type, count.total, count.occupied));
+        }
+        if (!ok) {
+            records.rejectedRooms.push_back(i);
+            continue;
+        }
+        if (live()) board.bedsFreed(roomList[index].availableRooms() - wasFree);
+        if (logging) {
+            sections[1].str(count.type);
+            sections[1].i32(count.total);
+            sections[1].i32(count.occupied);
+        }
+        ++counts[1];
+        ChangeEvent change(ChangeKind::RoomUpdated, now);
+        change.symbol = roomList[index].type.id();
+        change.first = count.total;
+        change.second = count.occupied;
+        publish(change);
+    }
+
+    for (size_t i = 0; i < records.staff.size(); ++i) {
+        BulkRecords::Hire& hire = records.staff[i];
+        if (hire.member.name.empty() || (int)hire.role >= STAFF_ROLE_COUNT || directory.findByName(hire.member.name)) {
+            records.rejectedStaff.push_back(i);
+            continue;
+        }
+        StaffRef added = directory.add(hire.role, move(hire.member));
+        if (live()) board.countHours(added.department(), added.timetable(), 1);
+        if (logging) encodeStaff(sections[2], directory, (size_t)added.id());
+        ++counts[2];
+        ChangeEvent change(ChangeKind::StaffHired, now);
+        change.staff = added.id();
+        change.symbol = added.department().id();
+        change.first = (int32_t)hire.role;
+        publish(change);
+    }
+
+    for (size_t i = 0; i < records.patients.size(); ++i) {
+        Patient* added = registry.add(move(records.patients[i]));
+        if (!added) {
+            records.rejectedPatients.push_back(i);
+            continue;
+        }
+        if (live()) searchIndex.add(*added);
+        if (logging) encodePatientFields(sections[3], *added);
+        ++counts[3];
+        ChangeEvent change(ChangeKind::PatientRegistered, now);
+        change.setPatient(added->id);
+        change.symbol = added->department.id();
+        change.first = added->age;
+        publish(change);
+    }
+
+    if (logging && counts[0] + counts[1] + counts[2] + counts[3] > 0) {
+        BinaryWriter rec;
+        size_t bytes = 16;
+        for (const BinaryWriter& section : sections) bytes += section.bytes.size();
+        rec.bytes.reserve(bytes);
+        for (int section = 0; section < 4; ++section) {
+            rec.u32(counts[section]);
+            rec.bytes += sections[section].bytes;
+        }
+        log(LogOp::BulkAdd, rec);
+    }
+    return HmsStatus::Ok;
+}
+
+// --- Calendars ---------------------------------------------------------------
+
+const vector<ShiftTemplate>& Hospital::workingShifts(StaffRef member, vector<ShiftTemplate>& scratch) const {
+    const Calendar& calendar = member.calendar();
+    if (!calendar.shifts().empty()) return calendar.shifts();
+    dailyShifts(member.timetable(), scratch);
+    return scratch;
+}
+
+HmsStatus Hospital::addShift(StaffRef member, const ShiftTemplate& shift) {
+    OperationTimer timer(Operation::TimetableEdit, !recovering);
+    if (!member || !shift.valid()) return timer.result(HmsStatus::InvalidArgument);
+    shared_lock<shared_mutex> structure(structureLock);
+    lock_guard<mutex> dates(calendarLockFor(member));
+    member.calendar().addShift(shift);
+    BinaryWriter rec;
+    rec.u32((uint32_t)member.id());
+    encodeShift(rec, shift);
+    log(LogOp::AddShift, rec);
+    ChangeEvent change(ChangeKind::ShiftsChanged, time(0));
+    change.staff = member.id();
+    change.first = (int32_t)member.calendar().shifts().size();
+    publish(change);
+    return timer.result(HmsStatus::Ok);
+}
+
+HmsStatus Hospital::clearShifts(StaffRef member) {
+    OperationTimer timer(Operation::TimetableEdit, !recovering);
+    if (!member) return timer.result(HmsStatus::InvalidArgument);
+    shared_lock<shared_mutex> structure(structureLock);
+    lock_guard<mutex> dates(calendarLockFor(member));
+    member.calendar().clearShifts();
+    BinaryWriter rec;
+    rec.u32((uint32_t)member.id());
+    log(LogOp::ClearShifts, rec);
+    ChangeEvent change(ChangeKind::ShiftsChanged, time(0));
+    change.staff = member.id();
+    change.first = 0;
+    publish(change);
+    return timer.result(HmsStatus::Ok);
+}
+
+HmsStatus Hospital::bookVisit(Patient& patient, StaffRef member, int64_t start, int minutes) {
+    OperationTimer timer(Operation::Schedule, !recovering);
+    if (!member || minutes <= 0 || minutes > MINUTES_IN_DAY) return timer.result(HmsStatus::InvalidArgument);
+    shared_lock<shared_mutex> structure(structureLock);
+    lock_guard<mutex> record(lockFor(patient));
+    if (patient.department.empty()) return timer.result(HmsStatus::NoDepartment);
+    if (member.department() != patient.department) return timer.result(HmsStatus::InvalidArgument);
+    {
+        lock_guard<mutex> dates(calendarLockFor(member));
+        vector<ShiftTemplate> scratch;
+        if (!coveredByShifts(workingShifts(member, scratch), start, start + minutes) ||
+            !member.calendar().book(start, start + minutes, patient.id)) {
+            return timer.result(HmsStatus::SlotUnavailable);
+        }
+    }
+    HistoryEvent event;
+    event.kind = EventKind::Appointment;
+    event.epoch = epochOfCivil(start * 60);
+    event.staffId = member.id();
+    event.subject = eventStore.intern(member.name());
+    event.hour = (int8_t)((start - dayOf(start) * MINUTES_IN_DAY) / 60);
+    patient.addEvent(event);
+    if (live()) searchIndex.addText(patient, PatientSearchIndex::History, member.name());
+    BinaryWriter rec;
+    rec.str(patient.id);
+    rec.u32((uint32_t)member.id());
+    rec.i64(start);
+    rec.i32(minutes);
+    log(LogOp::BookVisit, rec);
+    ChangeEvent change(ChangeKind::VisitBooked, time(0));
+    change.setPatient(patient.id);
+    change.symbol = patient.department.id();
+    change.staff = member.id();
+    change.first = (int32_t)start;
+    change.second = minutes;
+    publish(change);
+    return timer.result(HmsStatus::Ok);
+}
+
+HmsStatus Hospital::cancelVisit(StaffRef member, int64_t start) {
+    OperationTimer timer(Operation::Schedule, !recovering);
+    if (!member) return timer.result(HmsStatus::InvalidArgument);
+    shared_lock<shared_mutex> structure(structureLock);
+    string patientId;
+    {
+        lock_guard<mutex> dates(calendarLockFor(member));
+        auto visit = member.calendar().visits().find(start);
+        if (visit == member.calendar().visits().end()) return timer.result(HmsStatus::NotFound);
+        patientId = visit->second.patientId;
+    }
+    // Patient locks come before calendar locks; the patient may be archived
+    Patient* patient;
+    {
+        shared_lock<shared_mutex> records(registryLock);
+        patient = registry.findById(patientId);
+    }
+    unique_lock<mutex> record;
+    if (patient) record = unique_lock<mutex>(lockFor(*patient));
+    {
+        lock_guard<mutex> dates(calendarLockFor(member));
+        // Another desk may have cancelled and rebooked the slot meanwhile
+        auto visit = member.calendar().visits().find(start);
+        if (visit == member.calendar().visits().end() || visit->second.patientId != patientId) {
+            return timer.result(HmsStatus::NotFound);
+        }
+        bool hourly = visit->second.hourly;
+        member.calendar().cancel(start);
+        // An hourly booking also gives its timetable hour back
+        int hour = (int)((start - dayOf(start) * MINUTES_IN_DAY) / 60);
+        if (hourly && member.timetable().release(hour) && live()) board.released(member.department(), hour);
+    }
+    if (patient) {
+        HistoryEvent event;
+        event.kind = EventKind::Cancelled;
+        event.epoch = epochOfCivil(start * 60);
+        event.staffId = member.id();
+        event.subject = eventStore.intern(member.name());
+        patient->addEvent(event);
+    }
+    BinaryWriter rec;
+    rec.u32((uint32_t)member.id());
+    rec.i64(start);
+    log(LogOp::CancelVisit, rec);
+    ChangeEvent change(ChangeKind::VisitCancelled, time(0));
+    change.setPatient(patientId);
+    change.staff = member.id();
+    change.first = (int32_t)start;
+    publish(change);
+    return timer.result(HmsStatus::Ok);
+}
+
+OpenSlot Hospital::nextOpenSlot(Symbol department, int role, int64_t from, int minutes, int days) {
+    OperationTimer timer(Operation::Lookup);
+    OpenSlot best;
+    if (role < -1 || role >= STAFF_ROLE_COUNT) return best;
+    shared_lock<shared_mutex> structure(structureLock);
+    // Each member is searched only up to the best opening found so far
+    int64_t before = from + (int64_t)days * MINUTES_IN_DAY;
+    vector<ShiftTemplate> scratch;
+    for (int r = role < 0 ? 0 : role; r < (role < 0 ? STAFF_ROLE_COUNT : role + 1); ++r) {
+        for (uint32_t row : directory.rowsIn(department, (StaffRole)r)) {
+            StaffRef member = directory.member(row);
+            lock_guard<mutex> dates(calendarLockFor(member));
+            int64_t start = member.calendar().nextOpen(workingShifts(member, scratch), from, minutes, before);
+            if (start < 0) continue;
+            best.member = member;
+            best.start = start;
+            before = start;
+        }
+    }
+    return best;
+}
+
+vector<ShiftTemplate> Hospital::shiftsOf(StaffRef member) const {
+    shared_lock<shared_mutex> structure(structureLock);
+    lock_guard<mutex> dates(calendarLockFor(member));
+    vector<ShiftTemplate> scratch;
+    return workingShifts(member, scratch);
+}
+
+vector<pair<int64_t, Visit>> Hospital::visitsOf(StaffRef member, int64_t from, int64_t to) const {
+    shared_lock<shared_mutex> structure(structureLock);
+    lock_guard<mutex> dates(calendarLockFor(member));
+    const map<int64_t, Visit>& visits = member.calendar().visits();
+    vector<pair<int64_t, Visit>> found;
+    // The visit before `from` may still be running
+    auto it = visits.lower_bound(from);
+    if (it != visits.begin() && prev(it)->second.end > from) --it;
+    for (; it != visits.end() && it->first < to; ++it) found.push_back(*it);
+    return found;
+}
+
+// --- Patients ----------------------------------------------------------------
+
+HmsStatus Hospital::registerPatient(const Patient& patient, Patient** registered) {
+    OperationTimer timer(Operation::Register, !recovering);
+    if (patient.id.empty()) return timer.result(HmsStatus::InvalidArgument);
+    shared_lock<shared_mutex> structure(structureLock);
+    lock_guard<shared_mutex> records(registryLock);
+    Patient* added = registry.add(patient);
+    if (!added) return timer.result(HmsStatus::DuplicateId);
+    if (live()) searchIndex.add(*added);
+    BinaryWriter rec;
+    encodePatientFields(rec, patient);
+    log(LogOp::RegisterPatient, rec);
+    ChangeEvent change(ChangeKind::PatientRegistered, time(0));
+    change.setPatient(added->id);
+    change.symbol = added->department.id();
+    change.first = added->age;
+    publish(change);
+    if (registered) *registered = added;
+    return timer.result(HmsStatus::Ok);
+}
+
+HmsStatus Hospital::assignDepartment(Patient& patient, const string& department) {
+    Symbol symbol;
+    if (!Symbol::find(department, symbol)) return HmsStatus::NotFound;
+    shared_lock<shared_mutex> structure(structureLock);
+    if (!departmentSet.count(symbol)) return HmsStatus::NotFound;
+    lock_guard<mutex> record(lockFor(patient));
+    if (patient.hospitalized && live()) {
+        board.admitted(patient.department, -1);
+        board.admitted(symbol, 1);
+    }
+    patient.department = symbol;
+    if (live()) searchIndex.add(patient);
+    BinaryWriter rec;
+    rec.str(patient.id);
+    rec.str(department);
+    log(LogOp::AssignDepartment, rec);
+    ChangeEvent change(ChangeKind::DepartmentAssigned, time(0));
+    change.setPatient(patient.id);
+    change.symbol = symbol.id();
+    publish(change);
+    return HmsStatus::Ok;
+}
+
+HmsStatus Hospital::bookAppointment(Patient& patient, StaffRef member, int hour, time_t when) {
+    OperationTimer timer(Operation::Schedule, !recovering);
+    if (!member) return timer.result(HmsStatus::InvalidArgument);
+    shared_lock<shared_mutex> structure(structureLock);
+    lock_guard<mutex> record(lockFor(patient));
+    if (patient.department.empty()) return timer.result(HmsStatus::NoDepartment);
+    if (member.department() != patient.department) return timer.result(HmsStatus::InvalidArgument);
+    // The hour is also held on the member's calendar for the day of booking
+    int64_t start = dayOf(civilSeconds(when) / 60) * MINUTES_IN_DAY + hour * 60;
+    lock_guard<mutex> dates(calendarLockFor(member));
+    Calendar& calendar = member.calendar();
+    if (calendar.clashEnd(start, start + 60) >= 0 || !member.timetable().book(hour)) {
+        return timer.result(HmsStatus::SlotUnavailable);
+    }
+    calendar.book(start, start + 60, patient.id, true);
+    if (live()) board.booked(member.department(), hour);
+    HistoryEvent event;
+    event.kind = EventKind::Appointment;
+    event.epoch = when;
+    event.staffId = member.id();
+    event.subject = eventStore.intern(member.name());
+    event.hour = (int8_t)hour;
+    patient.addEvent(event);
+    if (live()) searchIndex.addText(patient, PatientSearchIndex::History, member.name());
+    BinaryWriter rec;
+    rec.str(patient.id);
+    rec.u32((uint32_t)member.id());
+    rec.i32(hour);
+    rec.i64(when);
+    log(LogOp::ScheduleAppointment, rec);
+    ChangeEvent change(ChangeKind::AppointmentBooked, when);
+    change.setPatient(patient.id);
+    change.symbol = patient.department.id();
+    change.staff = member.id();
+    change.hour = (int16_t)hour;
+    publish(change);
+    return timer.result(HmsStatus::Ok);
+}
+
+HmsStatus Hospital::hospitalize(Patient& patient, size_t roomIndex, time_t when) {
+    OperationTimer timer(Operation::Hospitalize, !recovering);
+    shared_lock<shared_mutex> structure(structureLock);
+    if (roomIndex >= roomList.size()) return timer.result(HmsStatus::NotFound);
+    lock_guard<mutex> record(lockFor(patient));
+    if (patient.hospitalized) return timer.result(HmsStatus::AlreadyHospitalized);
+    int bed = roomList[roomIndex].allocateBed();
+    if (bed < 0) return timer.result(HmsStatus::NoRoomAvailable);
+    board.bedsFreed(-1);
+    if (roomList[roomIndex].availableRooms() == 0) recordRoomFilled();
+    admit(patient, roomIndex, bed, when);
+    return timer.result(HmsStatus::Ok);
+}
+
+// Records a bed that is already taken for the patient
+void Hospital::admit(Patient& patient, size_t roomIndex, int bed, time_t when) {
+    const Room& room = roomList[roomIndex];
+    patient.hospitalized = true;
+    patient.roomType = room.type;
+    patient.bed = bed;
+    patient.hospitalizationDate = formatDateTime(when);
+    if (live()) board.admitted(patient.department, 1);
+    HistoryEvent event;
+    event.kind = EventKind::Hospitalized;
+    event.epoch = when;
+    event.subject = eventStore.intern(room.type);
+    patient.addEvent(event);
+    if (live()) searchIndex.addText(patient, PatientSearchIndex::History, room.type);
+    BinaryWriter rec;
+    rec.str(patient.id);
+    rec.u32((uint32_t)roomIndex);
+    rec.i32(bed);
+    rec.i64(when);
+    log(LogOp::Hospitalize, rec);
+    ChangeEvent change(ChangeKind::Hospitalized, when);
+    change.setPatient(patient.id);
+    change.symbol = room.type.id();
+    change.first = bed;
+    publish(change);
+}
+
+// Gives the patient's bed back to its room
+void Hospital::vacateBed(Patient& patient) {
+    int index = roomIndex(patient.roomType);
+    if (index >= 0 && patient.bed >= 0) {
+        if (recovering) markBed((size_t)index, patient.bed, BedState::Free);
+        else if (roomList[index].releaseBed(patient.bed)) board.bedsFreed(1);
+    }
+    patient.bed = -1;
+}
+
+// Sets a bed while the log replays, counting the change on a replica
+void Hospital::markBed(size_t roomIndex, int bed, BedState state) {
+    Room& room = roomList[roomIndex];
+    int wasFree = room.availableRooms();
+    room.markBed(bed, state);
+    if (live()) board.bedsFreed(room.availableRooms() - wasFree);
+}
+
+HmsStatus Hospital::discharge(Patient& patient, time_t when) {
+    OperationTimer timer(Operation::Discharge, !recovering);
+    shared_lock<shared_mutex> structure(structureLock);
+    lock_guard<mutex> record(lockFor(patient));
+    if (!patient.hospitalized) return timer.result(HmsStatus::NotHospitalized);
+    patient.dischargeDate = formatDateTime(when);
+    patient.hospitalized = false;
+    HistoryEvent event;
+    event.kind = EventKind::Discharged;
+    event.epoch = when;
+    patient.addEvent(event);
+    BinaryWriter rec;
+    rec.str(patient.id);
+    rec.i64(when);
+    // Logged before the bed is freed, so the next admission to it is
+    // always logged after this record
+    log(LogOp::Discharge, rec);
+    ChangeEvent change(ChangeKind::Discharged, when);
+    change.setPatient(patient.id);
+    change.symbol = patient.roomType.id();
+    change.first = patient.bed;
+    publish(change);
+    if (live()) {
+        board.admitted(patient.department, -1);
+        board.discharged(dayOf(civilSeconds(when) / 60));
+    }
+    vacateBed(patient);
+    return timer.result(HmsStatus::Ok);
+}
+
+// --- Queries -----------------------------------------------------------------
+
+bool Hospital::hasDepartment(const string& name) const {
+    Symbol department;
+    if (!Symbol::find(name, department)) return false;
+    shared_lock<shared_mutex> structure(structureLock);
+    return departmentSet.count(department) != 0;
+}
+
+vector<Room> Hospital::roomTable() const {
+    shared_lock<shared_mutex> structure(structureLock);
+    vector<Room> table;
+    table.reserve(roomList.size());
+    for (const auto& room : roomList) {
+        Room copy(room.type, room.totalRooms);
+        for (int bed = 0; bed < room.totalRooms; ++bed) copy.markBed(bed, room.bedState(bed));
+        copy.rebuildFreeList();
+        table.push_back(copy);
+    }
+    return table;
+}
+
+StatusView Hospital::statusBoard(time_t now) const {
+    shared_lock<shared_mutex> structure(structureLock);
+    StatusView view;
+    view.freeBeds = board.freeBeds();
+    view.admitted = board.admitted();
+    int64_t today = dayOf(civilSeconds(now) / 60);
+    for (size_t back = 0; back < view.discharges.size(); ++back) {
+        view.discharges[back] = board.discharges(today - (int64_t)back);
+    }
+    view.rooms.reserve(roomList.size());
+    for (const auto& room : roomList) {
+        RoomLoad load;
+        load.type = room.type;
+        load.total = room.totalRooms;
+        load.free = room.availableRooms();
+        view.rooms.push_back(load);
+    }
+    view.departments.reserve(departmentList.size() + 1);
+    for (Symbol department : departmentList) view.departments.push_back(board.department(department));
+    DepartmentLoad unassigned = board.department(Symbol());
+    if (unassigned.admitted != 0) view.departments.push_back(unassigned);
+    return view;
+}
+
+Patient* Hospital::findPatient(const string& id) {
+    OperationTimer timer(Operation::Lookup);
+    shared_lock<shared_mutex> records(registryLock);
+    Patient* patient = registry.findById(id);
+    timer.result(patient ? HmsStatus::Ok : HmsStatus::NotFound);
+    return patient;
+}
+
+Patient* Hospital::findPatientByName(const string& name) {
+    OperationTimer timer(Operation::Lookup);
+    shared_lock<shared_mutex> records(registryLock);
+    Patient* patient = registry.findByName(name);
+    timer.result(patient ? HmsStatus::Ok : HmsStatus::NotFound);
+    return patient;
+}
+
+bool Hospital::readPatient(const string& id, Patient& record) const {
+    shared_lock<shared_mutex> records(registryLock);
+    const Patient* patient = registry.findById(id);
+    if (!patient) return false;
+    lock_guard<mutex> guard(lockFor(*patient));
+    record = *patient;
+    return true;
+}
+
+vector<StaffRef> Hospital::staffInDepartment(Symbol department) {
+    shared_lock<shared_mutex> structure(structureLock);
+    return directory.inDepartment(department);
+}
+
+vector<StaffRef> Hospital::staffInDepartment(Symbol department, StaffRole role) {
+    shared_lock<shared_mutex> structure(structureLock);
+    return directory.inDepartment(department, role);
+}
+
+StaffRef Hospital::findStaff(const string& name) {
+    shared_lock<shared_mutex> structure(structureLock);
+    return directory.findByName(name);
+}
+
+StaffRef Hospital::findStaff(size_t id) {
+    shared_lock<shared_mutex> structure(structureLock);
+    return directory.member(id);
+}
+
+vector<string> Hospital::searchPatients(const string& query, size_t limit) const {
+    OperationTimer timer(Operation::Lookup);
+    vector<string> found;
+    for (auto& hit : searchIndex.search(query, limit)) found.push_back(move(hit.patientId));
+    timer.result(found.empty() ? HmsStatus::NotFound : HmsStatus::Ok);
+    return found;
+}
+
+ArchivedPatient Hospital::findArchivedPatient(const string& id) const {
+    shared_lock<shared_mutex> structure(structureLock);
+    return storage ? storage->archive().findById(id) : ArchivedPatient();
+}
+
+bool Hospital::empty() const {
+    return departmentList.empty() && roomList.empty() && directory.empty() && registry.empty();
+}
+
+} // namespace hms
@@ -0,0 +1,289 @@
+#ifndef HMS_HOSPITAL_H
+#define HMS_HOSPITAL_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "archive.h"
+#include "calendar.h"
+#include "changefeed.h"
+#include "patient.h"
+#include "patient_registry.h"
+#include "patient_search.h"
+#include "room.h"
+#include "staff.h"
+#include "statusboard.h"
+#include "storage.h"
+#include "symbols.h"
+#include "timetable.h"
+
+namespace hms {
+using namespace std;
+
+// Result of every Hospital operation. Nothing in the core prints; callers
+// turn codes into messages with statusMessage().
+enum class HmsStatus {
+    Ok = 0,
+    NotFound,
+    DuplicateId,
+    InvalidArgument,
+    NoDepartment,
+    SlotUnavailable,
+    NoRoomAvailable,
+    AlreadyHospitalized,
+    StorageError,
+    NotHospitalized,
+};
+
+const char* statusMessage(HmsStatus status);
+
+// The earliest opening found by Hospital::nextOpenSlot
+struct OpenSlot {
+    StaffRef member;    // null if nobody has one
+    int64_t start = -1; // civil minute
+};
+
+// Records added in one step by Hospital::bulkAdd, e.g. from an Importer
+// (see importer.h). bulkAdd fills in what it added and left out.
+struct BulkRecords {
+    struct RoomCount {
+        string type;
+        int total = 0;
+        int occupied = 0;
+    };
+    struct Hire {
+        StaffRole role = StaffRole::Doctor;
+        Staff member;
+    };
+
+    vector<string> departments; // those that exist already are passed over
+    vector<RoomCount> rooms;    // those that exist are resized
+    vector<Hire> staff;
+    vector<Patient> patients;   // moved out as they are added
+
+    size_t addedDepartments = 0;
+    // Positions left out: rooms that could not be resized to their counts,
+    // staff whose name is taken and patients whose ID is
+    vector<size_t> rejectedRooms, rejectedStaff, rejectedPatients;
+};
+
+// The HMS domain core: departments, room inventory, staff, patients and
+// their persistence. Every mutation validates its input, applies the
+// change and appends it to the write-ahead log when storage is open.
+//
+// All operations may be called from several threads (one per desk).
+// Locking, always taken in this order:
+//   structureLock  exclusive for configuration changes and checkpoints,
+//                  shared for everything else;
+//   registryLock   exclusive while a patient is registered, shared for
+//                  lookups, so chart views never wait on one another;
+//   patient lock   one of PATIENT_LOCK_STRIPES mutexes picked by record,
+//                  held while a single patient is read or changed;
+//   calendar lock  one of CALENDAR_LOCK_STRIPES mutexes picked by staff
+//                  row, held while a dated calendar is read or changed;
+//   search index   its own lock, taken last to apply each change.
+// Appointment slots and room occupancy are claimed with compare-and-swap
+// (Timetable::book, Room::occupy), so desks working on different patients
+// never wait for each other. Each change is logged while its locks are
+// held, which keeps the log in an order that replays to the same state.
+// Patient* handles stay valid until the next checkpoint, StaffRef handles
+// for as long as the hospital. Each change is also published to the change
+// feed (see changefeed.h) and counted on the status board while its locks
+// are held, except while open() replays the log.
+class Hospital {
+public:
+    Hospital();
+    ~Hospital();
+
+    Hospital(const Hospital&) = delete;
+    Hospital& operator=(const Hospital&) = delete;
+
+    // --- Persistence -------------------------------------------------------
+
+    // Loads the state kept in `dataDirectory` and starts journaling to it
+    HmsStatus open(const string& dataDirectory);
+
+    // Archives discharged patients and writes a new snapshot
+    HmsStatus checkpoint();
+    bool checkpointDue();
+    void close();
+
+    const string& dataDirectory() const; // empty when not persisted
+    // Returns once every change so far is in the log file; StorageError if
+    // the log failed to write or sync
+    HmsStatus syncLog();
+    // The last log record written, or on a replica the last one applied
+    uint64_t logPosition() const;
+
+    // --- Replication -------------------------------------------------------
+    // A replica has no storage of its own and changes only by applying its
+    // primary's snapshot and log records (see replication.h). Queries work
+    // as usual meanwhile, and the changes are published to the change feed.
+
+    // Makes this empty hospital a replica starting from the primary's
+    // snapshot file (empty if the primary has none); `lsn` receives the
+    // record it covers
+    bool startReplica(const string& snapshot, uint64_t& lsn);
+    void applyReplicated(uint64_t lsn, LogOp op, BinaryReader& payload);
+
+    // --- Configuration -----------------------------------------------------
+
+    HmsStatus addDepartment(const string& name);
+    HmsStatus addRoomType(const string& type, int total, int occupied);
+    HmsStatus updateRoom(size_t index, int total, int occupied);
+
+    // Moves `member` into the staff directory; `hired` receives its handle
+    HmsStatus hireStaff(StaffRole role, Staff member, StaffRef* hired = nullptr);
+
+    HmsStatus updateTimetable(StaffRef member, int startHour, int endHour, SlotState state);
+
+    // Moves `member` to another department; bookings already made stay
+    HmsStatus reassignStaff(StaffRef member, const string& department);
+
+    // Adds departments, then rooms, staff and patients under every lock and
+    // as one log record, so desks, recovery and replicas see either all of
+    // them or none
+    HmsStatus bulkAdd(BulkRecords& records);
+
+    // --- Calendars ---------------------------------------------------------
+    // Dated visits in civil minutes (see calendar.h). A member works their
+    // shift templates, or when they have none, the hours their timetable
+    // is not Free on every day.
+
+    HmsStatus addShift(StaffRef member, const ShiftTemplate& shift);
+    HmsStatus clearShifts(StaffRef member);
+
+    // Books [start, start + minutes) with a member of the patient's
+    // department, inside the member's shifts and clear of their other
+    // visits. The patient's history records it as an appointment.
+    HmsStatus bookVisit(Patient& patient, StaffRef member, int64_t start, int minutes);
+    HmsStatus cancelVisit(StaffRef member, int64_t start);
+
+    // Earliest opening of `minutes` that starts within `days` days of
+    // `from`, among the department's members of one role (-1 for any).
+    // Ties go to the member listed first.
+    OpenSlot nextOpenSlot(Symbol department, int role, int64_t from, int minutes, int days = 28);
+
+    vector<ShiftTemplate> shiftsOf(StaffRef member) const; // the templates the member works
+    vector<pair<int64_t, Visit>> visitsOf(StaffRef member, int64_t from, int64_t to) const;
+
+    // --- Patients ----------------------------------------------------------
+
+    HmsStatus registerPatient(const Patient& patient, Patient** registered = nullptr);
+    HmsStatus assignDepartment(Patient& patient, const string& department);
+    HmsStatus bookAppointment(Patient& patient, StaffRef member, int hour, time_t when);
+    HmsStatus hospitalize(Patient& patient, size_t roomIndex, time_t when);
+    HmsStatus discharge(Patient& patient, time_t when);
+
+    // --- Queries -----------------------------------------------------------
+    // The reference accessors (departments, rooms, patients, staff) are for
+    // single-threaded callers; the rest lock.
+
+    const vector<Symbol>& departments() const { return departmentList; }
+    bool hasDepartment(const string& name) const;
+
+    const vector<Room>& rooms() const { return roomList; }
+    vector<Room> roomTable() const; // consistent copy of the room inventory
+    int findRoom(const string& type) const; // index, or -1
+    BedState bedState(size_t roomIndex, int bed) const;
+
+    PatientRegistry& patients() { return registry; }
+    const PatientRegistry& patients() const { return registry; }
+    Patient* findPatient(const string& id);
+    Patient* findPatientByName(const string& name);
+    // Copies an active record without blocking other desks; false if absent
+    bool readPatient(const string& id, Patient& record) const;
+    ArchivedPatient findArchivedPatient(const string& id) const;
+    // IDs of the active patients matching every word by prefix or with
+    // small typos, best first; see PatientSearchIndex
+    vector<string> searchPatients(const string& query, size_t limit = 20) const;
+
+    StaffDirectory& staff() { return directory; }
+    const StaffDirectory& staff() const { return directory; }
+    vector<StaffRef> staffInDepartment(Symbol department);
+    vector<StaffRef> staffInDepartment(Symbol department, StaffRole role);
+    StaffRef findStaff(const string& name); // null handle if absent
+    StaffRef findStaff(size_t id);
+
+    // True when nothing has been configured or registered yet
+    bool empty() const;
+
+    // Every change made since open(), for subscribers to follow
+    const ChangeFeed& changes() const { return feed; }
+
+    // --- Status board ------------------------------------------------------
+    // Totals kept up to date with every change (see statusboard.h), so
+    // these cost the same however many patients and staff there are.
+
+    int freeBeds() const { return board.freeBeds(); } // over all room types
+    // Rooms, departments and discharges on the days up to `now`
+    StatusView statusBoard(time_t now) const;
+
+private:
+    static const size_t PATIENT_LOCK_STRIPES = 256;
+    static const size_t CALENDAR_LOCK_STRIPES = 64;
+
+    struct alignas(64) StripeLock {
+        mutex lock;
+    };
+
+    mutable shared_mutex structureLock;
+    mutable shared_mutex registryLock;
+    mutable array<StripeLock, PATIENT_LOCK_STRIPES> patientLocks;
+    mutable array<StripeLock, CALENDAR_LOCK_STRIPES> calendarLocks;
+
+    vector<Symbol> departmentList;
+    unordered_set<Symbol> departmentSet;
+    vector<Room> roomList;
+    StaffDirectory directory;
+    PatientRegistry registry;
+    PatientSearchIndex searchIndex; // rebuilt by open() and checkpoint()
+    ChangeFeed feed;
+    StatusBoard board; // recounted by open() and startReplica()
+    // Discharges of archived patients by civil day, for the board's window;
+    // kept in the snapshot so the archive is never read to recount them
+    map<int64_t, int> archivedDischarges;
+    unique_ptr<Storage> storage;
+    Journal* journal = nullptr; // null while replaying or when not persisted
+    bool recovering = false;    // beds are marked directly until open() rebuilds the free lists
+    bool replica = false;       // recovering for good, applying a primary's log
+    atomic<uint64_t> appliedLsn{0};
+
+    // The search index, change feed and status board follow every change
+    // but a replay
+    bool live() const { return !recovering || replica; }
+    mutex& lockFor(const Patient& patient) const;
+    mutex& calendarLockFor(StaffRef member) const;
+    // The member's templates, or their timetable hours every day built into
+    // `scratch` when they have none; calendar lock held
+    const vector<ShiftTemplate>& workingShifts(StaffRef member, vector<ShiftTemplate>& scratch) const;
+    int roomIndex(Symbol type) const;
+    void admit(Patient& patient, size_t roomIndex, int bed, time_t when);
+    void vacateBed(Patient& patient);
+    void markBed(size_t roomIndex, int bed, BedState state); // replays only
+    void recountBoard();
+    void log(LogOp op, const BinaryWriter& payload);
+    void publish(const ChangeEvent& change);
+    bool loadSnapshot(BinaryReader& in);
+    void writeSnapshot(BinaryWriter& out) const;
+    void replay(LogOp op, BinaryReader& in);
+    void archiveClosedPatients();
+    void dropArchivedPatients();
+    void countArchived(const Patient& patient);
+    void compactHistory();
+    void trimCalendars();
+};
+
+} // namespace hms
+
+#endif // HMS_HOSPITAL_H
@@ -0,0 +1,512 @@
+#include "importer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace hms {
+
+namespace {
+
+const size_t NONE = SIZE_MAX;
+const size_t MIN_SHARE = 4096; // rows worth a thread of their own
+
+// Fields of each kind of row: rooms, staff, patients, departments
+const size_t FIELDS[] = {3, 5, 5, 1};
+const size_t REQUIRED[] = {3, 3, 5, 1};
+const char* const COLUMNS[][5] = {
+    {"type", "total", "occupied", "", ""},
+    {"role", "name", "department", "start", "end"},
+    {"id", "name", "age", "reason", "department"},
+    {"department", "", "", "", ""},
+};
+
+// Position of the first `a` or `b` in [from, size), or size
+size_t findEither(const char* data, size_t size, size_t from, char a, char b) {
+#if defined(__SSE2__)
+    const __m128i wantA = _mm_set1_epi8(a), wantB = _mm_set1_epi8(b);
+    for (; from + 16 <= size; from += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(data + from));
+        unsigned hits = (unsigned)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(block, wantA), _mm_cmpeq_epi8(block, wantB)));
+        if (hits) return from + __builtin_ctz(hits);
+    }
+#endif
+    for (; from < size; ++from) {
+        if (data[from] == a || data[from] == b) return from;
+    }
+    return size;
+}
+
+// Splits a record at each `delimiter`. With `quoted`, a field opening with
+// '"' runs to the closing quote, "" standing for one quote inside; its text
+// is copied unquoted into `scratch`, which never grows past the record.
+void splitFields(string_view record, char delimiter, bool quoted, vector<string_view>& fields, string& scratch) {
+    fields.clear();
+    scratch.clear();
+    scratch.reserve(record.size());
+    const char* data = record.data();
+    size_t size = record.size(), pos = 0;
+    while (true) {
+        if (quoted && pos < size && data[pos] == '"') {
+            size_t start = scratch.size();
+            for (++pos;;) {
+                size_t quote = findEither(data, size, pos, '"', '"');
+                scratch.append(data + pos, quote - pos);
+                if (quote + 1 < size && data[quote + 1] == '"') {
+                    scratch.push_back('"');
+                    pos = quote + 2;
+                    continue;
+                }
+                pos = min(quote + 1, size);
+                break;
+            }
+            fields.emplace_back(scratch.data() + start, scratch.size() - start);
+            pos = findEither(data, size, pos, delimiter, delimiter);
+        } else {
+            size_t end = findEither(data, size, pos, delimiter, delimiter);
+            fields.emplace_back(data + pos, end - pos);
+            pos = end;
+        }
+        if (pos >= size) break;
+        ++pos;
+    }
+}
+
+bool toInt(string_view text, int& value) {
+    auto parsed = from_chars(text.data(), text.data() + text.size(), value);
+    return !text.empty() && parsed.ec == errc() && parsed.ptr == text.data() + text.size();
+}
+
+bool sameWord(string_view text, string_view word) {
+    if (text.size() != word.size()) return false;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (tolower((unsigned char)text[i]) != word[i]) return false;
+    }
+    return true;
+}
+
+bool toRole(string_view text, StaffRole& role) {
+    if (sameWord(text, "doctor")) role = StaffRole::Doctor;
+    else if (sameWord(text, "nurse")) role = StaffRole::Nurse;
+    else if (sameWord(text, "technician")) role = StaffRole::Technician;
+    else return false;
+    return true;
+}
+
+string_view trim(string_view text) {
+    while (!text.empty() && isspace((unsigned char)text.front())) text.remove_prefix(1);
+    while (!text.empty() && isspace((unsigned char)text.back())) text.remove_suffix(1);
+    return text;
+}
+
+// Runs work(0) to work(count - 1) at once, the first on this thread
+void onThreads(unsigned count, const function<void(unsigned)>& work) {
+    vector<thread> running;
+    for (unsigned t = 1; t < count; ++t) running.emplace_back(work, t);
+    work(0);
+    for (auto& worker : running) worker.join();
+}
+
+// For each key, the position of the first equal key before it, or NONE.
+// Each thread keeps the keys whose hash falls to it.
+template <class KeyOf>
+vector<size_t> firstEqual(size_t count, KeyOf keyOf, unsigned threads) {
+    if (count < MIN_SHARE) threads = 1;
+    vector<size_t> hashes(count), first(count, NONE);
+    onThreads(threads, [&](unsigned t) {
+        for (size_t i = count * t / threads; i < count * (t + 1) / threads; ++i) hashes[i] = hash<string_view>()(keyOf(i));
+    });
+    onThreads(threads, [&](unsigned t) {
+        unordered_map<string_view, size_t> seen;
+        seen.reserve(count / threads + 1);
+        for (size_t i = 0; i < count; ++i) {
+            if (hashes[i] % threads != t) continue;
+            auto found = seen.emplace(keyOf(i), i);
+            if (!found.second) first[i] = found.first->second;
+        }
+    });
+    return first;
+}
+
+template <class T>
+void appendAll(vector<T>& to, vector<T>& from) {
+    if (to.empty()) to.swap(from);
+    else to.insert(to.end(), make_move_iterator(from.begin()), make_move_iterator(from.end()));
+    from.clear();
+}
+
+// Removes the rows marked in `dropped`, with their lines, keeping the order
+template <class Row, class Origin>
+void removeRows(vector<Row>& rows, vector<Origin>& lines, const vector<char>& dropped) {
+    size_t kept = 0;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (dropped[i]) continue;
+        if (kept != i) {
+            rows[kept] = move(rows[i]);
+            lines[kept] = lines[i];
+        }
+        ++kept;
+    }
+    rows.erase(rows.begin() + kept, rows.end());
+    lines.resize(kept);
+}
+
+string_view lineText(const string& chunk, size_t begin, size_t end) {
+    if (end > begin && chunk[end - 1] == '\r') --end;
+    return string_view(chunk.data() + begin, end - begin);
+}
+
+} // namespace
+
+Importer::Importer(Hospital& hospital, unsigned threads) : hospital(hospital), threads(max(threads, 1u)) {}
+
+bool Importer::read(const string& path, string& error) {
+    ifstream file(path, ios::binary);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    bool csv = path.size() >= 4 && sameWord(string_view(path).substr(path.size() - 4), ".csv");
+    return read(file, csv ? ImportFormat::Csv : ImportFormat::Segments, path, error);
+}
+
+bool Importer::read(istream& in, ImportFormat format, const string& name, string& error) {
+    auto started = chrono::steady_clock::now();
+    uint32_t source = (uint32_t)sources.size();
+    bool csv = format == ImportFormat::Csv;
+    bool headed = !csv;
+    Layout layout;
+    Part file;
+    string chunk;
+    vector<Line> lines;
+    uint32_t line = 1;
+    for (bool last = false; !last;) {
+        size_t kept = chunk.size();
+        chunk.resize(kept + CHUNK_BYTES);
+        in.read(&chunk[kept], CHUNK_BYTES);
+        chunk.resize(kept + (size_t)in.gcount());
+        if (in.bad()) {
+            error = "cannot read " + name;
+            return false;
+        }
+        last = !in;
+        lines.clear();
+        size_t used = cutLines(chunk, csv, last, line, lines);
+        size_t first = 0;
+        while (!headed && first < lines.size()) {
+            const Line& header = lines[first++];
+            string_view text = lineText(chunk, header.begin, header.end);
+            if (trim(text).empty()) continue;
+            if (!readHeader(text, layout, error)) {
+                error = name + ":" + to_string(header.number) + " " + error;
+                return false;
+            }
+            headed = true;
+        }
+        size_t count = lines.size() - first;
+        unsigned workers = (unsigned)min<size_t>(threads, max<size_t>(count / MIN_SHARE, 1));
+        vector<Part> parts(workers);
+        const Line* begin = lines.data() + first;
+        onThreads(workers, [&](unsigned t) {
+            parse(chunk, begin + count * t / workers, begin + count * (t + 1) / workers, source, format, layout,
+                  parts[t]);
+        });
+        for (Part& part : parts) append(file, part);
+        chunk.erase(0, used);
+    }
+    if (!headed) {
+        error = name + " is empty; a CSV file needs a header";
+        return false;
+    }
+    sources.push_back(name);
+    append(parsed, file);
+    readSeconds += chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    return true;
+}
+
+size_t Importer::cutLines(const string& chunk, bool quoted, bool last, uint32_t& line, vector<Line>& lines) {
+    const char* data = chunk.data();
+    size_t size = chunk.size(), start = 0, pos = 0;
+    uint32_t physical = line;
+    bool inQuotes = false;
+    // Line ends inside quotes belong to the field
+    char quote = quoted ? '"' : '\n';
+    while ((pos = findEither(data, size, pos, '\n', quote)) < size) {
+        if (data[pos] == '"') {
+            inQuotes = !inQuotes;
+        } else {
+            ++physical;
+            if (!inQuotes) {
+                lines.push_back({start, pos, line});
+                start = pos + 1;
+                line = physical;
+            }
+        }
+        ++pos;
+    }
+    if (last && start < size) {
+        lines.push_back({start, size, line});
+        start = size;
+    }
+    return start;
+}
+
+bool Importer::readHeader(string_view text, Layout& layout, string& error) {
+    vector<string_view> names;
+    string scratch;
+    splitFields(text, ',', true, names, scratch);
+    auto columnOf = [&names](string_view column) {
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (sameWord(trim(names[i]), column)) return (int)i;
+        }
+        return -1;
+    };
+    if (columnOf("id") >= 0) layout.kind = Patients;
+    else if (columnOf("role") >= 0) layout.kind = Staff;
+    else if (columnOf("type") >= 0) layout.kind = Rooms;
+    else if (columnOf("department") >= 0) layout.kind = Departments;
+    else {
+        error = "header names no id (patients), role (staff), type (rooms) or department column";
+        return false;
+    }
+    layout.width = names.size();
+    for (size_t field = 0; field < FIELDS[layout.kind]; ++field) {
+        layout.column[field] = columnOf(COLUMNS[layout.kind][field]);
+        if (layout.column[field] < 0 && field < REQUIRED[layout.kind]) {
+            error = string("header lacks the ") + COLUMNS[layout.kind][field] + " column";
+            return false;
+        }
+    }
+    return true;
+}
+
+void Importer::parse(const string& chunk, const Line* first, const Line* last, uint32_t source, ImportFormat format,
+                     const Layout& layout, Part& part) const {
+    bool csv = format == ImportFormat::Csv;
+    vector<string_view> fields;
+    string scratch;
+    string_view values[5];
+    for (const Line* line = first; line != last; ++line) {
+        string_view text = lineText(chunk, line->begin, line->end);
+        if (trim(text).empty() || (!csv && text[0] == '#')) continue;
+        Origin at{source, line->number};
+        splitFields(text, csv ? ',' : '|', csv, fields, scratch);
+        Kind kind = layout.kind;
+        size_t count = fields.size();
+        if (csv) {
+            ++part.rows;
+            if (count != layout.width) {
+                part.failures.push_back({at, "expected " + to_string(layout.width) + " fields, found " + to_string(count)});
+                continue;
+            }
+            for (size_t field = 0; field < FIELDS[kind]; ++field) {
+                values[field] = layout.column[field] >= 0 ? fields[layout.column[field]] : string_view();
+            }
+        } else {
+            string_view segment = fields[0];
+            if (segment == "MSH") continue;
+            ++part.rows;
+            --count;
+            bool fits;
+            if (segment == "DEP") {
+                kind = Departments;
+                fits = count == 1;
+            } else if (segment == "ROM") {
+                kind = Rooms;
+                fits = count == 3;
+            } else if (segment == "STF") {
+                kind = Staff;
+                fits = count == 3 || count == 5;
+            } else if (segment == "PID") {
+                kind = Patients;
+                fits = count == 5;
+            } else {
+                part.failures.push_back({at, "unknown segment " + string(segment)});
+                continue;
+            }
+            if (!fits) {
+                string expected = kind == Staff ? "3 or 5 fields"
+                                  : kind == Departments ? "1 field" : to_string(FIELDS[kind]) + " fields";
+                part.failures.push_back({at, string(segment) + " expects " + expected});
+                continue;
+            }
+            for (size_t field = 0; field < FIELDS[kind]; ++field) {
+                values[field] = field < count ? fields[field + 1] : string_view();
+            }
+        }
+        parseRow(values, kind, at, part);
+    }
+}
+
+void Importer::parseRow(const string_view* fields, Kind kind, Origin at, Part& part) const {
+    string error;
+    switch (kind) {
+    case Rooms: {
+        BulkRecords::RoomCount count;
+        if (fields[0].empty()) error = "empty room type";
+        else if (!toInt(fields[1], count.total) || count.total < 0) error = "bad total: " + string(fields[1]);
+        else if (!toInt(fields[2], count.occupied) || count.occupied < 0 || count.occupied > count.total) {
+            error = "bad occupied count: " + string(fields[2]);
+        } else {
+            count.type.assign(fields[0]);
+            part.records.rooms.push_back(move(count));
+            part.roomLines.push_back(at);
+        }
+        break;
+    }
+    case Staff: {
+        BulkRecords::Hire hire;
+        int start = 0, end = HOURS_IN_DAY - 1;
+        bool hours = !fields[3].empty() || !fields[4].empty();
+        if (!toRole(fields[0], hire.role)) error = "unknown staff role " + string(fields[0]);
+        else if (fields[1].empty()) error = "empty staff name";
+        else if (hours && (!toInt(fields[3], start) || !toInt(fields[4], end) || start < 0 || end < start ||
+                           end >= HOURS_IN_DAY)) {
+            error = "bad working hours " + string(fields[3]) + "-" + string(fields[4]);
+        } else {
+            hire.member.name.assign(fields[1]);
+            hire.member.department = string(fields[2]);
+            if (hours) hire.member.timetable.setHours(start, end, SlotState::Work);
+            part.records.staff.push_back(move(hire));
+            part.staffLines.push_back(at);
+        }
+        break;
+    }
+    case Patients: {
+        int age;
+        if (fields[0].empty()) error = "empty patient ID";
+        else if (fields[1].empty()) error = "empty patient name";
+        else if (!toInt(fields[2], age) || age < 0 || age > 150) error = "bad age: " + string(fields[2]);
+        else {
+            part.records.patients.emplace_back();
+            Patient& patient = part.records.patients.back();
+            patient.id.assign(fields[0]);
+            patient.name.assign(fields[1]);
+            patient.age = age;
+            patient.reasonForVisit.assign(fields[3]);
+            patient.department = string(fields[4]);
+            part.patientLines.push_back(at);
+        }
+        break;
+    }
+    case Departments:
+        if (fields[0].empty()) error = "empty department name";
+        else part.records.departments.emplace_back(fields[0]);
+        break;
+    }
+    if (!error.empty()) part.failures.push_back({at, move(error)});
+}
+
+void Importer::append(Part& into, Part& from) {
+    appendAll(into.records.departments, from.records.departments);
+    appendAll(into.records.rooms, from.records.rooms);
+    appendAll(into.records.staff, from.records.staff);
+    appendAll(into.records.patients, from.records.patients);
+    appendAll(into.roomLines, from.roomLines);
+    appendAll(into.staffLines, from.staffLines);
+    appendAll(into.patientLines, from.patientLines);
+    appendAll(into.failures, from.failures);
+    into.rows += from.rows;
+}
+
+string Importer::place(Origin at) const {
+    return sources[at.source] + ":" + to_string(at.line);
+}
+
+// Keeps the first row of each patient ID, staff name and room type
+void Importer::dropRepeats() {
+    auto drop = [this](auto& rows, vector<Origin>& lines, auto keyOf, const char* what) {
+        vector<size_t> first = firstEqual(rows.size(), keyOf, threads);
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (first[i] == NONE) continue;
+            parsed.failures.push_back(
+                {lines[i], string(what) + " " + string(keyOf(i)) + " repeats " + place(lines[first[i]])});
+        }
+        vector<char> dropped(rows.size());
+        for (size_t i = 0; i < rows.size(); ++i) dropped[i] = first[i] != NONE;
+        removeRows(rows, lines, dropped);
+    };
+    BulkRecords& records = parsed.records;
+    drop(records.rooms, parsed.roomLines, [&records](size_t i) { return string_view(records.rooms[i].type); },
+         "room type");
+    drop(records.staff, parsed.staffLines, [&records](size_t i) { return string_view(records.staff[i].member.name); },
+         "staff member");
+    drop(records.patients, parsed.patientLines, [&records](size_t i) { return string_view(records.patients[i].id); },
+         "patient ID");
+}
+
+// Staff and patients may name a department the hospital has or a
+// departments row adds, as batch mode requires; any other is taken for a
+// typo
+void Importer::dropUnknownDepartments() {
+    unordered_set<Symbol> added(parsed.records.departments.begin(), parsed.records.departments.end());
+    unordered_map<Symbol, bool> known;
+    auto check = [&](auto& rows, vector<Origin>& lines, auto departmentOf) {
+        vector<char> dropped(rows.size());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            Symbol department = departmentOf(rows[i]);
+            if (department.empty()) continue;
+            auto found = known.find(department);
+            if (found == known.end()) {
+                bool exists = added.count(department) || hospital.hasDepartment(department);
+                found = known.emplace(department, exists).first;
+            }
+            if (found->second) continue;
+            dropped[i] = true;
+            parsed.failures.push_back({lines[i], "unknown department " + department.str()});
+        }
+        removeRows(rows, lines, dropped);
+    };
+    check(parsed.records.staff, parsed.staffLines, [](const BulkRecords::Hire& hire) { return hire.member.department; });
+    check(parsed.records.patients, parsed.patientLines, [](const Patient& patient) { return patient.department; });
+}
+
+ImportSummary Importer::commit(ostream& errors) {
+    auto started = chrono::steady_clock::now();
+    dropUnknownDepartments();
+    dropRepeats();
+    BulkRecords& records = parsed.records;
+    hospital.bulkAdd(records);
+
+    for (size_t i : records.rejectedRooms) {
+        parsed.failures.push_back({parsed.roomLines[i], "room type " + records.rooms[i].type +
+                                                            " has patients in beds beyond its new counts"});
+    }
+    for (size_t i : records.rejectedStaff) {
+        parsed.failures.push_back({parsed.staffLines[i], "staff member " + records.staff[i].member.name +
+                                                             " is already on staff"});
+    }
+    for (size_t i : records.rejectedPatients) {
+        parsed.failures.push_back({parsed.patientLines[i], "patient ID " + records.patients[i].id + " already exists"});
+    }
+    stable_sort(parsed.failures.begin(), parsed.failures.end(), [](const Failure& a, const Failure& b) {
+        return a.at.source != b.at.source ? a.at.source < b.at.source : a.at.line < b.at.line;
+    });
+    for (const Failure& failure : parsed.failures) errors << place(failure.at) << " ERROR " << failure.reason << "\n";
+
+    ImportSummary summary;
+    summary.rows = parsed.rows;
+    summary.failed = parsed.failures.size();
+    summary.departments = records.addedDepartments;
+    summary.rooms = records.rooms.size() - records.rejectedRooms.size();
+    summary.staff = records.staff.size() - records.rejectedStaff.size();
+    summary.patients = records.patients.size() - records.rejectedPatients.size();
+    summary.seconds = readSeconds + chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    parsed = Part();
+    sources.clear();
+    readSeconds = 0;
+    return summary;
+}
+
+} // namespace hms
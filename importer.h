@@ -0,0 +1,136 @@
+#ifndef HMS_IMPORTER_H
+#define HMS_IMPORTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "hospital.h"
+
+namespace hms {
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Bulk import for onboarding a facility: departments, room types, staff
+// rosters and patients, from CSV files or from HL7-like segment files.
+//
+// A CSV file starts with a header naming its columns, in any order, which
+// also tells what its rows are:
+//
+//   rooms        type,total,occupied
+//   staff        role,name,department[,start,end]   (Work hours, inclusive)
+//   patients     id,name,age,reason,department
+//   departments  department
+//
+// Fields may be quoted ("Smith, J"), with "" for a quote inside. A
+// segment file holds one record per line, the segment name first and the
+// fields separated by '|'. MSH headers, blank lines and lines starting
+// with '#' are skipped:
+//
+//   DEP|NAME
+//   ROM|TYPE|TOTAL|OCCUPIED
+//   STF|ROLE|NAME|DEPARTMENT[|START|END]
+//   PID|ID|NAME|AGE|REASON|DEPARTMENT
+//
+// Roles are doctor, nurse or technician. Staff and patients must name a
+// department the hospital has or a departments row adds, or none. Room
+// types the hospital has are resized, as configure-rooms does in batch
+// mode.
+//
+// Files are read CHUNK_BYTES at a time. Each chunk is cut at its last
+// line end and its lines shared among the threads, which split fields
+// comparing 16 bytes at a time (SSE2) and check every row. Nothing reaches
+// the hospital before commit(): rows repeating a patient ID, staff name
+// or room type of an earlier row, in any file read, are found by threads
+// each taking a share of the hashes, and the remaining good rows go in
+// with one Hospital::bulkAdd. Bad rows are reported by file and line and
+// left out; they never stop the import.
+// ---------------------------------------------------------------------------
+
+enum class ImportFormat { Csv, Segments };
+
+struct ImportSummary {
+    size_t rows = 0;
+    size_t failed = 0;
+    size_t departments = 0; // added
+    size_t rooms = 0;       // added or resized
+    size_t staff = 0;
+    size_t patients = 0;
+    double seconds = 0;     // reading and committing
+};
+
+class Importer {
+public:
+    static const size_t CHUNK_BYTES = size_t(8) << 20;
+
+    Importer(Hospital& hospital, unsigned threads);
+
+    // Reads a file, as CSV if its name ends in ".csv" and as segments
+    // otherwise. False if it cannot be read or a CSV header does not tell
+    // what its rows are; bad rows are only counted.
+    bool read(const string& path, string& error);
+    bool read(istream& in, ImportFormat format, const string& name, string& error);
+
+    // Adds the good rows of every file read so far, then reports the bad
+    // ones in file and line order as "FILE:LINE ERROR reason"
+    ImportSummary commit(ostream& errors);
+
+private:
+    enum Kind : uint8_t { Rooms, Staff, Patients, Departments };
+
+    struct Origin {
+        uint32_t source; // file, in the order read
+        uint32_t line;
+    };
+
+    struct Failure {
+        Origin at;
+        string reason;
+    };
+
+    struct Line {
+        size_t begin, end;
+        uint32_t number;
+    };
+
+    // Where each field of a CSV file's rows is, by kind
+    struct Layout {
+        Kind kind = Rooms;
+        size_t width = 0;         // columns in the header
+        int column[5] = {-1, -1, -1, -1, -1};
+    };
+
+    // Rows parsed by one thread, in line order
+    struct Part {
+        BulkRecords records;
+        vector<Origin> roomLines, staffLines, patientLines;
+        vector<Failure> failures;
+        size_t rows = 0;
+    };
+
+    Hospital& hospital;
+    unsigned threads;
+    vector<string> sources;
+    Part parsed; // every file read so far
+    double readSeconds = 0;
+
+    // Appends the lines ending in the chunk, or at its end for the last
+    // one, numbering them from `line`; returns the bytes they take
+    static size_t cutLines(const string& chunk, bool quoted, bool last, uint32_t& line, vector<Line>& lines);
+    static bool readHeader(string_view text, Layout& layout, string& error);
+    void parse(const string& chunk, const Line* first, const Line* last, uint32_t source, ImportFormat format,
+               const Layout& layout, Part& part) const;
+    void parseRow(const string_view* fields, Kind kind, Origin at, Part& part) const;
+    static void append(Part& into, Part& from);
+    void dropUnknownDepartments();
+    void dropRepeats();
+    string place(Origin at) const; // FILE:LINE
+};
+
+} // namespace hms
+
+#endif // HMS_IMPORTER_H
@@ -0,0 +1,222 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <csignal>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hms {
+
+atomic<bool> metricsOn{true};
+
+namespace {
+
+const char* const STATUS_NAMES[STATUS_COUNT] = {
+    "ok", "not_found", "duplicate_id", "invalid_argument", "no_department",
+    "slot_unavailable", "no_room_available", "already_hospitalized", "storage_error",
+    "not_hospitalized",
+};
+
+// One thread's counters. Only the owner writes, with relaxed atomic
+// stores; readers load the same way, so no read-modify-write is needed.
+struct ThreadMetrics {
+    uint64_t outcomes[OPERATION_COUNT][STATUS_COUNT] = {};
+    uint64_t latency[OPERATION_COUNT][LATENCY_BUCKETS] = {};
+    uint64_t totalNs[OPERATION_COUNT] = {};
+    uint64_t maxNs[OPERATION_COUNT] = {};
+    uint64_t roomsFilled = 0;
+};
+
+void bump(uint64_t& counter, uint64_t by = 1) {
+    __atomic_store_n(&counter, __atomic_load_n(&counter, __ATOMIC_RELAXED) + by, __ATOMIC_RELAXED);
+}
+
+uint64_t read(const uint64_t& counter) {
+    return __atomic_load_n(&counter, __ATOMIC_RELAXED);
+}
+
+void addInto(MetricsSnapshot& sum, const ThreadMetrics& block) {
+    for (int op = 0; op < OPERATION_COUNT; ++op) {
+        auto& target = sum.operations[op];
+        for (int s = 0; s < STATUS_COUNT; ++s) target.outcomes[s] += read(block.outcomes[op][s]);
+        for (int b = 0; b < LATENCY_BUCKETS; ++b) target.latency[b] += read(block.latency[op][b]);
+        target.totalNs += read(block.totalNs[op]);
+        target.maxNs = max(target.maxNs, read(block.maxNs[op]));
+    }
+    sum.roomsFilled += read(block.roomsFilled);
+}
+
+// Live blocks, plus the totals of threads that have exited
+struct Registry {
+    mutex guard;
+    vector<ThreadMetrics*> live;
+    MetricsSnapshot retired;
+};
+
+Registry& registry() {
+    static Registry* instance = new Registry; // outlives thread_local destructors
+    return *instance;
+}
+
+class LocalMetrics {
+public:
+    LocalMetrics() {
+        lock_guard<mutex> lock(registry().guard);
+        registry().live.push_back(&block);
+    }
+    ~LocalMetrics() {
+        Registry& r = registry();
+        lock_guard<mutex> lock(r.guard);
+        addInto(r.retired, block);
+        r.live.erase(std::find(r.live.begin(), r.live.end(), &block));
+    }
+    ThreadMetrics block;
+};
+
+ThreadMetrics& local() {
+    thread_local LocalMetrics metrics;
+    return metrics.block;
+}
+
+string formatNs(uint64_t ns) {
+    if (ns >= 10000000) return to_string(ns / 1000000) + " ms";
+    if (ns >= 10000) return to_string(ns / 1000) + " us";
+    return to_string(ns) + " ns";
+}
+
+} // namespace
+
+const char* operationName(Operation op) {
+    switch (op) {
+    case Operation::Register: return "register";
+    case Operation::Lookup: return "lookup";
+    case Operation::Schedule: return "schedule";
+    case Operation::Hospitalize: return "hospitalize";
+    case Operation::Discharge: return "discharge";
+    case Operation::TimetableEdit: return "timetable_edit";
+    case Operation::RoomUpdate: return "room_update";
+    }
+    return "unknown";
+}
+
+uint64_t bucketFloor(int bucket) {
+    if (bucket < 16) return (uint64_t)bucket;
+    int msb = (bucket - 16) / 8 + 4;
+    return (uint64_t)(8 + (bucket - 16) % 8) << (msb - 3);
+}
+
+void recordOperation(Operation op, int status, uint64_t nanoseconds) {
+    ThreadMetrics& block = local();
+    int o = (int)op;
+    if (status < 0 || status >= STATUS_COUNT) status = STATUS_COUNT - 1;
+    bump(block.outcomes[o][status]);
+    bump(block.latency[o][latencyBucket(nanoseconds)]);
+    bump(block.totalNs[o], nanoseconds);
+    if (nanoseconds > read(block.maxNs[o])) __atomic_store_n(&block.maxNs[o], nanoseconds, __ATOMIC_RELAXED);
+}
+
+void recordRoomFilled() {
+    if (metricsEnabled()) bump(local().roomsFilled);
+}
+
+uint64_t MetricsSnapshot::PerOperation::calls() const {
+    uint64_t total = 0;
+    for (uint64_t count : outcomes) total += count;
+    return total;
+}
+
+uint64_t MetricsSnapshot::PerOperation::percentile(double fraction) const {
+    uint64_t total = calls();
+    if (total == 0) return 0;
+    uint64_t rank = (uint64_t)(fraction * (total - 1)) + 1, seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; ++b) {
+        seen += latency[b];
+        if (seen >= rank) return min(bucketFloor(b + 1), maxNs); // upper edge of the bucket
+    }
+    return maxNs;
+}
+
+MetricsSnapshot collectMetrics() {
+    Registry& r = registry();
+    lock_guard<mutex> lock(r.guard);
+    MetricsSnapshot sum = r.retired;
+    for (const ThreadMetrics* block : r.live) addInto(sum, *block);
+    return sum;
+}
+
+// Counters are owned by their threads, so a reset zeroes the retired
+// totals and stores zeros into live blocks; increments racing with it
+// may survive
+void resetMetrics() {
+    Registry& r = registry();
+    lock_guard<mutex> lock(r.guard);
+    r.retired = MetricsSnapshot();
+    for (ThreadMetrics* block : r.live) {
+        uint64_t* words = reinterpret_cast<uint64_t*>(block);
+        for (size_t i = 0; i < sizeof(ThreadMetrics) / sizeof(uint64_t); ++i) {
+            __atomic_store_n(&words[i], 0, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void writeMetricsText(ostream& out, const MetricsSnapshot& snapshot) {
+    out << left << setw(16) << "Operation" << right << setw(10) << "Calls" << setw(10) << "Failed"
+        << setw(10) << "Mean" << setw(10) << "p50" << setw(10) << "p99" << setw(10) << "Max" << "\n";
+    for (int op = 0; op < OPERATION_COUNT; ++op) {
+        const auto& stats = snapshot.operations[op];
+        uint64_t calls = stats.calls();
+        out << left << setw(16) << operationName((Operation)op) << right << setw(10) << calls << setw(10)
+            << stats.failures();
+        if (calls) {
+            out << setw(10) << formatNs(stats.totalNs / calls) << setw(10) << formatNs(stats.percentile(0.50))
+                << setw(10) << formatNs(stats.percentile(0.99)) << setw(10) << formatNs(stats.maxNs);
+        }
+        out << "\n";
+        for (int s = 1; s < STATUS_COUNT; ++s) {
+            if (stats.outcomes[s]) out << "    " << STATUS_NAMES[s] << ": " << stats.outcomes[s] << "\n";
+        }
+    }
+    out << "Room types filled up: " << snapshot.roomsFilled << "\n";
+}
+
+void writeMetricsJson(ostream& out, const MetricsSnapshot& snapshot) {
+    out << "{\"operations\":{";
+    for (int op = 0; op < OPERATION_COUNT; ++op) {
+        const auto& stats = snapshot.operations[op];
+        uint64_t calls = stats.calls();
+        if (op) out << ",";
+        out << "\"" << operationName((Operation)op) << "\":{\"calls\":" << calls << ",\"outcomes\":{";
+        bool first = true;
+        for (int s = 0; s < STATUS_COUNT; ++s) {
+            if (!stats.outcomes[s]) continue;
+            out << (first ? "" : ",") << "\"" << STATUS_NAMES[s] << "\":" << stats.outcomes[s];
+            first = false;
+        }
+        out << "},\"mean_ns\":" << (calls ? stats.totalNs / calls : 0) << ",\"p50_ns\":" << stats.percentile(0.50)
+            << ",\"p99_ns\":" << stats.percentile(0.99) << ",\"max_ns\":" << stats.maxNs << "}";
+    }
+    out << "},\"rooms_filled\":" << snapshot.roomsFilled << "}\n";
+}
+
+void installMetricsDump(bool json) {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    thread([signals, json] {
+        int received;
+        while (sigwait(&signals, &received) == 0) {
+            MetricsSnapshot snapshot = collectMetrics();
+            if (json) writeMetricsJson(cerr, snapshot);
+            else writeMetricsText(cerr, snapshot);
+            cerr.flush();
+        }
+    }).detach();
+}
+
+} // namespace hms
@@ -0,0 +1,118 @@
+#ifndef HMS_METRICS_H
+#define HMS_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace hms {
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Operation metrics. Every thread counts into its own block, so recording
+// is a few uncontended stores; blocks are summed when someone reads them.
+// Latencies go into log-linear (HDR-style) histograms with 8 sub-buckets
+// per power of two, i.e. about 12% relative precision.
+// When metrics are disabled an operation costs one relaxed load.
+// ---------------------------------------------------------------------------
+
+enum class Operation : uint8_t {
+    Register = 0,
+    Lookup,        // patient lookups by ID or name, as in Patient Management
+    Schedule,
+    Hospitalize,
+    Discharge,
+    TimetableEdit,
+    RoomUpdate,
+};
+const int OPERATION_COUNT = 7;
+const int STATUS_COUNT = 10;    // values of HmsStatus
+const int LATENCY_BUCKETS = 496;
+
+const char* operationName(Operation op);
+
+extern atomic<bool> metricsOn;
+
+inline bool metricsEnabled() { return metricsOn.load(memory_order_relaxed); }
+inline void setMetricsEnabled(bool enabled) { metricsOn.store(enabled, memory_order_relaxed); }
+
+// Histogram bucket of a latency in nanoseconds
+inline int latencyBucket(uint64_t ns) {
+    if (ns < 16) return (int)ns;
+    int msb = 63 - __builtin_clzll(ns);
+    return 16 + (msb - 4) * 8 + (int)((ns >> (msb - 3)) & 7);
+}
+
+// Smallest latency that falls into the bucket
+uint64_t bucketFloor(int bucket);
+
+// Records one finished operation; status is an HmsStatus value
+void recordOperation(Operation op, int status, uint64_t nanoseconds);
+
+// Counts a room type whose last free bed was just taken
+void recordRoomFilled();
+
+// Times the enclosing call. Set the outcome with result(), which returns
+// its argument so it can wrap return statements.
+class OperationTimer {
+public:
+    // Inactive timers record nothing, e.g. while the log is replayed
+    explicit OperationTimer(Operation op, bool active = true)
+        : op(op), start(active && metricsEnabled() ? now() : 0) {}
+    ~OperationTimer() {
+        if (start) recordOperation(op, status, now() - start);
+    }
+
+    OperationTimer(const OperationTimer&) = delete;
+    OperationTimer& operator=(const OperationTimer&) = delete;
+
+    template <class Status>
+    Status result(Status outcome) {
+        status = (int)outcome;
+        return outcome;
+    }
+
+private:
+    Operation op;
+    uint64_t start;
+    int status = 0;
+
+    static uint64_t now() {
+        return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+
+// Sum of all threads at one moment
+struct MetricsSnapshot {
+    struct PerOperation {
+        array<uint64_t, STATUS_COUNT> outcomes{}; // count per HmsStatus
+        array<uint64_t, LATENCY_BUCKETS> latency{};
+        uint64_t totalNs = 0;
+        uint64_t maxNs = 0;
+
+        uint64_t calls() const;
+        uint64_t failures() const { return calls() - outcomes[0]; }
+        uint64_t percentile(double fraction) const; // nanoseconds
+    };
+    array<PerOperation, OPERATION_COUNT> operations;
+    uint64_t roomsFilled = 0;
+};
+
+MetricsSnapshot collectMetrics();
+void resetMetrics();
+
+void writeMetricsText(ostream& out, const MetricsSnapshot& snapshot);
+void writeMetricsJson(ostream& out, const MetricsSnapshot& snapshot);
+
+// Starts a thread that writes the metrics to stderr on every SIGUSR1, as
+// text or JSON. Call it before any other thread is started so that they
+// all inherit the blocked signal.
+void installMetricsDump(bool json);
+
+} // namespace hms
+
+#endif // HMS_METRICS_H
@@ -0,0 +1,48 @@
+#ifndef HMS_PATIENT_H
+#define HMS_PATIENT_H
+
+#include <algorithm>
+#include <ctime>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "history.h"
+#include "symbols.h"
+
+namespace hms {
+using namespace std;
+
+class Patient {
+public:
+    string id;
+    string name;
+    int age;
+    string reasonForVisit;
+    Symbol department;
+    bool hospitalized;
+    Symbol roomType;
+    int bed = -1; // bed number in roomType while hospitalized
+    string hospitalizationDate;
+    string dischargeDate;
+    PatientHistory history;
+
+    Patient(string id = "", string name = "", int age = 0, string reason = "", string dept = "", 
+            bool hosp = false, string room = "", string hospDate = "", string discDate = "")
+        : id(id), name(name), age(age), reasonForVisit(reason), department(dept),
+          hospitalized(hosp), roomType(room), hospitalizationDate(hospDate), dischargeDate(discDate) {}
+
+    void addEvent(const HistoryEvent& event) {
+        history.append(event);
+    }
+
+    // Overload operator==
+    bool operator==(const Patient& other) const {
+        return id == other.id; // Compare based on unique ID
+    }
+};
+
+} // namespace hms
+
+#endif // HMS_PATIENT_H
@@ -0,0 +1,140 @@
+#ifndef HMS_PATIENT_REGISTRY_H
+#define HMS_PATIENT_REGISTRY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "archive.h"
+#include "patient.h"
+
+namespace hms {
+using namespace std;
+
+// Owns every active patient record. Records are kept in a deque so Patient*
+// handles stay valid while the registry grows, and lookups go through hash
+// indexes instead of scanning the whole list. Slots of removed records are
+// reused by later registrations.
+class PatientRegistry {
+public:
+    // Closed records in the archive still reserve their IDs
+    void attachArchive(const PatientArchive* closed) { archived = closed; }
+    const PatientArchive* archive() const { return archived; }
+
+    // Adds a copy of the patient; returns nullptr if the ID is already taken
+    Patient* add(const Patient& patient) { return insert(patient); }
+
+    // Moves the patient in, unless the ID is already taken and it is left
+    // as it was
+    Patient* add(Patient&& patient) { return insert(move(patient)); }
+
+    // Drops an active record, e.g. once it has been archived
+    bool remove(const string& id) {
+        auto it = byId.find(id);
+        if (it == byId.end()) return false;
+        size_t slot = it->second;
+        Patient* patient = &records[slot];
+        auto named = byName.find(patient->name);
+        auto& sameName = named->second;
+        sameName.erase(std::find(sameName.begin(), sameName.end(), patient));
+        if (sameName.empty()) byName.erase(named);
+        byId.erase(it);
+        records[slot] = Patient();
+        live[slot] = false;
+        freeSlots.push_back(slot);
+        --count;
+        return true;
+    }
+
+    Patient* findById(const string& id) {
+        auto it = byId.find(id);
+        return it == byId.end() ? nullptr : &records[it->second];
+    }
+
+    const Patient* findById(const string& id) const {
+        auto it = byId.find(id);
+        return it == byId.end() ? nullptr : &records[it->second];
+    }
+
+    // Returns the earliest registered patient with this name
+    Patient* findByName(const string& name) {
+        auto it = byName.find(name);
+        return it == byName.end() ? nullptr : it->second.front();
+    }
+
+    // True for active patients only
+    bool contains(const string& id) const {
+        return byId.count(id) != 0;
+    }
+
+    // True if the ID belongs to an active or an archived patient
+    bool idInUse(const string& id) const {
+        return contains(id) || (archived && archived->contains(id));
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // Iterates live records in slot order
+    template <class Record, class Registry>
+    class Iterator {
+    public:
+        Iterator(Registry* registry, size_t slot) : registry(registry), slot(slot) { skipDead(); }
+        Record& operator*() const { return registry->records[slot]; }
+        Record* operator->() const { return &registry->records[slot]; }
+        Iterator& operator++() { ++slot; skipDead(); return *this; }
+        bool operator!=(const Iterator& other) const { return slot != other.slot; }
+        bool operator==(const Iterator& other) const { return slot == other.slot; }
+    private:
+        Registry* registry;
+        size_t slot;
+        void skipDead() {
+            while (slot < registry->live.size() && !registry->live[slot]) ++slot;
+        }
+    };
+    using iterator = Iterator<Patient, PatientRegistry>;
+    using const_iterator = Iterator<const Patient, const PatientRegistry>;
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, records.size()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, records.size()); }
+
+private:
+    deque<Patient> records;
+    vector<bool> live;
+    vector<size_t> freeSlots;
+    size_t count = 0;
+    unordered_map<string, size_t> byId; // slot of each active ID
+    unordered_map<string, vector<Patient*>> byName; // registration order per name
+    const PatientArchive* archived = nullptr;
+
+    template <class Record>
+    Patient* insert(Record&& patient) {
+        if (patient.id.empty() || idInUse(patient.id)) return nullptr;
+        size_t slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+            records[slot] = forward<Record>(patient);
+            live[slot] = true;
+        } else {
+            slot = records.size();
+            records.push_back(forward<Record>(patient));
+            live.push_back(true);
+        }
+        Patient* stored = &records[slot];
+        byId.emplace(stored->id, slot);
+        byName[stored->name].push_back(stored);
+        ++count;
+        return stored;
+    }
+};
+
+} // namespace hms
+
+#endif // HMS_PATIENT_REGISTRY_H
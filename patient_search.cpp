@@ -0,0 +1,293 @@
+#include "patient_search.h"
+
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+
+namespace hms {
+
+namespace {
+
+const size_t MAX_PREFIX_TERMS = 128;  // completions tried per query word
+const size_t MAX_FUZZY_CHECKS = 2048; // candidate terms checked for edits
+
+const float EXACT = 1.0f;
+
+float fieldWeight(uint8_t fields) {
+    if (fields & (PatientSearchIndex::Id | PatientSearchIndex::Name)) return 3.0f;
+    if (fields & PatientSearchIndex::Reason) return 2.0f;
+    if (fields & PatientSearchIndex::Department) return 1.5f;
+    return 1.0f;
+}
+
+bool hasDigit(const string& term) {
+    return any_of(term.begin(), term.end(), [](char c) { return c >= '0' && c <= '9'; });
+}
+
+// Trigrams of the term padded with a space on both sides, so the first
+// and last letters count as much as the middle ones
+vector<uint32_t> trigramsOf(const string& term) {
+    string padded = " " + term + " ";
+    vector<uint32_t> grams;
+    for (size_t i = 0; i + 3 <= padded.size(); ++i) {
+        grams.push_back((uint32_t)(unsigned char)padded[i] << 16 | (uint32_t)(unsigned char)padded[i + 1] << 8 |
+                        (unsigned char)padded[i + 2]);
+    }
+    return grams;
+}
+
+// Terms that take part in typo-tolerant matching; IDs and numbers do not
+bool fuzzyTerm(const string& term) {
+    return term.size() >= 3 && !hasDigit(term);
+}
+
+// Edit distance, or limit + 1 once it is certain to exceed `limit`
+size_t editDistance(const string& a, const string& b, size_t limit) {
+    vector<size_t> previous(b.size() + 1), current(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); ++j) previous[j] = j;
+    for (size_t i = 1; i <= a.size(); ++i) {
+        current[0] = i;
+        size_t rowBest = current[0];
+        for (size_t j = 1; j <= b.size(); ++j) {
+            current[j] = min({previous[j] + 1, current[j - 1] + 1, previous[j - 1] + (a[i - 1] != b[j - 1])});
+            rowBest = min(rowBest, current[j]);
+        }
+        if (rowBest > limit) return limit + 1;
+        previous.swap(current);
+    }
+    return previous[b.size()];
+}
+
+// Per-thread accumulators sized to the document count, reset after use
+struct Scratch {
+    vector<uint16_t> matched; // query words matched so far
+    vector<float> total;
+    vector<uint32_t> touched;
+};
+
+} // namespace
+
+vector<string> PatientSearchIndex::tokenize(const string& text) {
+    vector<string> words;
+    string word;
+    for (char c : text) {
+        unsigned char u = (unsigned char)c;
+        if (u >= 0x80 || isalnum(u)) {
+            word += u < 0x80 ? (char)tolower(u) : c;
+        } else if (!word.empty()) {
+            words.push_back(move(word));
+            word.clear();
+        }
+    }
+    if (!word.empty()) words.push_back(move(word));
+    return words;
+}
+
+void PatientSearchIndex::add(const Patient& patient) {
+    lock_guard<shared_mutex> write(guard);
+    addLocked(patient);
+}
+
+void PatientSearchIndex::addText(const Patient& patient, Field field, const string& text) {
+    lock_guard<shared_mutex> write(guard);
+    auto it = documentOf.find(patient.id);
+    if (it != documentOf.end()) addTextLocked(it->second, field, text);
+}
+
+size_t PatientSearchIndex::size() const {
+    shared_lock<shared_mutex> read(guard);
+    return documents.size();
+}
+
+void PatientSearchIndex::clearLocked() {
+    dictionary.clear();
+    termText.clear();
+    postings.clear();
+    trigrams.clear();
+    documents.clear();
+    documentOf.clear();
+}
+
+void PatientSearchIndex::addLocked(const Patient& patient) {
+    vector<TermUse> terms;
+    addTerms(terms, Id, patient.id);
+    addTerms(terms, Name, patient.name);
+    addTerms(terms, Department, patient.department);
+    addTerms(terms, Reason, patient.reasonForVisit);
+    patient.history.forEach([&](const HistoryEvent& event) {
+        if (event.kind != EventKind::Discharged) addTerms(terms, History, eventStore.name(event.subject));
+    });
+
+    auto inserted = documentOf.emplace(patient.id, (uint32_t)documents.size());
+    uint32_t doc = inserted.first->second;
+    if (inserted.second) {
+        documents.push_back({&inserted.first->first, move(terms)});
+        for (const TermUse& use : documents[doc].terms) postings[use.term].push_back(doc);
+        return;
+    }
+    // A changed record: only the terms it lost or gained touch postings
+    vector<TermUse>& old = documents[doc].terms;
+    auto has = [](const vector<TermUse>& list, uint32_t term) {
+        return any_of(list.begin(), list.end(), [term](const TermUse& use) { return use.term == term; });
+    };
+    for (const TermUse& use : old) {
+        if (has(terms, use.term)) continue;
+        vector<uint32_t>& posting = postings[use.term];
+        auto it = find(posting.begin(), posting.end(), doc);
+        if (it != posting.end()) {
+            *it = posting.back();
+            posting.pop_back();
+        }
+    }
+    for (const TermUse& use : terms) {
+        if (!has(old, use.term)) postings[use.term].push_back(doc);
+    }
+    old = move(terms);
+}
+
+void PatientSearchIndex::addTextLocked(uint32_t doc, Field field, const string& text) {
+    vector<TermUse>& terms = documents[doc].terms;
+    size_t known = terms.size();
+    addTerms(terms, field, text);
+    for (size_t i = known; i < terms.size(); ++i) postings[terms[i].term].push_back(doc);
+}
+
+void PatientSearchIndex::addTerms(vector<TermUse>& terms, Field field, const string& text) {
+    for (const string& word : tokenize(text)) {
+        uint32_t term = internTerm(word);
+        auto seen = find_if(terms.begin(), terms.end(), [term](const TermUse& use) { return use.term == term; });
+        if (seen != terms.end()) seen->fields |= field;
+        else terms.push_back({term, (uint8_t)field});
+    }
+}
+
+uint32_t PatientSearchIndex::internTerm(const string& term) {
+    auto inserted = dictionary.emplace(term, (uint32_t)termText.size());
+    if (!inserted.second) return inserted.first->second;
+    uint32_t id = inserted.first->second;
+    termText.push_back(&inserted.first->first);
+    postings.emplace_back();
+    if (fuzzyTerm(term)) {
+        for (uint32_t gram : trigramsOf(term)) {
+            vector<uint32_t>& terms = trigrams[gram];
+            if (terms.empty() || terms.back() != id) terms.push_back(id);
+        }
+    }
+    return id;
+}
+
+// Terms a query word stands for: itself, its completions and, for longer
+// words, terms within one edit (two from eight letters on)
+void PatientSearchIndex::expand(const string& word, vector<Expansion>& out) const {
+    auto exact = dictionary.find(word);
+    if (exact != dictionary.end()) out.push_back({exact->second, EXACT});
+
+    size_t completions = 0;
+    for (auto it = dictionary.upper_bound(word); it != dictionary.end() && completions < MAX_PREFIX_TERMS; ++it) {
+        if (it->first.compare(0, word.size(), word) != 0) break;
+        out.push_back({it->second, 0.5f + 0.3f * word.size() / it->first.size()});
+        ++completions;
+    }
+
+    if (word.size() < 4 || !fuzzyTerm(word)) return;
+    size_t maxEdits = word.size() >= 8 ? 2 : 1;
+    vector<uint32_t> grams = trigramsOf(word);
+    size_t needed = grams.size() > 3 * maxEdits ? grams.size() - 3 * maxEdits : 1;
+    unordered_map<uint32_t, uint32_t> shared;
+    for (uint32_t gram : grams) {
+        auto it = trigrams.find(gram);
+        if (it == trigrams.end()) continue;
+        for (uint32_t term : it->second) ++shared[term];
+    }
+    size_t checked = 0;
+    for (const auto& candidate : shared) {
+        if (candidate.second < needed || checked >= MAX_FUZZY_CHECKS) continue;
+        const string& term = *termText[candidate.first];
+        if (term == word || term.compare(0, word.size(), word) == 0) continue; // already matched
+        if (term.size() + maxEdits < word.size() || term.size() > word.size() + maxEdits) continue;
+        ++checked;
+        size_t edits = editDistance(word, term, maxEdits);
+        if (edits <= maxEdits) out.push_back({candidate.first, edits == 1 ? 0.6f : 0.4f});
+    }
+}
+
+uint8_t PatientSearchIndex::fieldsOf(const Document& document, uint32_t term) {
+    for (const TermUse& use : document.terms) {
+        if (use.term == term) return use.fields;
+    }
+    return 0;
+}
+
+vector<PatientSearchIndex::Hit> PatientSearchIndex::search(const string& query, size_t limit) const {
+    vector<string> words = tokenize(query);
+    vector<Hit> hits;
+    if (words.empty() || limit == 0) return hits;
+    if (words.size() > 64) words.resize(64);
+
+    shared_lock<shared_mutex> read(guard);
+    thread_local Scratch scratch;
+    size_t count = documents.size();
+    if (scratch.matched.size() < count) {
+        scratch.matched.resize(count, 0);
+        scratch.total.resize(count, 0);
+    }
+    vector<uint32_t>& touched = scratch.touched;
+    touched.clear();
+
+    // The rarest word goes first, so later words only revisit its matches
+    vector<vector<Expansion>> expanded(words.size());
+    vector<pair<size_t, size_t>> order; // postings to scan, word
+    for (size_t w = 0; w < words.size(); ++w) {
+        expand(words[w], expanded[w]);
+        size_t cost = 0;
+        for (const Expansion& expansion : expanded[w]) cost += postings[expansion.term].size();
+        order.push_back({cost, w});
+    }
+    sort(order.begin(), order.end());
+
+    for (const Expansion& expansion : expanded[order[0].second]) {
+        for (uint32_t doc : postings[expansion.term]) {
+            float score = expansion.weight * fieldWeight(fieldsOf(documents[doc], expansion.term));
+            if (scratch.matched[doc] == 0) {
+                touched.push_back(doc);
+                scratch.matched[doc] = 1;
+                scratch.total[doc] = score;
+            } else {
+                scratch.total[doc] = max(scratch.total[doc], score);
+            }
+        }
+    }
+    unordered_map<uint32_t, float> weights;
+    for (uint16_t w = 1; w < (uint16_t)words.size(); ++w) {
+        weights.clear();
+        for (const Expansion& expansion : expanded[order[w].second]) weights[expansion.term] = expansion.weight;
+        for (uint32_t doc : touched) {
+            if (scratch.matched[doc] != w) continue;
+            float best = 0;
+            for (const TermUse& use : documents[doc].terms) {
+                auto weight = weights.find(use.term);
+                if (weight != weights.end()) best = max(best, weight->second * fieldWeight(use.fields));
+            }
+            if (best > 0) {
+                scratch.matched[doc] = w + 1;
+                scratch.total[doc] += best;
+            }
+        }
+    }
+
+    vector<pair<float, uint32_t>> ranked;
+    for (uint32_t doc : touched) {
+        if (scratch.matched[doc] == words.size()) ranked.push_back({scratch.total[doc], doc});
+        scratch.matched[doc] = 0;
+        scratch.total[doc] = 0;
+    }
+    size_t shown = min(limit, ranked.size());
+    partial_sort(ranked.begin(), ranked.begin() + shown, ranked.end(),
+                 [](const pair<float, uint32_t>& a, const pair<float, uint32_t>& b) {
+                     return a.first != b.first ? a.first > b.first : a.second < b.second;
+                 });
+    for (size_t i = 0; i < shown; ++i) hits.push_back({*documents[ranked[i].second].patientId, ranked[i].first});
+    return hits;
+}
+
+} // namespace hms
@@ -0,0 +1,104 @@
+#ifndef HMS_PATIENT_SEARCH_H
+#define HMS_PATIENT_SEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "patient.h"
+
+namespace hms {
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Full-text search over active patients. Words of the ID, name, department,
+// reason for visit and history (staff seen, rooms, notes) are lowercased
+// and kept in an inverted index: a sorted term dictionary for prefix
+// lookups, posting lists of documents per term, and a trigram index over
+// terms for typo-tolerant matches.
+//
+// A query matches patients that match every one of its words exactly, by
+// prefix or within one or two edits. Results are ranked by how well each
+// word matched, weighted by the field it matched in.
+//
+// The rarest query word is looked up in the posting lists; the others are
+// checked against each remaining candidate's own term list, so common
+// words do not cost a scan of their postings.
+//
+// Updates are incremental and in place: a changed record keeps its
+// document, and only the postings of terms it gained or lost change.
+// Documents name their patient by ID and hold no pointer to the record.
+// Thread-safe: updates take the index lock exclusively, searches shared.
+// ---------------------------------------------------------------------------
+
+class PatientSearchIndex {
+public:
+    enum Field : uint8_t { Id = 1, Name = 2, Department = 4, Reason = 8, History = 16 };
+
+    struct Hit {
+        string patientId;
+        float score;
+    };
+
+    // Indexes the whole record, updating any earlier document for its ID
+    void add(const Patient& patient);
+
+    // Adds words to the patient's current document
+    void addText(const Patient& patient, Field field, const string& text);
+
+    // Starts over with the given records
+    template <class Records>
+    void rebuild(const Records& records) {
+        lock_guard<shared_mutex> write(guard);
+        clearLocked();
+        for (const Patient& patient : records) addLocked(patient);
+    }
+
+    // Best matches first, at most `limit`
+    vector<Hit> search(const string& query, size_t limit = 20) const;
+
+    size_t size() const; // documents
+
+    // Lowercased alphanumeric words of `text`
+    static vector<string> tokenize(const string& text);
+
+private:
+    struct TermUse {
+        uint32_t term;
+        uint8_t fields; // Field bits the term occurs in
+    };
+
+    struct Document {
+        const string* patientId; // its key in documentOf
+        vector<TermUse> terms;   // forward index
+    };
+
+    mutable shared_mutex guard;
+    map<string, uint32_t> dictionary;           // term -> term ID, sorted for prefixes
+    vector<const string*> termText;             // term ID -> its key in the dictionary
+    vector<vector<uint32_t>> postings;          // documents by term ID
+    unordered_map<uint32_t, vector<uint32_t>> trigrams; // packed trigram -> term IDs
+    vector<Document> documents;
+    unordered_map<string, uint32_t> documentOf; // patient ID -> its document
+
+    void clearLocked();
+    void addLocked(const Patient& patient);
+    void addTextLocked(uint32_t doc, Field field, const string& text);
+    void addTerms(vector<TermUse>& terms, Field field, const string& text);
+    uint32_t internTerm(const string& term);
+    static uint8_t fieldsOf(const Document& document, uint32_t term);
+
+    struct Expansion {
+        uint32_t term;
+        float weight;
+    };
+    void expand(const string& word, vector<Expansion>& out) const;
+};
+
+} // namespace hms
+
+#endif // HMS_PATIENT_SEARCH_H
@@ -0,0 +1,254 @@
+#include "replication.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "server.h"
+
+namespace hms {
+
+namespace {
+
+const size_t MIN_READ = 64 * 1024; // log bytes read at a time, at least
+
+} // namespace
+
+// --- LogShipper --------------------------------------------------------------
+
+LogShipper::LogShipper(const string& directory)
+    : snapshotPath(directory + "/hms.snapshot"), logPath(directory + "/hms.wal") {}
+
+LogShipper::~LogShipper() {
+    if (logFd >= 0) ::close(logFd);
+}
+
+bool LogShipper::start(uint64_t lsn, uint64_t primaryLsn, string& snapshot, string& error) {
+    if (lsn > primaryLsn) {
+        error = "replica at record " + to_string(lsn) + " is ahead of the primary at " + to_string(primaryLsn);
+        return false;
+    }
+    // The LSN a snapshot covers opens its body, after magic, length and CRC
+    string contents;
+    uint64_t covered = 0;
+    if (readWholeFile(snapshotPath, contents)) {
+        if (contents.size() < 28) {
+            error = "cannot read the primary's snapshot";
+            return false;
+        }
+        BinaryReader header(contents.data() + 20, 8);
+        covered = header.u64();
+    }
+    snapshot.clear();
+    if (lsn < covered) {
+        if (lsn > 0) {
+            error = "replica at record " + to_string(lsn) + " is behind the primary's snapshot at " +
+                    to_string(covered) + "; restart it";
+            return false;
+        }
+        snapshot.swap(contents);
+        lsn = covered;
+    }
+    logFd = ::open(logPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (logFd < 0) {
+        error = "cannot read " + logPath + ": " + strerror(errno);
+        return false;
+    }
+    offset = Journal::HEADER_SIZE;
+    shipped = lsn;
+    return true;
+}
+
+size_t LogShipper::ship(string& out, size_t limit) {
+    size_t before = out.size();
+    struct stat info;
+    if (logFd < 0 || fstat(logFd, &info) != 0 || (uint64_t)info.st_size <= offset) return 0;
+    size_t available = (size_t)(info.st_size - offset);
+    size_t wanted = min(available, max(limit, MIN_READ));
+    while (true) {
+        chunk.resize(wanted);
+        ssize_t got = pread(logFd, &chunk[0], wanted, (off_t)offset);
+        if (got <= 0) return 0;
+        chunk.resize((size_t)got);
+        size_t pos = 0, length;
+        uint64_t lsn;
+        LogOp op;
+        BinaryReader body(nullptr, 0);
+        while (out.size() - before < limit &&
+               (length = decodeLogRecord(chunk.data() + pos, chunk.size() - pos, lsn, op, body))) {
+            if (lsn > shipped) {
+                out.append(chunk, pos, length);
+                shipped = lsn;
+            }
+            pos += length;
+        }
+        offset += pos;
+        // A record longer than the chunk is read whole; a half-written
+        // one is left for the next call
+        if (pos > 0 || (size_t)got == available) break;
+        wanted = available;
+    }
+    return out.size() - before;
+}
+
+void LogShipper::rewind() {
+    offset = Journal::HEADER_SIZE;
+}
+
+// --- Replica -----------------------------------------------------------------
+
+Replica::Replica(Hospital& hospital, const string& primary) : hospital(hospital), primary(primary) {}
+
+Replica::~Replica() {
+    stop();
+}
+
+void Replica::start() {
+    follower = thread(&Replica::follow, this);
+}
+
+void Replica::stop() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping.store(true);
+        if (fd >= 0) shutdown(fd, SHUT_RDWR);
+    }
+    stopped.notify_all();
+    if (follower.joinable()) follower.join();
+}
+
+ReplicaStatus Replica::status() const {
+    lock_guard<mutex> guard(lock);
+    ReplicaStatus status = current;
+    status.lsn = hospital.logPosition();
+    return status;
+}
+
+void Replica::setStatus(bool connected, const string& error) {
+    lock_guard<mutex> guard(lock);
+    current.connected = connected;
+    if (!error.empty()) current.error = error;
+}
+
+void Replica::follow() {
+    while (!stopping.load()) {
+        string error;
+        if (!stream(error)) {
+            setStatus(false, error);
+            lock_guard<mutex> guard(lock);
+            current.stopped = true;
+            return;
+        }
+        setStatus(false, error);
+        unique_lock<mutex> guard(lock);
+        stopped.wait_for(guard, chrono::seconds(1), [&] { return stopping.load(); });
+    }
+}
+
+bool Replica::stream(string& error) {
+    int socket = connectSocket(primary, error);
+    if (socket < 0) return true;
+    {
+        lock_guard<mutex> guard(lock);
+        if (stopping.load()) {
+            ::close(socket);
+            return true;
+        }
+        fd = socket;
+        current.connected = true;
+    }
+    string request;
+    encodeRequest(request, 0, "replicate|" + to_string(hospital.logPosition()));
+    bool refused = false;
+    if (send(socket, request.data(), request.size(), MSG_NOSIGNAL) != (ssize_t)request.size()) {
+        error = string("cannot send to the primary: ") + strerror(errno);
+    } else {
+        enum { Reply, Snapshot, Log } phase = Reply;
+        string in;
+        char buffer[65536];
+        while (!stopping.load()) {
+            ssize_t received = recv(socket, buffer, sizeof(buffer), 0);
+            if (received < 0 && errno == EINTR) continue;
+            if (received <= 0) {
+                error = received == 0 ? "the primary closed the connection" : strerror(errno);
+                break;
+            }
+            in.append(buffer, (size_t)received);
+            if (phase == Reply) {
+                Frame frame;
+                long length = decodeFrame(in.data(), in.size(), frame);
+                if (length == 0) continue;
+                if (length < 0 || frame.body.empty()) {
+                    error = "the primary does not speak the protocol";
+                    break;
+                }
+                string text(frame.body.substr(1));
+                bool ok = frame.body[0] == 0;
+                in.erase(0, (size_t)length);
+                if (!ok) {
+                    error = text;
+                    refused = true;
+                    break;
+                }
+                phase = text == "snapshot" ? Snapshot : Log;
+                if (phase == Log && !started) {
+                    uint64_t lsn;
+                    started = hospital.startReplica(string(), lsn);
+                }
+            }
+            if (phase == Snapshot) {
+                uint64_t size;
+                if (in.size() < 8) continue;
+                memcpy(&size, in.data(), 8);
+                if (in.size() - 8 < size) continue;
+                uint64_t lsn;
+                if (started || !hospital.startReplica(in.substr(8, size), lsn)) {
+                    error = started ? "the primary sent a snapshot to a replica holding state"
+                                    : "cannot load the primary's snapshot";
+                    refused = true;
+                    break;
+                }
+                started = true;
+                in.erase(0, 8 + size);
+                phase = Log;
+            }
+            if (!started) {
+                error = "cannot start from the primary's state";
+                refused = true;
+                break;
+            }
+            size_t pos = 0, length, applied = 0;
+            uint64_t lsn;
+            LogOp op;
+            BinaryReader body(nullptr, 0);
+            while ((length = decodeLogRecord(in.data() + pos, in.size() - pos, lsn, op, body))) {
+                hospital.applyReplicated(lsn, op, body);
+                pos += length;
+                ++applied;
+            }
+            // A whole record that does not decode is damaged, not short
+            uint32_t next = 0;
+            if (in.size() - pos >= 8) memcpy(&next, in.data() + pos, 4);
+            if (in.size() - pos >= 8 && (next < 9 || next <= in.size() - pos - 8)) {
+                error = "damaged log record after " + to_string(hospital.logPosition());
+                break;
+            }
+            in.erase(0, pos);
+            lock_guard<mutex> guard(lock);
+            current.records += applied;
+        }
+    }
+    {
+        lock_guard<mutex> guard(lock);
+        fd = -1;
+    }
+    ::close(socket);
+    return !refused;
+}
+
+} // namespace hms
@@ -0,0 +1,106 @@
+#ifndef HMS_REPLICATION_H
+#define HMS_REPLICATION_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "hospital.h"
+
+namespace hms {
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Log shipping. A replica connects to its primary's server and sends
+// `replicate|LSN` with the last log record it applied (0 for none). The
+// OK reply says what follows, after which the connection carries no more
+// frames, only the primary's files as they are: for "snapshot" a u64
+// length and the snapshot file, then, for "log" straight away, the log
+// records in the log file's own format for as long as it stays open.
+//
+// Records are shipped once the journal has written them to the log file,
+// without waiting for any replica, so replicas trail their primary by a
+// few milliseconds. A replica that is behind the primary's snapshot gets
+// the snapshot only if it holds nothing yet; otherwise it is refused and
+// has to be restarted.
+// ---------------------------------------------------------------------------
+
+// The primary's side of one replica
+class LogShipper {
+public:
+    explicit LogShipper(const string& directory);
+    ~LogShipper();
+
+    LogShipper(const LogShipper&) = delete;
+    LogShipper& operator=(const LogShipper&) = delete;
+
+    // Positions the shipper after `lsn`, given that the primary has
+    // written up to `primaryLsn`. Fills `snapshot` when the replica needs
+    // it; false with `error` set if the replica cannot follow from `lsn`.
+    bool start(uint64_t lsn, uint64_t primaryLsn, string& snapshot, string& error);
+
+    // Appends the whole records written since the last call, stopping
+    // once about `limit` bytes are appended; returns the bytes appended
+    size_t ship(string& out, size_t limit);
+
+    // The log file started over after a checkpoint
+    void rewind();
+
+    uint64_t position() const { return shipped; } // last record shipped
+
+private:
+    string snapshotPath;
+    string logPath;
+    int logFd = -1;
+    uint64_t offset = 0; // in the log file, after the last record read
+    uint64_t shipped = 0;
+    string chunk;
+};
+
+struct ReplicaStatus {
+    uint64_t lsn = 0;       // last record applied
+    uint64_t records = 0;   // applied since start
+    bool connected = false;
+    bool stopped = false;   // refused by the primary; restart to follow again
+    string error;           // why the last connection ended
+};
+
+// The replica's side: follows a primary into a hospital that was never
+// opened, on a thread of its own, reconnecting after a second whenever
+// the connection drops
+class Replica {
+public:
+    Replica(Hospital& hospital, const string& primary);
+    ~Replica();
+
+    Replica(const Replica&) = delete;
+    Replica& operator=(const Replica&) = delete;
+
+    void start();
+    void stop();
+    ReplicaStatus status() const;
+
+private:
+    Hospital& hospital;
+    string primary;
+    thread follower;
+    atomic<bool> stopping{false};
+    bool started = false; // the hospital holds the primary's state
+    int fd = -1;
+
+    mutable mutex lock; // guards status and fd
+    condition_variable stopped;
+    ReplicaStatus current;
+
+    void follow();
+    bool stream(string& error); // false if the primary refused us
+    void setStatus(bool connected, const string& error);
+};
+
+} // namespace hms
+
+#endif // HMS_REPLICATION_H
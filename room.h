@@ -0,0 +1,136 @@
+#ifndef HMS_ROOM_H
+#define HMS_ROOM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "symbols.h"
+
+namespace hms {
+using namespace std;
+
+// What a bed is used for. Blocked beds are counted as occupied without a
+// known patient, e.g. set by hand in Room Management.
+enum class BedState : uint8_t { Free = 0, Patient = 1, Blocked = 2 };
+
+// A room type and its beds, numbered 0 to totalRooms - 1. Free beds sit on
+// a lock-free stack whose head carries a version tag against ABA, so
+// allocateBed and releaseBed are O(1) and may run on several threads.
+// occupiedRooms is kept atomically and can be read without a lock.
+// resize and rebuildFreeList must run alone; markBed may run alongside
+// readers but not alongside allocateBed and releaseBed.
+class Room {
+public:
+    Symbol type;
+    int totalRooms;
+    int occupiedRooms;
+
+    Room(string type = "", int total = 0, int occupied = 0)
+        : type(type), totalRooms(0), occupiedRooms(0) {
+        resize(total, occupied);
+    }
+
+    int availableRooms() const {
+        return totalRooms - __atomic_load_n(&occupiedRooms, __ATOMIC_ACQUIRE);
+    }
+
+    // Takes a free bed for a patient; returns its number, or -1 if full
+    int allocateBed() {
+        uint64_t head = __atomic_load_n(&freeHead, __ATOMIC_ACQUIRE);
+        uint32_t bed;
+        do {
+            bed = (uint32_t)head;
+            if (bed == NO_BED) return -1;
+        } while (!__atomic_compare_exchange_n(&freeHead, &head, tagged(head, load(nextFree[bed])), true,
+                                              __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+        __atomic_store_n(&states[bed], (uint8_t)BedState::Patient, __ATOMIC_RELEASE);
+        __atomic_fetch_add(&occupiedRooms, 1, __ATOMIC_ACQ_REL);
+        return (int)bed;
+    }
+
+    // Returns a bed taken by allocateBed to the free stack; false if the
+    // bed held no patient
+    bool releaseBed(int bed) {
+        if (bed < 0 || bed >= totalRooms || bedState(bed) != BedState::Patient) return false;
+        __atomic_store_n(&states[bed], (uint8_t)BedState::Free, __ATOMIC_RELEASE);
+        uint64_t head = __atomic_load_n(&freeHead, __ATOMIC_ACQUIRE);
+        do {
+            __atomic_store_n(&nextFree[bed], (uint32_t)head, __ATOMIC_RELEASE);
+        } while (!__atomic_compare_exchange_n(&freeHead, &head, tagged(head, (uint32_t)bed), true,
+                                              __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+        __atomic_fetch_sub(&occupiedRooms, 1, __ATOMIC_ACQ_REL);
+        return true;
+    }
+
+    BedState bedState(int bed) const {
+        return (BedState)__atomic_load_n(&states[bed], __ATOMIC_ACQUIRE);
+    }
+
+    // Changes the bed count and the number of occupied beds. Beds held by
+    // patients keep their numbers; the rest of `occupied` is made up of
+    // Blocked beds. False if patient beds would be lost.
+    bool resize(int total, int occupied) {
+        int patients = 0, highest = -1;
+        for (int bed = 0; bed < totalRooms; ++bed) {
+            if (bedState(bed) == BedState::Patient) {
+                ++patients;
+                highest = bed;
+            }
+        }
+        if (total < 0 || occupied > total || total <= highest || occupied < patients) return false;
+        states.resize(total, (uint8_t)BedState::Free);
+        int blocked = occupied - patients;
+        for (int bed = 0; bed < total; ++bed) {
+            if (states[bed] == (uint8_t)BedState::Patient) continue;
+            states[bed] = (uint8_t)(blocked > 0 ? BedState::Blocked : BedState::Free);
+            if (blocked > 0) --blocked;
+        }
+        totalRooms = total;
+        rebuildFreeList();
+        return true;
+    }
+
+    // Sets one bed directly and keeps the count, for recovery and replicas;
+    // the free stack is stale until rebuildFreeList
+    void markBed(int bed, BedState state) {
+        if (bed < 0 || bed >= totalRooms) return;
+        uint8_t was = __atomic_exchange_n(&states[bed], (uint8_t)state, __ATOMIC_ACQ_REL);
+        int change = (state != BedState::Free) - (was != (uint8_t)BedState::Free);
+        if (change) __atomic_fetch_add(&occupiedRooms, change, __ATOMIC_ACQ_REL);
+    }
+
+    // Puts every Free bed on the stack, lowest number on top, and recounts
+    void rebuildFreeList() {
+        nextFree.assign(totalRooms, NO_BED);
+        uint32_t head = NO_BED;
+        int occupied = 0;
+        for (int bed = totalRooms - 1; bed >= 0; --bed) {
+            if (states[bed] != (uint8_t)BedState::Free) {
+                ++occupied;
+                continue;
+            }
+            nextFree[bed] = head;
+            head = (uint32_t)bed;
+        }
+        freeHead = head;
+        occupiedRooms = occupied;
+    }
+
+private:
+    static constexpr uint32_t NO_BED = 0xFFFFFFFFu;
+
+    vector<uint8_t> states;    // BedState of each bed
+    vector<uint32_t> nextFree; // link to the next free bed
+    uint64_t freeHead = NO_BED; // version << 32 | top bed
+
+    static uint32_t load(const uint32_t& link) { return __atomic_load_n(&link, __ATOMIC_ACQUIRE); }
+
+    static uint64_t tagged(uint64_t head, uint32_t bed) {
+        return ((head >> 32) + 1) << 32 | bed;
+    }
+};
+
+} // namespace hms
+
+#endif // HMS_ROOM_H
@@ -0,0 +1,529 @@
+#include "router.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <unordered_set>
+
+#include "batch.h"
+#include "binary_io.h"
+#include "server.h"
+
+namespace hms {
+
+namespace {
+
+const int FACILITY_TIMEOUT_SECONDS = 30; // for a facility to answer
+
+enum class Merge {
+    Answered, // by the router itself
+    Forward,  // one facility's reply as it is
+    All,
+    Find,
+    FreeBeds,
+    Rooms,
+};
+
+bool startsWith(const string& text, const char* prefix) {
+    return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+bool sendAll(int fd, const string& bytes) {
+    for (size_t sent = 0; sent < bytes.size();) {
+        ssize_t n = send(fd, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += (size_t)n;
+    }
+    return true;
+}
+
+// Calls `line` for each line of a reply
+template <class Visit>
+void forEachLine(const string& text, Visit line) {
+    for (size_t start = 0; start < text.size();) {
+        size_t end = text.find('\n', start);
+        if (end == string::npos) end = text.size();
+        if (end > start) line(text.substr(start, end - start));
+        start = end + 1;
+    }
+}
+
+} // namespace
+
+struct Router::Request {
+    uint32_t tag = 0;
+    string command;
+    Merge merge = Merge::Answered;
+    string target;          // passed on to the facilities
+    string patientId;       // of a patient command
+    size_t facility = 0;    // for Forward
+    bool needsHome = false; // the patient's facility is looked up first
+    string filter;          // room type asked for by free-beds
+    size_t firstPart = 0;
+    size_t partCount = 0;
+    bool ok = false;
+    string text;
+};
+
+struct Router::Part {
+    size_t facility = 0;
+    bool replica = false;
+    string command;
+    bool answered = false;
+    bool ok = false;
+    string text;
+};
+
+bool parseFacility(const string& spec, Facility& facility, string& error) {
+    size_t equals = spec.find('=');
+    if (equals == string::npos || equals == 0 || spec.find('|') < equals) {
+        error = "facility must be NAME=PRIMARY[,REPLICA]: " + spec;
+        return false;
+    }
+    facility.name = spec.substr(0, equals);
+    string addresses = spec.substr(equals + 1);
+    size_t comma = addresses.find(',');
+    facility.primary = addresses.substr(0, comma);
+    facility.replica = comma == string::npos ? string() : addresses.substr(comma + 1);
+    if (facility.primary.empty()) {
+        error = "facility " + facility.name + " needs a primary address";
+        return false;
+    }
+    return true;
+}
+
+Router::Router(vector<Facility> facilities) : facilities(move(facilities)) {
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+Router::~Router() {
+    for (int fd : listeners) close(fd);
+    for (const string& path : unixPaths) unlink(path.c_str());
+    close(wakeFd);
+}
+
+bool Router::listen(const string& address, string& error) {
+    int fd = listenSocket(address, error);
+    if (fd < 0) return false;
+    listeners.push_back(fd);
+    if (startsWith(address, "unix:")) unixPaths.push_back(address.substr(5));
+    return true;
+}
+
+void Router::stop() {
+    stopping.store(true);
+    uint64_t one = 1;
+    ssize_t ignored = write(wakeFd, &one, sizeof(one));
+    (void)ignored;
+}
+
+RouterStats Router::stats() const {
+    lock_guard<mutex> lock(statsLock);
+    return counters;
+}
+
+void Router::run() {
+    vector<pollfd> watched;
+    for (int fd : listeners) watched.push_back({fd, POLLIN, 0});
+    watched.push_back({wakeFd, POLLIN, 0});
+    while (!stopping.load()) {
+        int ready = poll(watched.data(), watched.size(), 1000);
+        if (ready < 0 && errno != EINTR) break;
+        for (size_t i = 0; i < listeners.size(); ++i) {
+            if (!(watched[i].revents & POLLIN)) continue;
+            int fd;
+            while ((fd = accept4(listeners[i], nullptr, nullptr, SOCK_CLOEXEC)) >= 0) {
+                int on = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // fails harmlessly on Unix sockets
+                lock_guard<mutex> lock(clientLock);
+                clients.push_back(make_unique<Client>());
+                Client& client = *clients.back();
+                client.fd = fd;
+                client.runner = thread([this, &client] { serve(client); });
+                lock_guard<mutex> stats(statsLock);
+                ++counters.connections;
+            }
+        }
+        lock_guard<mutex> lock(clientLock);
+        for (auto it = clients.begin(); it != clients.end();) {
+            if (!(*it)->done.load()) {
+                ++it;
+                continue;
+            }
+            (*it)->runner.join();
+            it = clients.erase(it);
+        }
+    }
+    // Clients stop reading, answer what they have read and hang up
+    {
+        lock_guard<mutex> lock(clientLock);
+        for (auto& client : clients) {
+            if (client->fd >= 0) shutdown(client->fd, SHUT_RD);
+        }
+    }
+    for (auto& client : clients) client->runner.join();
+    clients.clear();
+}
+
+void Router::serve(Client& client) {
+    vector<Link> links(facilities.size() * 2); // primary, replica per facility
+    vector<Request> batch;
+    string in, out;
+    char buffer[65536];
+    bool open = true;
+    while (open) {
+        ssize_t received = recv(client.fd, buffer, sizeof(buffer), 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) open = false;
+        else in.append(buffer, (size_t)received);
+
+        size_t used = 0;
+        long length = 0;
+        Frame frame;
+        while (true) {
+            batch.clear();
+            while (batch.size() < MAX_BATCH &&
+                   (length = decodeFrame(in.data() + used, in.size() - used, frame)) > 0) {
+                used += (size_t)length;
+                batch.emplace_back();
+                batch.back().tag = frame.tag;
+                batch.back().command.assign(frame.body.data(), frame.body.size());
+            }
+            if (batch.empty()) break;
+            out.clear();
+            answer(batch, links, out);
+            if (!sendAll(client.fd, out)) {
+                open = false;
+                break;
+            }
+        }
+        in.erase(0, used);
+        if (length < 0) open = false; // not speaking the protocol
+    }
+    for (Link& link : links) {
+        if (link.fd >= 0) close(link.fd);
+    }
+    lock_guard<mutex> lock(clientLock);
+    close(client.fd);
+    client.fd = -1;
+    client.done.store(true);
+}
+
+// Plans where each command goes, finds the patients not seen before, then
+// asks the facilities and merges their replies
+void Router::answer(vector<Request>& batch, vector<Link>& links, string& out) {
+    const size_t count = facilities.size();
+    unordered_map<string, size_t> homes; // patients placed earlier in the batch
+    vector<string> unknown;
+    unordered_set<string> probing;
+    for (Request& request : batch) {
+        string command = request.command;
+        size_t named = count;
+        if (startsWith(command, "at|")) {
+            size_t bar = command.find('|', 3);
+            string name = command.substr(3, bar == string::npos ? string::npos : bar - 3);
+            named = facilityNamed(name);
+            if (named == count || bar == string::npos) {
+                request.text = "unknown facility " + name;
+                continue;
+            }
+            command.erase(0, bar + 1);
+        } else if (startsWith(command, "all|")) {
+            request.merge = Merge::All;
+            request.target = command.substr(4);
+            continue;
+        } else if (startsWith(command, "find|")) {
+            request.merge = Merge::Find;
+            request.patientId = command.substr(5);
+            request.target = "lookup|" + request.patientId;
+            continue;
+        } else if (command == "free-beds" || startsWith(command, "free-beds|")) {
+            request.merge = Merge::FreeBeds;
+            request.filter = command.size() > 10 ? command.substr(10) : string();
+            request.target = "rooms";
+            continue;
+        } else if (command == "rooms") {
+            request.merge = Merge::Rooms;
+            request.target = command;
+            continue;
+        } else if (command == "facilities") {
+            for (const Facility& facility : facilities) {
+                if (!request.text.empty()) request.text += "\n";
+                request.text += facility.name + "|" + facility.primary + "|" + facility.replica;
+            }
+            request.ok = true;
+            continue;
+        }
+
+        string id;
+        bool patient = BatchRunner::patientCommand(command, id) ||
+                       (startsWith(command, "lookup|") && (id = command.substr(7), true));
+        request.merge = Merge::Forward;
+        request.target = command;
+        if (named < count) {
+            request.facility = named;
+            if (patient) homes[id] = named;
+            continue;
+        }
+        if (!patient) {
+            request.merge = Merge::Answered;
+            request.text = "name a facility: at|FACILITY|" + command;
+            continue;
+        }
+        request.patientId = id;
+        auto placed = homes.find(id);
+        size_t known;
+        if (placed != homes.end()) {
+            request.facility = placed->second;
+        } else if (locate(id, known)) {
+            request.facility = homes[id] = known;
+        } else {
+            request.needsHome = true;
+            if (probing.insert(id).second) unknown.push_back(id);
+        }
+    }
+
+    if (!unknown.empty()) {
+        vector<Part> probes;
+        for (const string& id : unknown) {
+            for (size_t f = 0; f < count; ++f) {
+                probes.emplace_back();
+                probes.back().facility = f;
+                probes.back().command = "lookup|" + id;
+            }
+        }
+        exchange(probes, links);
+        for (size_t i = 0; i < unknown.size(); ++i) {
+            size_t found = count;
+            for (size_t f = 0; f < count && found == count; ++f) {
+                if (probes[i * count + f].ok) found = f;
+            }
+            if (found < count) remember(unknown[i], found);
+            homes[unknown[i]] = found < count ? found : homeOf(unknown[i]);
+        }
+        lock_guard<mutex> lock(statsLock);
+        counters.probes += unknown.size();
+    }
+
+    vector<Part> parts;
+    for (Request& request : batch) {
+        if (request.merge == Merge::Answered) continue;
+        if (request.needsHome) request.facility = homes[request.patientId];
+        request.firstPart = parts.size();
+        bool queries = request.merge != Merge::Forward && request.merge != Merge::All;
+        for (size_t f = 0; f < count; ++f) {
+            if (request.merge == Merge::Forward && f != request.facility) continue;
+            parts.emplace_back();
+            parts.back().facility = f;
+            parts.back().replica = queries && !facilities[f].replica.empty();
+            parts.back().command = request.target;
+        }
+        request.partCount = parts.size() - request.firstPart;
+    }
+    exchange(parts, links);
+
+    uint64_t failed = 0;
+    for (Request& request : batch) {
+        Part* first = parts.data() + request.firstPart;
+        Part* last = first + request.partCount;
+        switch (request.merge) {
+        case Merge::Answered:
+            break;
+        case Merge::Forward:
+            request.ok = first->ok;
+            request.text = first->text;
+            if (request.ok && startsWith(request.target, "register|")) remember(request.patientId, first->facility);
+            break;
+        case Merge::All:
+            request.ok = true;
+            for (Part* part = first; part != last; ++part) {
+                if (part->ok) continue;
+                request.text += (request.ok ? "" : "; ") + facilities[part->facility].name + ": " + part->text;
+                request.ok = false;
+            }
+            break;
+        case Merge::Find:
+            request.text = "unknown patient " + request.patientId;
+            for (Part* part = first; part != last; ++part) {
+                if (!part->ok) continue;
+                request.ok = true;
+                request.text = facilities[part->facility].name + "|" + part->text;
+                remember(request.patientId, part->facility);
+                break;
+            }
+            break;
+        case Merge::FreeBeds:
+        case Merge::Rooms: {
+            struct Free {
+                size_t facility;
+                string type;
+                long beds;
+            };
+            vector<Free> free;
+            request.ok = true;
+            for (Part* part = first; part != last; ++part) {
+                const string& name = facilities[part->facility].name;
+                if (!part->ok) {
+                    request.text = (request.ok ? "" : request.text + "; ") + name + ": " + part->text;
+                    request.ok = false;
+                    continue;
+                }
+                if (!request.ok) continue;
+                forEachLine(part->text, [&](const string& line) {
+                    if (request.merge == Merge::Rooms) {
+                        request.text += (request.text.empty() ? "" : "\n") + name + "|" + line;
+                        return;
+                    }
+                    size_t bar = line.find('|'), next = line.find('|', bar + 1);
+                    if (next == string::npos) return;
+                    string type = line.substr(0, bar);
+                    long beds = atol(line.c_str() + bar + 1) - atol(line.c_str() + next + 1);
+                    if (beds > 0 && (request.filter.empty() || type == request.filter)) {
+                        free.push_back({part->facility, type, beds});
+                    }
+                });
+            }
+            if (!request.ok || request.merge == Merge::Rooms) break;
+            stable_sort(free.begin(), free.end(), [](const Free& a, const Free& b) { return a.beds > b.beds; });
+            for (const Free& entry : free) {
+                if (!request.text.empty()) request.text += "\n";
+                request.text += facilities[entry.facility].name + "|" + entry.type + "|" + to_string(entry.beds);
+            }
+            break;
+        }
+        }
+        failed += !request.ok;
+        encodeReply(out, request.tag, request.ok, request.text);
+    }
+    lock_guard<mutex> lock(statsLock);
+    counters.requests += batch.size();
+    counters.failed += failed;
+}
+
+// Sends every part to its facility, all facilities before any reply is
+// read, and waits for the replies. A replica that cannot be reached is
+// passed over for its primary.
+void Router::exchange(vector<Part>& parts, vector<Link>& links) {
+    const size_t NONE = SIZE_MAX;
+    vector<string> pending(links.size());
+    vector<size_t> expected(links.size());
+    vector<size_t> linkOf(parts.size(), NONE);
+    vector<string> unreachable(links.size());
+
+    auto connect = [&](size_t index) {
+        if (links[index].fd >= 0 || !unreachable[index].empty()) return links[index].fd >= 0;
+        const Facility& facility = facilities[index / 2];
+        string error;
+        int fd = connectSocket(index % 2 ? facility.replica : facility.primary, error);
+        if (fd < 0) {
+            unreachable[index] = error;
+            return false;
+        }
+        timeval timeout{FACILITY_TIMEOUT_SECONDS, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        links[index].fd = fd;
+        links[index].in.clear();
+        return true;
+    };
+    auto fail = [&](size_t index, const string& reason) {
+        for (size_t i = 0; i < parts.size(); ++i) {
+            if (linkOf[i] != index || parts[i].answered) continue;
+            parts[i].answered = true;
+            parts[i].text = facilities[parts[i].facility].name + " " + reason;
+        }
+        close(links[index].fd);
+        links[index].fd = -1;
+        expected[index] = 0;
+    };
+
+    for (size_t i = 0; i < parts.size(); ++i) {
+        Part& part = parts[i];
+        size_t index = part.facility * 2 + part.replica;
+        if (!connect(index) && part.replica) {
+            part.replica = false;
+            --index;
+            connect(index);
+        }
+        if (links[index].fd < 0) {
+            part.answered = true;
+            part.text = facilities[part.facility].name + " unavailable: " + unreachable[index];
+            continue;
+        }
+        encodeRequest(pending[index], (uint32_t)i, part.command);
+        linkOf[i] = index;
+        ++expected[index];
+    }
+    for (size_t index = 0; index < links.size(); ++index) {
+        if (expected[index] && !sendAll(links[index].fd, pending[index])) fail(index, "connection lost");
+    }
+
+    char buffer[65536];
+    for (size_t index = 0; index < links.size(); ++index) {
+        Link& link = links[index];
+        while (expected[index]) {
+            size_t used = 0;
+            long length;
+            Frame frame;
+            while ((length = decodeFrame(link.in.data() + used, link.in.size() - used, frame)) > 0) {
+                used += (size_t)length;
+                if (frame.tag >= parts.size() || linkOf[frame.tag] != index || frame.body.empty()) {
+                    length = -1;
+                    break;
+                }
+                Part& part = parts[frame.tag];
+                part.answered = true;
+                part.ok = frame.body[0] == 0;
+                part.text.assign(frame.body.data() + 1, frame.body.size() - 1);
+                --expected[index];
+            }
+            link.in.erase(0, used);
+            if (length < 0) {
+                fail(index, "sent a reply that does not fit");
+                break;
+            }
+            if (!expected[index]) break;
+            ssize_t received = recv(link.fd, buffer, sizeof(buffer), 0);
+            if (received < 0 && errno == EINTR) continue;
+            if (received <= 0) {
+                fail(index, received < 0 && errno == EAGAIN ? "did not answer" : "connection lost");
+                break;
+            }
+            link.in.append(buffer, (size_t)received);
+        }
+    }
+}
+
+size_t Router::facilityNamed(const string& name) const {
+    for (size_t f = 0; f < facilities.size(); ++f) {
+        if (facilities[f].name == name) return f;
+    }
+    return facilities.size();
+}
+
+size_t Router::homeOf(const string& patientId) const {
+    return (size_t)(fnv1a64(patientId.data(), patientId.size()) % facilities.size());
+}
+
+bool Router::locate(const string& patientId, size_t& facility) const {
+    shared_lock<shared_mutex> lock(directoryLock);
+    auto found = directory.find(patientId);
+    if (found == directory.end()) return false;
+    facility = found->second;
+    return true;
+}
+
+void Router::remember(const string& patientId, size_t facility) {
+    lock_guard<shared_mutex> lock(directoryLock);
+    directory[patientId] = (uint32_t)facility;
+}
+
+} // namespace hms
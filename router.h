@@ -0,0 +1,130 @@
+#ifndef HMS_ROUTER_H
+#define HMS_ROUTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace hms {
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Facility router. Each facility of a group runs its own HMS server over
+// its own data directory, optionally with a read replica (see
+// replication.h). The router speaks the server's protocol (see server.h)
+// and passes each command on to the facility it belongs to:
+//
+//   at|FACILITY|COMMAND   to that facility
+//   all|COMMAND           to every facility; OK if every one says OK
+//   patient commands      (BatchRunner::patientCommand) and lookup|ID to
+//                         the facility holding the patient; a new patient
+//                         is registered where the ID hashes to unless
+//                         at| names a facility, and register|ID for an ID
+//                         a facility holds goes there and is refused
+//
+// Any other command must name its facility. Queries across facilities
+// are asked of all of them at once, on their replicas where they have
+// one, and the replies merged:
+//
+//   find|ID            FACILITY|ID|NAME|... as lookup, wherever the patient is
+//   free-beds[|TYPE]   FACILITY|TYPE|FREE per room type with a free bed,
+//                      most free first
+//   rooms              FACILITY|TYPE|TOTAL|OCCUPIED
+//   facilities         NAME|PRIMARY|REPLICA
+//
+// The facility holding a patient is looked up across all of them the
+// first time the router sees the ID and remembered from then on.
+//
+// Each client connection gets a thread and connections of its own to the
+// facilities. Its commands go out in batches of up to MAX_BATCH, each
+// facility receiving its share in order, so commands about one patient
+// keep their order as on a single server.
+// ---------------------------------------------------------------------------
+
+struct Facility {
+    string name;
+    string primary; // server address
+    string replica; // empty when there is none
+};
+
+// Parses NAME=PRIMARY[,REPLICA]
+bool parseFacility(const string& spec, Facility& facility, string& error);
+
+struct RouterStats {
+    uint64_t connections = 0; // accepted so far
+    uint64_t requests = 0;
+    uint64_t failed = 0;      // requests answered with ERROR
+    uint64_t probes = 0;      // patients looked up across facilities to route
+};
+
+class Router {
+public:
+    static const size_t MAX_BATCH = 1024;
+
+    explicit Router(vector<Facility> facilities);
+    ~Router();
+
+    Router(const Router&) = delete;
+    Router& operator=(const Router&) = delete;
+
+    bool listen(const string& address, string& error);
+
+    // Serves until stop(); the clients' last commands are answered first
+    void run();
+
+    // Async-signal-safe
+    void stop();
+
+    RouterStats stats() const;
+
+private:
+    struct Request;
+    struct Part;
+
+    // A client's connection to one facility's primary or replica
+    struct Link {
+        int fd = -1;
+        string in;
+    };
+
+    struct Client {
+        int fd = -1;
+        thread runner;
+        atomic<bool> done{false};
+    };
+
+    vector<Facility> facilities;
+    vector<int> listeners;
+    vector<string> unixPaths;
+    int wakeFd = -1;
+    atomic<bool> stopping{false};
+
+    mutex clientLock;
+    list<unique_ptr<Client>> clients;
+
+    mutable shared_mutex directoryLock;
+    unordered_map<string, uint32_t> directory; // patient ID -> facility
+
+    mutable mutex statsLock;
+    RouterStats counters;
+
+    void serve(Client& client);
+    void answer(vector<Request>& batch, vector<Link>& links, string& out);
+    void exchange(vector<Part>& parts, vector<Link>& links);
+    size_t facilityNamed(const string& name) const; // facilities.size() if none
+    size_t homeOf(const string& patientId) const;   // where a new patient goes
+    bool locate(const string& patientId, size_t& facility) const;
+    void remember(const string& patientId, size_t facility);
+};
+
+} // namespace hms
+
+#endif // HMS_ROUTER_H
@@ -0,0 +1,195 @@
+#include "scheduler.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+namespace hms {
+
+namespace {
+
+// Augmenting-path searches give up after this many slots, so a request
+// that cannot be placed costs bounded time
+const size_t REPAIR_SLOT_LIMIT = 1 << 16;
+
+const uint32_t HOUR_MASK = (1u << HOURS_IN_DAY) - 1;
+
+// The scheduler's view of one staff member: hours open for booking and
+// the number of appointments already held
+struct Candidate {
+    StaffRef member;
+    uint32_t open = 0;
+    int load = 0;
+};
+
+struct Pending {
+    Patient* patient = nullptr;
+    const vector<int>* eligible = nullptr; // candidate indexes
+    uint32_t window = 0;
+    int options = 0;  // open slots inside the window when planning starts
+    int slot = -1;    // candidate * HOURS_IN_DAY + hour, once placed
+};
+
+class Planner {
+public:
+    explicit Planner(Hospital& hospital) : hospital(hospital) {}
+
+    vector<AppointmentOutcome> run(const vector<AppointmentRequest>& requests, time_t when) {
+        vector<AppointmentOutcome> outcomes(requests.size());
+        pending.resize(requests.size());
+        for (size_t r = 0; r < requests.size(); ++r) outcomes[r].status = resolve(requests[r], pending[r]);
+
+        vector<size_t> order;
+        for (size_t r = 0; r < pending.size(); ++r) {
+            if (outcomes[r].status != HmsStatus::Ok) continue;
+            for (int c : *pending[r].eligible) pending[r].options += __builtin_popcount(candidates[c].open & pending[r].window);
+            order.push_back(r);
+        }
+        stable_sort(order.begin(), order.end(),
+                    [&](size_t a, size_t b) { return pending[a].options < pending[b].options; });
+
+        owner.assign(candidates.size() * HOURS_IN_DAY, -1);
+        for (size_t r : order) placeGreedily(r);
+        seenSlot.assign(owner.size(), 0);
+        seenRequest.assign(pending.size(), 0);
+        for (size_t r : order) {
+            if (pending[r].slot < 0) repair(r);
+        }
+
+        for (size_t r = 0; r < pending.size(); ++r) {
+            if (outcomes[r].status != HmsStatus::Ok) continue;
+            if (pending[r].slot < 0) {
+                outcomes[r].status = HmsStatus::SlotUnavailable;
+                continue;
+            }
+            StaffRef member = candidates[pending[r].slot / HOURS_IN_DAY].member;
+            int hour = pending[r].slot % HOURS_IN_DAY;
+            outcomes[r].status = hospital.bookAppointment(*pending[r].patient, member, hour, when);
+            if (outcomes[r].status == HmsStatus::Ok) {
+                outcomes[r].member = member;
+                outcomes[r].hour = hour;
+            }
+        }
+        return outcomes;
+    }
+
+private:
+    Hospital& hospital;
+    vector<Candidate> candidates;
+    unordered_map<int, int> candidateIndex; // by staff ID
+    unordered_map<uint64_t, vector<int>> eligibleLists; // by department symbol and role
+    vector<Pending> pending;
+    vector<int> owner; // request holding each slot, or -1
+    vector<uint32_t> seenSlot, seenRequest;
+    uint32_t search = 0;
+
+    HmsStatus resolve(const AppointmentRequest& request, Pending& entry) {
+        entry.patient = hospital.findPatient(request.patientId);
+        if (!entry.patient) return HmsStatus::NotFound;
+        if (entry.patient->department.empty()) return HmsStatus::NoDepartment;
+        Symbol department = request.department.empty() ? entry.patient->department : request.department;
+        if (department != entry.patient->department) return HmsStatus::InvalidArgument;
+        if (request.role < -1 || request.role >= STAFF_ROLE_COUNT || request.earliestHour < 0 ||
+            request.latestHour >= HOURS_IN_DAY || request.earliestHour > request.latestHour) {
+            return HmsStatus::InvalidArgument;
+        }
+        entry.window = (HOUR_MASK >> (HOURS_IN_DAY - 1 - request.latestHour)) & (HOUR_MASK << request.earliestHour);
+        entry.eligible = &eligible(department, request.role);
+        return HmsStatus::Ok;
+    }
+
+    const vector<int>& eligible(Symbol department, int role) {
+        uint64_t key = (uint64_t)department.id() << 8 | (uint8_t)(role + 1);
+        auto it = eligibleLists.find(key);
+        if (it != eligibleLists.end()) return it->second;
+        vector<StaffRef> members = role < 0 ? hospital.staffInDepartment(department)
+                                            : hospital.staffInDepartment(department, (StaffRole)role);
+        vector<int> indexes;
+        for (StaffRef member : members) indexes.push_back(candidate(member));
+        return eligibleLists.emplace(key, move(indexes)).first->second;
+    }
+
+    int candidate(StaffRef member) {
+        auto it = candidateIndex.find(member.id());
+        if (it != candidateIndex.end()) return it->second;
+        Candidate entry{member};
+        const Timetable& timetable = member.timetable();
+        entry.open = timetable.openHours();
+        for (int hour = 0; hour < HOURS_IN_DAY; ++hour) {
+            if (timetable.state(timetable.slotOf(hour)) == SlotState::Appointment) ++entry.load;
+        }
+        candidates.push_back(entry);
+        return candidateIndex[member.id()] = (int)candidates.size() - 1;
+    }
+
+    void take(size_t request, int slot) {
+        Candidate& c = candidates[slot / HOURS_IN_DAY];
+        c.open &= ~(1u << (slot % HOURS_IN_DAY));
+        ++c.load;
+        owner[slot] = (int)request;
+        pending[request].slot = slot;
+    }
+
+    // Least loaded eligible member with an open hour in the window, earliest
+    // hour; ties keep department order
+    void placeGreedily(size_t request) {
+        const Pending& entry = pending[request];
+        int best = -1;
+        for (int c : *entry.eligible) {
+            if ((candidates[c].open & entry.window) && (best < 0 || candidates[c].load < candidates[best].load)) best = c;
+        }
+        if (best >= 0) take(request, best * HOURS_IN_DAY + __builtin_ctz(candidates[best].open & entry.window));
+    }
+
+    // Breadth-first search for an open slot reachable by moving placed
+    // requests, each to another slot of its own window; shifts the chain
+    // along the path found
+    void repair(size_t start) {
+        ++search;
+        vector<size_t> queue{start};
+        vector<int> cameFrom(1, -1); // queue position of the request whose slot this one gives up
+        seenRequest[start] = search;
+        size_t visited = 0;
+        for (size_t head = 0; head < queue.size() && visited < REPAIR_SLOT_LIMIT; ++head) {
+            const Pending& entry = pending[queue[head]];
+            for (int c : *entry.eligible) {
+                for (uint32_t hours = entry.window; hours; hours &= hours - 1) {
+                    int slot = c * HOURS_IN_DAY + __builtin_ctz(hours);
+                    if (seenSlot[slot] == search) continue;
+                    seenSlot[slot] = search;
+                    ++visited;
+                    if (candidates[c].open & (1u << (slot % HOURS_IN_DAY))) {
+                        shift(queue, cameFrom, head, slot);
+                        return;
+                    }
+                    int holder = owner[slot];
+                    if (holder < 0 || seenRequest[holder] == search) continue; // booked outside this batch
+                    seenRequest[holder] = search;
+                    queue.push_back((size_t)holder);
+                    cameFrom.push_back((int)head);
+                }
+            }
+        }
+    }
+
+    void shift(const vector<size_t>& queue, const vector<int>& cameFrom, size_t position, int freeSlot) {
+        int previous = pending[queue[position]].slot;
+        take(queue[position], freeSlot);
+        while (cameFrom[position] >= 0) {
+            position = (size_t)cameFrom[position];
+            int given = previous;
+            previous = pending[queue[position]].slot;
+            owner[given] = (int)queue[position];
+            pending[queue[position]].slot = given;
+        }
+    }
+};
+
+} // namespace
+
+vector<AppointmentOutcome> scheduleAppointments(Hospital& hospital, const vector<AppointmentRequest>& requests,
+                                                time_t when) {
+    return Planner(hospital).run(requests, when);
+}
+
+} // namespace hms
@@ -0,0 +1,43 @@
+#ifndef HMS_SCHEDULER_H
+#define HMS_SCHEDULER_H
+
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "hospital.h"
+
+namespace hms {
+using namespace std;
+
+// One pending appointment: a patient, the department to see, optionally
+// a role, and the hours (inclusive) the patient can come in
+struct AppointmentRequest {
+    string patientId;
+    Symbol department; // empty: the patient's department
+    int role = -1;     // a StaffRole, or -1 for any role
+    int earliestHour = 0;
+    int latestHour = HOURS_IN_DAY - 1;
+};
+
+struct AppointmentOutcome {
+    HmsStatus status = HmsStatus::SlotUnavailable;
+    StaffRef member;
+    int hour = -1;
+};
+
+// Places a whole queue of requests on the open Work hours of eligible
+// staff and books them through Hospital::bookAppointment, so timetables,
+// patient histories and the log are updated as for single bookings.
+//
+// Requests with the fewest open slots go first, each to the least loaded
+// eligible staff member, earliest hour first. Requests left over are then
+// placed along augmenting paths that move earlier placements to other
+// open slots in their own windows, so the number of bookings is as large
+// as the greedy pass allows to repair. Outcomes are in request order.
+vector<AppointmentOutcome> scheduleAppointments(Hospital& hospital, const vector<AppointmentRequest>& requests,
+                                                time_t when);
+
+} // namespace hms
+
+#endif // HMS_SCHEDULER_H
@@ -0,0 +1,172 @@
+#include "screen.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <iostream>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace hms {
+
+void writeToTerminal(const string& text) {
+    cout.flush();
+    size_t done = 0;
+    while (done < text.size()) {
+        ssize_t written = ::write(STDOUT_FILENO, text.data() + done, text.size() - done);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        done += (size_t)written;
+    }
+}
+
+void Screen::flush() {
+    string text = buffer.str();
+    if (text.empty()) return;
+    writeToTerminal(text);
+    buffer.str(string());
+}
+
+size_t pageRows() {
+    winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0 || size.ws_row == 0) return 20;
+    return max<size_t>(size.ws_row > 8 ? size.ws_row - 8 : 1, 5); // room for the heading and prompt
+}
+
+Pager::Pager(size_t total, size_t rows) : total(total), rows(rows ? rows : 1) {}
+
+size_t Pager::end() const {
+    return min(total, first() + rows);
+}
+
+bool Pager::turn(const string& input) {
+    if (input == "n" || input == "N") {
+        if (page + 1 < pageCount()) ++page;
+        return true;
+    }
+    if (input == "p" || input == "P") {
+        if (page > 0) --page;
+        return true;
+    }
+    return false;
+}
+
+void Pager::footer(ostream& out) const {
+    if (!paged()) return;
+    out << "Page " << page + 1 << " of " << pageCount() << " ('n' next, 'p' previous)\n";
+}
+
+void Pager::resize(size_t newTotal) {
+    total = newTotal;
+    page = min(page, pageCount() - 1);
+}
+
+void LiveView::draw(const string& frame) {
+    vector<string> lines;
+    for (size_t start = 0; start < frame.size();) {
+        size_t end = frame.find('\n', start);
+        if (end == string::npos) end = frame.size();
+        lines.emplace_back(frame, start, end - start);
+        start = end + 1;
+    }
+
+    string update;
+    if (shown.empty()) update = "\033[2J";
+    auto moveTo = [&update](size_t row, size_t column) {
+        update += "\033[" + to_string(row + 1) + ";" + to_string(column + 1) + "H";
+    };
+    for (size_t row = 0; row < lines.size(); ++row) {
+        const string& now = lines[row];
+        const string& before = row < shown.size() ? shown[row] : string();
+        if (row < shown.size() && now == before) continue;
+        size_t prefix = mismatch(now.begin(), now.begin() + min(now.size(), before.size()), before.begin()).first -
+                        now.begin();
+        moveTo(row, prefix);
+        if (now.size() == before.size()) {
+            size_t suffix = 0;
+            while (suffix < now.size() - prefix && now[now.size() - 1 - suffix] == before[before.size() - 1 - suffix]) {
+                ++suffix;
+            }
+            update.append(now, prefix, now.size() - prefix - suffix);
+        } else {
+            update.append(now, prefix, string::npos);
+            if (now.size() < before.size()) update += "\033[K";
+        }
+    }
+    for (size_t row = lines.size(); row < shown.size(); ++row) {
+        moveTo(row, 0);
+        update += "\033[K";
+    }
+    moveTo(lines.size(), 0);
+    shown = move(lines);
+    writeToTerminal(update);
+}
+
+void watch(const function<void(ostream&)>& render, int intervalMs) {
+    LiveView view;
+    ostringstream frame;
+    pollfd input{STDIN_FILENO, POLLIN, 0};
+    while (true) {
+        frame.str(string());
+        render(frame);
+        view.draw(frame.str());
+        int ready = poll(&input, 1, intervalMs);
+        if (ready < 0 && errno != EINTR) break;
+        if (ready > 0) {
+            string line;
+            getline(cin, line);
+            break;
+        }
+    }
+}
+
+string readWithSuggestions(const string& prompt, const function<void(const string&, ostream&)>& suggest) {
+    string text;
+    termios original;
+    if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO) || tcgetattr(STDIN_FILENO, &original) != 0) {
+        cout << prompt;
+        cin >> ws;
+        getline(cin, text);
+        return text;
+    }
+    termios keys = original;
+    keys.c_lflag &= ~(ICANON | ECHO);
+    keys.c_cc[VMIN] = 1;
+    keys.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &keys);
+
+    ostringstream suggestions;
+    while (true) {
+        // the line, then the suggestions below it; the cursor is moved back
+        // relative to where it ends up, which also holds after scrolling
+        suggestions.str(string());
+        suggest(text, suggestions);
+        string below = suggestions.str();
+        size_t rows = 1 + count(below.begin(), below.end(), '\n');
+        size_t column = prompt.size() + text.size();
+        writeToTerminal("\r" + prompt + text + "\033[K\n" + below + "\033[J\033[" + to_string(rows) + "A\r" +
+                        (column ? "\033[" + to_string(column) + "C" : string()));
+
+        char key;
+        if (::read(STDIN_FILENO, &key, 1) != 1) break;
+        if (key == '\n' || key == '\r') break;
+        if (key == 127 || key == '\b') {
+            if (!text.empty()) text.pop_back();
+        } else if (key == 27) {
+            // skip arrow and function key sequences
+            char next;
+            while (::read(STDIN_FILENO, &next, 1) == 1 && !isalpha((unsigned char)next) && next != '~') {}
+        } else if ((unsigned char)key >= 32) {
+            text += key;
+        }
+    }
+    tcsetattr(STDIN_FILENO, TCSANOW, &original);
+    writeToTerminal("\033[J\n");
+    return text;
+}
+
+} // namespace hms
@@ -0,0 +1,94 @@
+#ifndef HMS_SCREEN_H
+#define HMS_SCREEN_H
+
+#include <cstddef>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace hms {
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Terminal output for the console front end. Screens are composed in
+// memory and written with a single write(2), long lists are shown a page
+// at a time, and refreshed views rewrite only the characters that changed.
+// ---------------------------------------------------------------------------
+
+// A screen being composed. Anything that writes to an ostream (the
+// display functions) can render into out(); flush() sends it all at once.
+class Screen {
+public:
+    ~Screen() { flush(); }
+
+    ostream& out() { return buffer; }
+
+    template <class T>
+    Screen& operator<<(const T& value) {
+        buffer << value;
+        return *this;
+    }
+
+    // Writes what was composed to stdout after anything pending in cout
+    void flush();
+
+private:
+    ostringstream buffer;
+};
+
+// Writes all of `text` to stdout, in one call unless the terminal takes less
+void writeToTerminal(const string& text);
+
+// Rows of the terminal left for a list, or 20 when stdout is not one
+size_t pageRows();
+
+// A window of `rows` entries over a list of `total`, moved with 'n' and
+// 'p'. Only the entries from first() to end() need to be formatted.
+class Pager {
+public:
+    explicit Pager(size_t total, size_t rows = pageRows());
+
+    size_t first() const { return page * rows; }
+    size_t end() const;
+    bool paged() const { return total > rows; }
+
+    // Moves the window on 'n' or 'p'; false for any other input
+    bool turn(const string& input);
+
+    // "Page 2 of 5" with the keys, when there is more than one page
+    void footer(ostream& out) const;
+
+    void resize(size_t newTotal);
+
+private:
+    size_t total;
+    size_t rows;
+    size_t page = 0;
+
+    size_t pageCount() const { return total ? (total + rows - 1) / rows : 1; }
+};
+
+// A view drawn over and over in the same place. The first frame clears
+// the screen; later frames rewrite only the changed span of each changed
+// line. Frames are plain text, one character per column.
+class LiveView {
+public:
+    void draw(const string& frame);
+    void reset() { shown.clear(); }
+
+private:
+    vector<string> shown;
+};
+
+// Redraws `render` every `intervalMs` until a line is entered on stdin
+void watch(const function<void(ostream&)>& render, int intervalMs = 1000);
+
+// Reads a line after `prompt`. On a terminal the line is read key by key
+// and suggest(text, out) is drawn under it after every change; otherwise
+// it is read like getline after skipping blank input.
+string readWithSuggestions(const string& prompt, const function<void(const string&, ostream&)>& suggest);
+
+} // namespace hms
+
+#endif // HMS_SCREEN_H
@@ -0,0 +1,662 @@
+#include "server.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace hms {
+
+namespace {
+
+const uint64_t WAKE_ID = 0;
+const uint64_t FIRST_CONNECTION = 1 << 20; // IDs below are listeners
+const size_t MAX_PIPELINE = 4096;          // commands per connection before reading pauses
+const size_t MAX_PENDING_OUTPUT = 4 << 20; // unsent reply bytes before reading pauses
+const int SHIP_INTERVAL_MS = 10;           // how often new log records are looked for
+
+void putU32(string& out, uint32_t value) {
+    char bytes[4];
+    memcpy(bytes, &value, 4);
+    out.append(bytes, 4);
+}
+
+uint32_t getU32(const char* data) {
+    uint32_t value;
+    memcpy(&value, data, 4);
+    return value;
+}
+
+bool fail(string& error, const string& reason) {
+    error = reason + (errno ? string(": ") + strerror(errno) : string());
+    return false;
+}
+
+// Splits an address into a sockaddr; `unixPath` is set for Unix sockets
+bool resolve(const string& address, sockaddr_storage& storage, socklen_t& length, bool passive, string& unixPath,
+             string& error) {
+    errno = 0;
+    if (address.compare(0, 5, "unix:") == 0) {
+        unixPath = address.substr(5);
+        sockaddr_un& local = (sockaddr_un&)storage;
+        if (unixPath.empty() || unixPath.size() >= sizeof(local.sun_path)) return fail(error, "bad socket path " + unixPath);
+        memset(&local, 0, sizeof(local));
+        local.sun_family = AF_UNIX;
+        memcpy(local.sun_path, unixPath.c_str(), unixPath.size() + 1);
+        length = sizeof(local);
+        return true;
+    }
+    size_t colon = address.rfind(':');
+    if (colon == string::npos) return fail(error, "address must be HOST:PORT, :PORT or unix:PATH");
+    string host = address.substr(0, colon), port = address.substr(colon + 1);
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo* found = nullptr;
+    int status = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &found);
+    if (status != 0) {
+        error = address + ": " + gai_strerror(status);
+        return false;
+    }
+    memcpy(&storage, found->ai_addr, found->ai_addrlen);
+    length = found->ai_addrlen;
+    freeaddrinfo(found);
+    return true;
+}
+
+// Replies go out with Nagle off, each batch in as few segments as it takes
+void setNoDelay(int fd) {
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+} // namespace
+
+void encodeRequest(string& out, uint32_t tag, string_view command) {
+    putU32(out, (uint32_t)(4 + command.size()));
+    putU32(out, tag);
+    out.append(command.data(), command.size());
+}
+
+void encodeReply(string& out, uint32_t tag, bool ok, string_view text) {
+    putU32(out, (uint32_t)(5 + text.size()));
+    putU32(out, tag);
+    out.push_back(ok ? 0 : 1);
+    out.append(text.data(), text.size());
+}
+
+long decodeFrame(const char* data, size_t size, Frame& frame) {
+    if (size < 4) return 0;
+    uint32_t length = getU32(data);
+    if (length < 4 || length > MAX_FRAME_BYTES) return -1;
+    if (size - 4 < length) return 0;
+    frame.tag = getU32(data + 4);
+    frame.body = string_view(data + 8, length - 4);
+    return (long)length + 4;
+}
+
+int listenSocket(const string& address, string& error) {
+    sockaddr_storage storage;
+    socklen_t length;
+    string unixPath;
+    if (!resolve(address, storage, length, true, unixPath, error)) return -1;
+    int fd = socket(storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        fail(error, "socket");
+        return -1;
+    }
+    int on = 1;
+    if (unixPath.empty()) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    else unlink(unixPath.c_str()); // left behind by an earlier run
+    if (bind(fd, (sockaddr*)&storage, length) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+        fail(error, "cannot listen on " + address);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int connectSocket(const string& address, string& error) {
+    sockaddr_storage storage;
+    socklen_t length;
+    string unixPath;
+    if (!resolve(address, storage, length, false, unixPath, error)) return -1;
+    int fd = socket(storage.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        fail(error, "socket");
+        return -1;
+    }
+    if (connect(fd, (sockaddr*)&storage, length) < 0) {
+        fail(error, "cannot connect to " + address);
+        close(fd);
+        return -1;
+    }
+    if (unixPath.empty()) setNoDelay(fd);
+    return fd;
+}
+
+// --- Server ------------------------------------------------------------------
+
+Server::Server(Hospital& hospital, unsigned workerCount) : hospital(hospital) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = WAKE_ID;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+    nextConnection = FIRST_CONNECTION;
+
+    workerCount = max(workerCount, 1u);
+    outbox.resize(workerCount);
+    for (unsigned i = 0; i < workerCount; ++i) workers.push_back(make_unique<Worker>());
+    for (auto& worker : workers) {
+        Worker* self = worker.get();
+        worker->runner = thread([this, self] { work(*self); });
+    }
+}
+
+Server::~Server() {
+    shuttingDown.store(true);
+    for (auto& worker : workers) {
+        lock_guard<mutex> lock(worker->lock); // so no worker misses the news between check and wait
+        worker->ready.notify_one();
+    }
+    for (auto& worker : workers) worker->runner.join();
+    while (!connections.empty()) closeConnection(connections.begin()->first);
+    for (int fd : listeners) close(fd);
+    for (const string& path : unixPaths) unlink(path.c_str());
+    close(wakeFd);
+    close(epollFd);
+}
+
+bool Server::listen(const string& address, string& error) {
+    int fd = listenSocket(address, error);
+    if (fd < 0) return false;
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = 1 + listeners.size();
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    listeners.push_back(fd);
+    if (address.compare(0, 5, "unix:") == 0) unixPaths.push_back(address.substr(5));
+    return true;
+}
+
+void Server::stop() {
+    stopping.store(true);
+    uint64_t one = 1;
+    ssize_t ignored = write(wakeFd, &one, sizeof(one));
+    (void)ignored;
+}
+
+ServerStats Server::stats() const {
+    lock_guard<mutex> lock(statsLock);
+    return counters;
+}
+
+void Server::run() {
+    const size_t MAX_EVENTS = 256;
+    epoll_event events[MAX_EVENTS];
+    auto nextCheck = chrono::steady_clock::now() + chrono::seconds(1);
+    chrono::steady_clock::time_point giveUp;
+    bool listening = true;
+    bool shippedAll = false;
+
+    while (true) {
+        if (stopping.load() && listening) {
+            // Stop taking connections and commands; finish the ones read
+            for (int fd : listeners) close(fd);
+            listeners.clear();
+            listening = false;
+            draining = false;
+            flushOutbox();
+            for (auto& entry : connections) updateEvents(entry.first, entry.second);
+            giveUp = chrono::steady_clock::now() + chrono::seconds(2);
+        }
+        if (!listening) {
+            bool done = atWorkers == 0;
+            for (auto& entry : connections) done = done && idle(entry.second);
+            if (done && !followers.empty() && !shippedAll) {
+                // Replicas get every change before the final checkpoint
+                hospital.syncLog();
+                ship(true);
+                shippedAll = true;
+                continue;
+            }
+            if (done || chrono::steady_clock::now() > giveUp) break;
+        }
+
+        int timeout = !listening ? 100 : followers.empty() ? 1000 : SHIP_INTERVAL_MS;
+        int ready = epoll_wait(epollFd, events, MAX_EVENTS, timeout);
+        if (ready < 0 && errno != EINTR) break;
+        for (int i = 0; i < ready; ++i) {
+            uint64_t id = events[i].data.u64;
+            if (id == WAKE_ID) {
+                uint64_t count;
+                ssize_t ignored = read(wakeFd, &count, sizeof(count));
+                (void)ignored;
+                continue;
+            }
+            if (id < FIRST_CONNECTION) {
+                if (listening) accept(listeners[id - 1]);
+                continue;
+            }
+            auto found = connections.find(id);
+            if (found == connections.end()) continue;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                closeConnection(id);
+                continue;
+            }
+            if ((events[i].events & EPOLLOUT) && !writeTo(id, found->second)) continue;
+            if (events[i].events & EPOLLIN) readFrom(id, found->second);
+        }
+        collectReplies();
+        if (!followers.empty()) ship(false);
+
+        auto now = chrono::steady_clock::now();
+        if (listening && now >= nextCheck) {
+            nextCheck = now + chrono::seconds(1);
+            if (hospital.checkpointDue()) draining = true;
+        }
+        if (draining && atWorkers == 0) {
+            checkpoint();
+            draining = false;
+        }
+        flushOutbox();
+    }
+    while (!connections.empty()) closeConnection(connections.begin()->first);
+}
+
+void Server::accept(int listener) {
+    while (true) {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return; // EAGAIN, or out of descriptors until someone leaves
+        }
+        setNoDelay(fd);
+        uint64_t id = nextConnection++;
+        Connection& connection = connections[id];
+        connection.fd = fd;
+        connection.session = make_shared<BatchRunner>(hospital);
+        connection.events = EPOLLIN;
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = id;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+        lock_guard<mutex> lock(statsLock);
+        ++counters.connections;
+    }
+}
+
+void Server::readFrom(uint64_t id, Connection& connection) {
+    char buffer[65536];
+    ssize_t received = recv(connection.fd, buffer, sizeof(buffer), 0);
+    if (received < 0) {
+        if (errno != EAGAIN && errno != EINTR) closeConnection(id);
+        return;
+    }
+    if (received == 0) connection.peerClosed = true;
+    if (connection.shipper) {
+        if (connection.peerClosed) closeConnection(id); // a replica has nothing more to say
+        return;
+    }
+    connection.in.append(buffer, (size_t)received);
+
+    size_t used = 0;
+    Frame frame;
+    string patientId;
+    while (true) {
+        long length = decodeFrame(connection.in.data() + used, connection.in.size() - used, frame);
+        if (length < 0) {
+            closeConnection(id); // not speaking the protocol
+            return;
+        }
+        if (length == 0) break;
+        used += (size_t)length;
+        if (frame.body.compare(0, 10, "replicate|") == 0) {
+            startShipping(connection, frame.tag, string(frame.body.substr(10)));
+            if (connection.shipper) {
+                followers.push_back(id);
+                used = connection.in.size();
+                break;
+            }
+            continue;
+        }
+        Job job;
+        job.connection = id;
+        job.tag = frame.tag;
+        job.command.assign(frame.body.data(), frame.body.size());
+        if (BatchRunner::patientCommand(job.command, patientId) ||
+            (job.command.compare(0, 7, "lookup|") == 0 && (patientId = job.command.substr(7), true))) {
+            job.worker = (unsigned)(hash<string>()(patientId) % workers.size());
+        } else {
+            job.worker = (unsigned)(id % workers.size());
+            job.session = connection.session;
+        }
+        dispatch(connection, move(job));
+    }
+    connection.in.erase(0, used);
+    if (connection.peerClosed && idle(connection)) {
+        closeConnection(id);
+        return;
+    }
+    updateEvents(id, connection);
+}
+
+// Commands about one patient go straight on unless a command that runs
+// alone is pending; that one waits until nothing else is in flight
+void Server::dispatch(Connection& connection, Job&& job) {
+    if (!connection.held.empty() || connection.aloneInFlight || (job.session && connection.inFlight)) {
+        connection.held.push_back(move(job));
+        return;
+    }
+    handOver(connection, move(job));
+}
+
+void Server::release(Connection& connection) {
+    while (!connection.held.empty() && !connection.aloneInFlight) {
+        if (connection.held.front().session && connection.inFlight) return;
+        Job job = move(connection.held.front());
+        connection.held.pop_front();
+        handOver(connection, move(job));
+    }
+}
+
+void Server::handOver(Connection& connection, Job&& job) {
+    ++connection.inFlight;
+    if (job.session) connection.aloneInFlight = true;
+    outbox[job.worker].push_back(move(job));
+}
+
+void Server::flushOutbox() {
+    if (draining) return;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        if (outbox[i].empty()) continue;
+        atWorkers += outbox[i].size();
+        Worker& worker = *workers[i];
+        {
+            lock_guard<mutex> lock(worker.lock);
+            if (worker.queue.empty()) {
+                worker.queue.swap(outbox[i]);
+            } else {
+                for (Job& job : outbox[i]) worker.queue.push_back(move(job));
+                outbox[i].clear();
+            }
+        }
+        worker.ready.notify_one();
+    }
+}
+
+void Server::work(Worker& worker) {
+    BatchRunner runner(hospital);
+    vector<Job> jobs;
+    while (true) {
+        {
+            unique_lock<mutex> lock(worker.lock);
+            worker.ready.wait(lock, [&] { return !worker.queue.empty() || shuttingDown; });
+            if (worker.queue.empty()) return;
+            jobs.swap(worker.queue);
+        }
+        bool changed = false;
+        for (Job& job : jobs) {
+            execute(job.session ? *job.session : runner, job);
+            changed = changed || job.changed;
+        }
+        // Workers syncing at once share one commit of the log
+        if (changed && hospital.syncLog() != HmsStatus::Ok) {
+            for (Job& job : jobs) {
+                if (!job.changed) continue;
+                job.ok = false;
+                job.command = statusMessage(HmsStatus::StorageError);
+            }
+        }
+        bool wake;
+        {
+            lock_guard<mutex> lock(replyLock);
+            wake = replies.empty(); // otherwise the loop has been woken already
+            for (Job& job : jobs) replies.push_back(move(job));
+        }
+        jobs.clear();
+        if (wake) {
+            uint64_t one = 1;
+            ssize_t ignored = write(wakeFd, &one, sizeof(one));
+            (void)ignored;
+        }
+    }
+}
+
+void Server::execute(BatchRunner& runner, Job& job) {
+    string text;
+    if (job.command.compare(0, 7, "lookup|") == 0) {
+        Patient record;
+        job.ok = hospital.readPatient(job.command.substr(7), record);
+        if (job.ok) {
+            text = record.id + "|" + record.name + "|" + to_string(record.age) + "|" + record.department.str() + "|" +
+                   record.reasonForVisit + "|" + (record.hospitalized ? record.roomType.str() : string());
+        } else {
+            text = "unknown patient " + job.command.substr(7);
+        }
+    } else if (job.command == "rooms") {
+        for (const RoomLoad& room : hospital.statusBoard(time(0)).rooms) {
+            if (!text.empty()) text += "\n";
+            text += room.type.str() + "|" + to_string(room.total) + "|" + to_string(room.total - room.free);
+        }
+        job.ok = true;
+    } else if (job.command == "board") {
+        readBoard(text);
+        job.ok = true;
+    } else if (job.command.compare(0, 8, "changes|") == 0 || job.command == "changes") {
+        job.ok = readChanges(job.command, text);
+    } else if (job.command == "position") {
+        text = to_string(hospital.logPosition());
+        job.ok = true;
+    } else if (job.command.empty()) {
+        text = "empty command";
+    } else if (readOnly) {
+        text = "read-only replica; send changes to the primary";
+    } else {
+        job.ok = job.changed = runner.execute(job.command, text);
+        if (job.ok) text.clear();
+    }
+    job.command = move(text);
+}
+
+// board: the totals, then a line per department with its hours
+void Server::readBoard(string& text) {
+    StatusView view = hospital.statusBoard(time(0));
+    text = to_string(view.freeBeds) + "|" + to_string(view.admitted);
+    for (int count : view.discharges) text += "|" + to_string(count);
+    for (const DepartmentLoad& load : view.departments) {
+        text += "\n" + load.department.str() + "|" + to_string(load.admitted);
+        for (const auto* hours : {&load.openSlots, &load.bookedSlots}) {
+            text += "|";
+            for (int hour = 0; hour < HOURS_IN_DAY; ++hour) {
+                if (hour > 0) text += ",";
+                text += to_string((*hours)[hour]);
+            }
+        }
+    }
+}
+
+// changes|FROM|MAX: the next sequence to ask for, then the events from FROM
+// on, as many as fit in a reply
+bool Server::readChanges(const string& command, string& text) {
+    vector<string> fields;
+    BatchRunner::split(command, fields);
+    uint64_t from = fields.size() > 1 ? strtoull(fields[1].c_str(), nullptr, 10) : 0;
+    size_t limit = fields.size() > 2 && !fields[2].empty() ? strtoul(fields[2].c_str(), nullptr, 10) : 1024;
+    ChangeSubscription subscription(hospital.changes(), from);
+    vector<ChangeEvent> events;
+    if (!subscription.poll(events, min<size_t>(limit, 4096))) {
+        text = "lost events before " + to_string(subscription.next());
+        return false;
+    }
+    uint64_t next = subscription.next();
+    string lines;
+    for (const ChangeEvent& event : events) {
+        string line = formatChange(event);
+        if (lines.size() + line.size() + 32 >= MAX_FRAME_BYTES) {
+            next = event.sequence;
+            break;
+        }
+        lines += "\n" + line;
+    }
+    text = to_string(next) + lines;
+    return true;
+}
+
+void Server::collectReplies() {
+    vector<Job> arrived;
+    {
+        lock_guard<mutex> lock(replyLock);
+        if (replies.empty()) return;
+        arrived.swap(replies);
+    }
+    atWorkers -= arrived.size();
+    uint64_t failed = 0;
+    vector<uint64_t> touched;
+    for (Job& job : arrived) {
+        failed += !job.ok;
+        auto found = connections.find(job.connection);
+        if (found == connections.end()) continue; // it hung up meanwhile
+        Connection& connection = found->second;
+        --connection.inFlight;
+        if (job.session) connection.aloneInFlight = false;
+        if (connection.written == connection.out.size()) touched.push_back(job.connection);
+        encodeReply(connection.out, job.tag, job.ok, job.command);
+        release(connection);
+    }
+    {
+        lock_guard<mutex> lock(statsLock);
+        counters.requests += arrived.size();
+        counters.failed += failed;
+    }
+    for (uint64_t id : touched) {
+        auto found = connections.find(id);
+        if (found != connections.end()) writeTo(id, found->second);
+    }
+}
+
+bool Server::writeTo(uint64_t id, Connection& connection) {
+    while (connection.written < connection.out.size()) {
+        ssize_t sent = send(connection.fd, connection.out.data() + connection.written,
+                            connection.out.size() - connection.written, MSG_NOSIGNAL);
+        if (sent > 0) {
+            connection.written += (size_t)sent;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN) {
+            break;
+        } else {
+            closeConnection(id);
+            return false;
+        }
+    }
+    if (connection.written == connection.out.size()) {
+        connection.out.clear();
+        connection.written = 0;
+    }
+    if (connection.peerClosed && idle(connection)) {
+        closeConnection(id);
+        return false;
+    }
+    updateEvents(id, connection);
+    return true;
+}
+
+bool Server::idle(const Connection& connection) const {
+    return connection.inFlight == 0 && connection.held.empty() && connection.written == connection.out.size();
+}
+
+// Reading pauses while a connection has too much in flight or unsent
+void Server::updateEvents(uint64_t id, Connection& connection) {
+    bool backlog = connection.inFlight + connection.held.size() >= MAX_PIPELINE ||
+                   connection.out.size() - connection.written >= MAX_PENDING_OUTPUT;
+    uint32_t wanted = 0;
+    if (!connection.peerClosed && !stopping.load(memory_order_relaxed) && !backlog) wanted |= EPOLLIN;
+    if (connection.written < connection.out.size()) wanted |= EPOLLOUT;
+    if (wanted == connection.events) return;
+    epoll_event event{};
+    event.events = wanted;
+    event.data.u64 = id;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+    connection.events = wanted;
+}
+
+void Server::closeConnection(uint64_t id) {
+    auto found = connections.find(id);
+    if (found == connections.end()) return;
+    close(found->second.fd); // also leaves the epoll set
+    connections.erase(found);
+}
+
+// The reply goes out first, then the snapshot when the replica needs it
+void Server::startShipping(Connection& connection, uint32_t tag, const string& from) {
+    string snapshot, error;
+    auto shipper = make_unique<LogShipper>(hospital.dataDirectory());
+    if (hospital.dataDirectory().empty()) {
+        error = "not a primary";
+    } else if (connection.inFlight || !connection.held.empty()) {
+        error = "replicate must be the connection's first command";
+    } else {
+        hospital.syncLog();
+        if (shipper->start(strtoull(from.c_str(), nullptr, 10), hospital.logPosition(), snapshot, error)) {
+            encodeReply(connection.out, tag, true, snapshot.empty() ? "log" : "snapshot");
+            if (!snapshot.empty()) {
+                uint64_t size = snapshot.size();
+                connection.out.append((const char*)&size, 8);
+                connection.out.append(snapshot);
+            }
+            connection.shipper = move(shipper);
+            return;
+        }
+    }
+    encodeReply(connection.out, tag, false, error);
+}
+
+// Appends the records written since the last turn to each replica's
+// output, holding back from replicas that have too much unsent
+void Server::ship(bool everything) {
+    for (size_t i = 0; i < followers.size();) {
+        uint64_t id = followers[i];
+        auto found = connections.find(id);
+        if (found == connections.end()) {
+            followers[i] = followers.back();
+            followers.pop_back();
+            continue;
+        }
+        ++i;
+        Connection& connection = found->second;
+        size_t unsent = connection.out.size() - connection.written;
+        if (!everything && unsent >= MAX_PENDING_OUTPUT) continue;
+        size_t limit = everything ? SIZE_MAX : MAX_PENDING_OUTPUT - unsent;
+        if (connection.shipper->ship(connection.out, limit) && unsent == 0) writeTo(id, connection);
+    }
+}
+
+// Replicas are brought up to date first: the log file starts over after it
+void Server::checkpoint() {
+    hospital.syncLog();
+    ship(true);
+    HmsStatus status = hospital.checkpoint();
+    for (uint64_t id : followers) {
+        auto found = connections.find(id);
+        if (found != connections.end()) found->second.shipper->rewind();
+    }
+    if (status != HmsStatus::Ok) return;
+    lock_guard<mutex> lock(statsLock);
+    ++counters.checkpoints;
+}
+
+} // namespace hms
@@ -0,0 +1,192 @@
+#ifndef HMS_SERVER_H
+#define HMS_SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "batch.h"
+#include "hospital.h"
+#include "replication.h"
+
+namespace hms {
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Network service. Clients send batch commands (see batch.h) over TCP or a
+// Unix socket and may send many before reading a reply. Frames are
+// little-endian, `length` counting the bytes after it:
+//
+//   request   u32 length | u32 tag | command
+//   reply     u32 length | u32 tag | u8 status | text
+//
+// The tag is the client's own and comes back on the reply. Status is 0 for
+// OK, with the query's result as text, or 1 for ERROR with the reason.
+// Besides the batch commands the service answers five queries:
+//
+//   lookup|ID          ID|NAME|AGE|DEPARTMENT|REASON|ROOM TYPE (empty if not admitted)
+//   rooms              TYPE|TOTAL|OCCUPIED, one line per room type
+//   changes|FROM|MAX   the sequence to ask for next, then up to MAX (1024)
+//                      change events from FROM on, one per line (see
+//                      formatChange); FROM 0 starts at the next change.
+//                      ERROR "lost events before N" once FROM has been
+//                      overwritten, and N is the oldest still held.
+//   position           the last log record written (applied, on a replica)
+//   board              FREE BEDS|ADMITTED|DISCHARGES today and each of the
+//                      six days before, then per department (the empty
+//                      name for patients with none) NAME|ADMITTED|OPEN|BOOKED
+//                      with OPEN and BOOKED comma-separated by hour
+//
+// `replicate|LSN` turns the connection over to log shipping (see
+// replication.h); a replica's own server answers only the queries.
+//
+// One thread runs an epoll loop that accepts, reads and writes without
+// blocking; a pool of workers executes the commands. Commands that act on
+// one patient (and lookup) go to the worker picked by patient ID, so each
+// patient's commands keep their order while replies about different
+// patients may overtake each other. Any other command waits for the
+// connection's earlier commands and holds back its later ones, as in a
+// batch run with several desks. Appointment requests queued with `request`
+// belong to the connection that sent them. A worker replies to the
+// commands it ran only once their changes are in the log file, with one
+// sync for all of them; if the log cannot be written they fail with
+// "storage error".
+// ---------------------------------------------------------------------------
+
+const uint32_t MAX_FRAME_BYTES = 1 << 16;
+
+// Appends one frame to `out`
+void encodeRequest(string& out, uint32_t tag, string_view command);
+void encodeReply(string& out, uint32_t tag, bool ok, string_view text);
+
+struct Frame {
+    uint32_t tag = 0;
+    string_view body; // the command, or the status byte and text
+};
+
+// Reads the frame at the front of [data, data + size): the bytes it takes,
+// 0 while it is incomplete, or -1 if it is malformed or too long
+long decodeFrame(const char* data, size_t size, Frame& frame);
+
+// Addresses are "HOST:PORT" or ":PORT" for TCP (any host when omitted) and
+// "unix:PATH" for a Unix socket. Both return a socket, or -1 with `error`
+// set; the listening one is non-blocking.
+int listenSocket(const string& address, string& error);
+int connectSocket(const string& address, string& error);
+
+struct ServerStats {
+    uint64_t connections = 0; // accepted so far
+    uint64_t requests = 0;
+    uint64_t failed = 0;      // requests answered with ERROR
+    uint64_t checkpoints = 0;
+};
+
+class Server {
+public:
+    Server(Hospital& hospital, unsigned workers);
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    bool listen(const string& address, string& error);
+
+    // Refuses everything but the queries, for a replica
+    void setReadOnly(bool refuse) { readOnly = refuse; }
+
+    // Serves until stop(), writing a checkpoint whenever one is due. Before
+    // returning it finishes the commands it has read and sends their replies.
+    void run();
+
+    // Async-signal-safe
+    void stop();
+
+    ServerStats stats() const;
+
+private:
+    // A command on its way to a worker, or its reply on the way back
+    struct Job {
+        uint64_t connection = 0;
+        uint32_t tag = 0;
+        unsigned worker = 0;
+        string command;                  // becomes the reply text
+        shared_ptr<BatchRunner> session; // set for commands that run alone
+        bool ok = false;
+        bool changed = false;            // a batch command that succeeded
+    };
+
+    struct Worker {
+        mutex lock;
+        condition_variable ready;
+        vector<Job> queue;
+        thread runner;
+    };
+
+    struct Connection {
+        int fd = -1;
+        string in;
+        string out;
+        size_t written = 0;          // bytes of `out` already sent
+        deque<Job> held;             // behind a command that runs alone
+        size_t inFlight = 0;         // with the workers
+        bool aloneInFlight = false;  // one of them runs alone
+        bool peerClosed = false;
+        uint32_t events = 0;         // registered with epoll
+        shared_ptr<BatchRunner> session;
+        unique_ptr<LogShipper> shipper; // set once it serves a replica
+    };
+
+    Hospital& hospital;
+    vector<unique_ptr<Worker>> workers;
+    vector<vector<Job>> outbox; // per worker, handed over once per loop turn
+    vector<int> listeners;
+    vector<string> unixPaths;  // removed again on exit
+    unordered_map<uint64_t, Connection> connections;
+    uint64_t nextConnection = 1;
+    size_t atWorkers = 0;       // handed over and not answered yet
+    bool draining = false;      // holding jobs back until a checkpoint can run
+    bool readOnly = false;
+    vector<uint64_t> followers; // connections serving replicas
+    int epollFd = -1;
+    int wakeFd = -1;            // eventfd: replies are waiting or stop() was called
+
+    mutex replyLock;
+    vector<Job> replies;
+
+    atomic<bool> stopping{false};
+    atomic<bool> shuttingDown{false}; // workers are told to exit
+    ServerStats counters;
+    mutable mutex statsLock;
+
+    void work(Worker& worker);
+    void execute(BatchRunner& runner, Job& job);
+    bool readChanges(const string& command, string& text);
+    void readBoard(string& text);
+    void accept(int listener);
+    void readFrom(uint64_t id, Connection& connection);
+    void dispatch(Connection& connection, Job&& job);
+    void release(Connection& connection);
+    void collectReplies();
+    void flushOutbox();
+    void handOver(Connection& connection, Job&& job);
+    bool writeTo(uint64_t id, Connection& connection); // false once the connection is gone
+    bool idle(const Connection& connection) const;
+    void updateEvents(uint64_t id, Connection& connection);
+    void closeConnection(uint64_t id);
+    void startShipping(Connection& connection, uint32_t tag, const string& from);
+    void ship(bool everything);
+    void checkpoint();
+};
+
+} // namespace hms
+
+#endif // HMS_SERVER_H
@@ -0,0 +1,184 @@
+#ifndef HMS_STAFF_H
+#define HMS_STAFF_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "calendar.h"
+#include "symbols.h"
+#include "timetable.h"
+
+namespace hms {
+using namespace std;
+
+enum class StaffRole : uint8_t { Doctor = 0, Nurse = 1, Technician = 2 };
+const int STAFF_ROLE_COUNT = 3;
+
+// Role label shown in listings
+inline const char* roleName(StaffRole role) {
+    switch (role) {
+    case StaffRole::Doctor: return "Doctor";
+    case StaffRole::Nurse: return "Nurse";
+    case StaffRole::Technician: return "Technician";
+    }
+    return "Staff";
+}
+
+// A member before hiring. Hospital::hireStaff moves the fields into the
+// directory's columns.
+struct Staff {
+    string name;
+    Symbol department;
+    Timetable timetable;
+
+    // Constructor to initialize the timetable with "Free"
+    Staff(int days = 1, int slotsPerHour = 1) : timetable(days, slotsPerHour) {}
+};
+
+class StaffDirectory;
+
+// Handle to a hired member: the directory and the member's row, which is
+// its hiring order. Rows are never reused, so a handle stays valid for the
+// life of the directory; the references it hands out last until the next
+// hire. A default handle refers to nobody.
+class StaffRef {
+public:
+    StaffRef() = default;
+    StaffRef(StaffDirectory& directory, uint32_t row) : directory(&directory), row(row) {}
+
+    explicit operator bool() const { return directory != nullptr; }
+
+    int id() const { return (int)row; }
+    const string& name() const;
+    Symbol department() const;
+    StaffRole role() const;
+    Timetable& timetable() const;
+    Calendar& calendar() const;
+
+    friend bool operator==(StaffRef a, StaffRef b) { return a.directory == b.directory && a.row == b.row; }
+    friend bool operator!=(StaffRef a, StaffRef b) { return !(a == b); }
+
+private:
+    StaffDirectory* directory = nullptr;
+    uint32_t row = 0;
+};
+
+// Owns all staff members as columns indexed by row: names, departments,
+// roles, timetables and calendars each in one array, so listing every member or the
+// doctors of a department reads them front to back. Departments keep the
+// rows of their members by symbol ID and role.
+class StaffDirectory {
+public:
+    StaffRef add(StaffRole role, Staff&& member) {
+        uint32_t row = (uint32_t)nameColumn.size();
+        nameColumn.push_back(move(member.name));
+        departmentColumn.push_back(member.department);
+        roleColumn.push_back(role);
+        timetableColumn.push_back(move(member.timetable));
+        calendarColumn.emplace_back();
+        byName.emplace(nameColumn.back(), row);
+        link(row);
+        return StaffRef(*this, row);
+    }
+
+    // Moves a member to another department, keeping the indexes in sync
+    void reassign(StaffRef member, Symbol department) {
+        uint32_t row = (uint32_t)member.id();
+        unlink(row);
+        departmentColumn[row] = department;
+        link(row);
+    }
+
+    // Rows of one role in a department, in hiring order
+    const vector<uint32_t>& rowsIn(Symbol department, StaffRole role) const {
+        static const vector<uint32_t> none;
+        if (department.empty() || department.id() >= members.size()) return none;
+        return members[department.id()][(int)role];
+    }
+
+    vector<StaffRef> inDepartment(Symbol department, StaffRole role) {
+        const vector<uint32_t>& rows = rowsIn(department, role);
+        vector<StaffRef> result;
+        result.reserve(rows.size());
+        for (uint32_t row : rows) result.emplace_back(*this, row);
+        return result;
+    }
+
+    // All roles of one department: doctors, then nurses, then technicians
+    vector<StaffRef> inDepartment(Symbol department) {
+        size_t count = 0;
+        for (int role = 0; role < STAFF_ROLE_COUNT; ++role) count += rowsIn(department, (StaffRole)role).size();
+        vector<StaffRef> result;
+        result.reserve(count);
+        for (int role = 0; role < STAFF_ROLE_COUNT; ++role) {
+            for (uint32_t row : rowsIn(department, (StaffRole)role)) result.emplace_back(*this, row);
+        }
+        return result;
+    }
+
+    StaffRef member(size_t row) { return row < size() ? StaffRef(*this, (uint32_t)row) : StaffRef(); }
+
+    // First member hired under this name, or a null handle
+    StaffRef findByName(const string& name) {
+        auto it = byName.find(name);
+        return it == byName.end() ? StaffRef() : StaffRef(*this, it->second);
+    }
+
+    // Columns in hiring order
+    const vector<string>& names() const { return nameColumn; }
+    const vector<Symbol>& departments() const { return departmentColumn; }
+    const vector<StaffRole>& roles() const { return roleColumn; }
+    const vector<Timetable>& timetables() const { return timetableColumn; }
+    Timetable& timetable(size_t row) { return timetableColumn[row]; }
+    const vector<Calendar>& calendars() const { return calendarColumn; }
+    Calendar& calendar(size_t row) { return calendarColumn[row]; }
+
+    size_t size() const { return nameColumn.size(); }
+    bool empty() const { return nameColumn.empty(); }
+
+private:
+    vector<string> nameColumn;
+    vector<Symbol> departmentColumn;
+    vector<StaffRole> roleColumn;
+    vector<Timetable> timetableColumn;
+    vector<Calendar> calendarColumn;
+    unordered_map<string, uint32_t> byName;
+    vector<array<vector<uint32_t>, STAFF_ROLE_COUNT>> members; // rows by department symbol ID, role
+
+    void link(uint32_t row) {
+        Symbol department = departmentColumn[row];
+        if (department.empty()) return;
+        if (department.id() >= members.size()) members.resize(department.id() + 1);
+        members[department.id()][(int)roleColumn[row]].push_back(row);
+    }
+
+    void unlink(uint32_t row) {
+        Symbol department = departmentColumn[row];
+        if (department.empty()) return;
+        auto& list = members[department.id()][(int)roleColumn[row]];
+        list.erase(remove(list.begin(), list.end(), row), list.end());
+    }
+};
+
+inline const string& StaffRef::name() const { return directory->names()[row]; }
+inline Symbol StaffRef::department() const { return directory->departments()[row]; }
+inline StaffRole StaffRef::role() const { return directory->roles()[row]; }
+inline Timetable& StaffRef::timetable() const { return directory->timetable(row); }
+inline Calendar& StaffRef::calendar() const { return directory->calendar(row); }
+
+// Staff from the list with an open working slot in the given hour
+inline vector<StaffRef> staffAvailableAt(const vector<StaffRef>& staff, int hour, int day = 0) {
+    vector<StaffRef> available;
+    for (StaffRef member : staff) {
+        if (member.timetable().isAvailable(hour, day)) available.push_back(member);
+    }
+    return available;
+}
+
+} // namespace hms
+
+#endif // HMS_STAFF_H
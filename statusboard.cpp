@@ -0,0 +1,111 @@
+#include "statusboard.h"
+
+namespace hms {
+
+StatusBoard::StatusBoard()
+    : chunks(new atomic<Row*>[MAX_CHUNKS]()), days(new atomic<uint64_t>[DISCHARGE_DAYS]()) {}
+
+StatusBoard::~StatusBoard() {
+    for (size_t i = 0; i < MAX_CHUNKS; ++i) delete[] chunks[i].load(memory_order_relaxed);
+}
+
+void StatusBoard::clear() {
+    for (size_t i = 0; i < MAX_CHUNKS; ++i) {
+        Row* chunk = chunks[i].load(memory_order_relaxed);
+        for (size_t n = 0; chunk && n < CHUNK_SIZE; ++n) {
+            chunk[n].admitted.store(0, memory_order_relaxed);
+            for (auto& count : chunk[n].open) count.store(0, memory_order_relaxed);
+            for (auto& count : chunk[n].booked) count.store(0, memory_order_relaxed);
+        }
+    }
+    for (size_t i = 0; i < DISCHARGE_DAYS; ++i) days[i].store(0, memory_order_relaxed);
+    free.store(0, memory_order_relaxed);
+    inBeds.store(0, memory_order_relaxed);
+}
+
+// Two threads may race to add a chunk; the loser frees its own
+StatusBoard::Row& StatusBoard::row(Symbol department) {
+    atomic<Row*>& slot = chunks[department.id() >> CHUNK_BITS];
+    Row* chunk = slot.load(memory_order_acquire);
+    if (!chunk) {
+        Row* fresh = new Row[CHUNK_SIZE];
+        if (slot.compare_exchange_strong(chunk, fresh, memory_order_acq_rel, memory_order_acquire)) {
+            chunk = fresh;
+        } else {
+            delete[] fresh;
+        }
+    }
+    return chunk[department.id() & (CHUNK_SIZE - 1)];
+}
+
+const StatusBoard::Row* StatusBoard::find(Symbol department) const {
+    const Row* chunk = chunks[department.id() >> CHUNK_BITS].load(memory_order_acquire);
+    return chunk ? &chunk[department.id() & (CHUNK_SIZE - 1)] : nullptr;
+}
+
+void StatusBoard::admitted(Symbol department, int change) {
+    row(department).admitted.fetch_add(change, memory_order_relaxed);
+    inBeds.fetch_add(change, memory_order_relaxed);
+}
+
+void StatusBoard::countHours(Symbol department, const Timetable& timetable, int sign, int first, int last) {
+    Row& counts = row(department);
+    for (int hour = max(first, 0); hour <= min(last, HOURS_IN_DAY - 1); ++hour) {
+        if (timetable.isAvailable(hour)) {
+            counts.open[hour].fetch_add(sign, memory_order_relaxed);
+        } else if (timetable.state(timetable.slotOf(hour)) == SlotState::Appointment) {
+            counts.booked[hour].fetch_add(sign, memory_order_relaxed);
+        }
+    }
+}
+
+void StatusBoard::booked(Symbol department, int hour) {
+    if (hour < 0 || hour >= HOURS_IN_DAY) return;
+    Row& counts = row(department);
+    counts.open[hour].fetch_sub(1, memory_order_relaxed);
+    counts.booked[hour].fetch_add(1, memory_order_relaxed);
+}
+
+void StatusBoard::released(Symbol department, int hour) {
+    if (hour < 0 || hour >= HOURS_IN_DAY) return;
+    Row& counts = row(department);
+    counts.open[hour].fetch_add(1, memory_order_relaxed);
+    counts.booked[hour].fetch_sub(1, memory_order_relaxed);
+}
+
+void StatusBoard::discharged(int64_t day) {
+    if (day < 0 || day > UINT32_MAX) return;
+    atomic<uint64_t>& slot = days[(size_t)day % DISCHARGE_DAYS];
+    uint64_t seen = slot.load(memory_order_relaxed), next;
+    do {
+        uint64_t held = seen >> 32;
+        if (held > (uint64_t)day) return; // older than the window
+        next = held == (uint64_t)day ? seen + 1 : (uint64_t)day << 32 | 1;
+    } while (!slot.compare_exchange_weak(seen, next, memory_order_relaxed));
+}
+
+int StatusBoard::admitted(Symbol department) const {
+    const Row* counts = find(department);
+    return counts ? counts->admitted.load(memory_order_relaxed) : 0;
+}
+
+DepartmentLoad StatusBoard::department(Symbol department) const {
+    DepartmentLoad load;
+    load.department = department;
+    if (const Row* counts = find(department)) {
+        load.admitted = counts->admitted.load(memory_order_relaxed);
+        for (int hour = 0; hour < HOURS_IN_DAY; ++hour) {
+            load.openSlots[hour] = counts->open[hour].load(memory_order_relaxed);
+            load.bookedSlots[hour] = counts->booked[hour].load(memory_order_relaxed);
+        }
+    }
+    return load;
+}
+
+int StatusBoard::discharges(int64_t day) const {
+    if (day < 0 || day > UINT32_MAX) return 0;
+    uint64_t seen = days[(size_t)day % DISCHARGE_DAYS].load(memory_order_relaxed);
+    return seen >> 32 == (uint64_t)day ? (int)(uint32_t)seen : 0;
+}
+
+} // namespace hms
@@ -0,0 +1,107 @@
+#ifndef HMS_STATUSBOARD_H
+#define HMS_STATUSBOARD_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "symbols.h"
+#include "timetable.h"
+
+namespace hms {
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Status board. Running totals the Hospital adjusts with each change it
+// makes, so the board is read in constant time however many patients and
+// staff there are:
+//
+//   free beds          over all room types (each Room counts its own)
+//   admitted patients  by the patient's department
+//   open and booked    timetable hours, by the member's department and hour
+//   discharges         by civil day, for the last DISCHARGE_DAYS days
+//
+// Every counter is an atomic changed in O(1) and read without a lock.
+// Departments are rows indexed by symbol ID, allocated a chunk at a time
+// the first time a department is counted, as SymbolTable keeps names.
+// ---------------------------------------------------------------------------
+
+struct RoomLoad {
+    Symbol type;
+    int total = 0;
+    int free = 0;
+};
+
+struct DepartmentLoad {
+    Symbol department;
+    int admitted = 0;
+    array<int, HOURS_IN_DAY> openSlots{};   // Work hours nobody has booked
+    array<int, HOURS_IN_DAY> bookedSlots{}; // Appointment hours
+};
+
+// What the status board views show, read by Hospital::statusBoard
+struct StatusView {
+    int freeBeds = 0;
+    int admitted = 0;
+    array<int, 7> discharges{};         // today first, then each day before
+    vector<RoomLoad> rooms;             // in room order
+    vector<DepartmentLoad> departments; // as configured, then "no department"
+};
+
+class StatusBoard {
+public:
+    static const size_t DISCHARGE_DAYS = 512;
+
+    StatusBoard();
+    ~StatusBoard();
+
+    StatusBoard(const StatusBoard&) = delete;
+    StatusBoard& operator=(const StatusBoard&) = delete;
+
+    // Zeroes every counter; must not run alongside the others
+    void clear();
+
+    void bedsFreed(int change) { free.fetch_add(change, memory_order_relaxed); }
+    void admitted(Symbol department, int change);
+    // Adds the open and booked hours [first, last] of a timetable, or with
+    // sign -1 takes them away, around a change to those hours
+    void countHours(Symbol department, const Timetable& timetable, int sign, int first = 0,
+                    int last = HOURS_IN_DAY - 1);
+    void booked(Symbol department, int hour);   // an open hour was booked
+    void released(Symbol department, int hour); // a booked hour is open again
+    void discharged(int64_t day);             // civil day, see calendar.h
+
+    int freeBeds() const { return free.load(memory_order_relaxed); }
+    int admitted() const { return inBeds.load(memory_order_relaxed); } // all departments
+    int admitted(Symbol department) const;
+    DepartmentLoad department(Symbol department) const;
+    int discharges(int64_t day) const; // 0 once the day is out of the window
+
+private:
+    static const unsigned CHUNK_BITS = 8;
+    static const size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+    static const size_t MAX_CHUNKS = (size_t(1) << 22) / CHUNK_SIZE; // as many as symbols
+
+    struct Row {
+        atomic<int32_t> admitted{0};
+        array<atomic<int32_t>, HOURS_IN_DAY> open{};
+        array<atomic<int32_t>, HOURS_IN_DAY> booked{};
+    };
+
+    unique_ptr<atomic<Row*>[]> chunks;
+    // Day slots hold day << 32 | count; a slot is taken over by the first
+    // discharge of a later day
+    unique_ptr<atomic<uint64_t>[]> days;
+    atomic<int32_t> free{0};
+    atomic<int32_t> inBeds{0};
+
+    Row& row(Symbol department);
+    const Row* find(Symbol department) const; // null if never counted
+};
+
+} // namespace hms
+
+#endif // HMS_STATUSBOARD_H
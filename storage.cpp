@@ -0,0 +1,234 @@
+#include "storage.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace hms {
+
+bool readWholeFile(const string& path, string& contents) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        return false;
+    }
+    contents.resize((size_t)info.st_size);
+    size_t got = 0;
+    while (got < contents.size()) {
+        ssize_t n = ::read(fd, &contents[got], contents.size() - got);
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    ::close(fd);
+    contents.resize(got);
+    return true;
+}
+
+bool writeWholeBuffer(int fd, const char* data, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t n = ::write(fd, data + written, size - written);
+        if (n <= 0) return false;
+        written += (size_t)n;
+    }
+    return true;
+}
+
+// --- Journal ---------------------------------------------------------------
+
+bool Journal::open(const string& path, uint64_t lsn) {
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) return false;
+    if (lseek(fd, 0, SEEK_END) == 0) {
+        if (::write(fd, MAGIC, HEADER_SIZE) != (ssize_t)HEADER_SIZE) return false;
+        fdatasync(fd);
+    }
+    nextLsn = lsn + 1;
+    durableLsn = lsn;
+    stopping = false;
+    flusher = thread(&Journal::flushLoop, this);
+    return true;
+}
+
+uint64_t Journal::append(LogOp op, const string& payload) {
+    lock_guard<mutex> lock(guard);
+    uint64_t lsn = nextLsn++;
+    BinaryWriter body;
+    body.u64(lsn);
+    body.u8((uint8_t)op);
+    body.bytes.append(payload);
+    BinaryWriter frame;
+    frame.u32((uint32_t)body.bytes.size());
+    frame.u32(crc32(body.bytes.data(), body.bytes.size()));
+    bool startsBatch = pending.empty();
+    pending.append(frame.bytes);
+    pending.append(body.bytes);
+    ++recordsSinceCheckpoint;
+    if (startsBatch || pending.size() >= batchBytes) wake.notify_one();
+    return lsn;
+}
+
+bool Journal::sync() {
+    unique_lock<mutex> lock(guard);
+    uint64_t target = nextLsn - 1;
+    syncRequested = true;
+    wake.notify_one();
+    synced.wait(lock, [&] { return durableLsn >= target || fd < 0 || failure != 0; });
+    return durableLsn >= target;
+}
+
+void Journal::truncate() {
+    if (!sync()) return;
+    lock_guard<mutex> lock(guard);
+    if (ftruncate(fd, HEADER_SIZE) == 0) fdatasync(fd);
+    recordsSinceCheckpoint = 0;
+}
+
+uint64_t Journal::lastLsn() {
+    lock_guard<mutex> lock(guard);
+    return nextLsn - 1;
+}
+
+size_t Journal::recordsSinceSnapshot() {
+    lock_guard<mutex> lock(guard);
+    return recordsSinceCheckpoint;
+}
+
+void Journal::close() {
+    if (fd < 0) return;
+    {
+        lock_guard<mutex> lock(guard);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (flusher.joinable()) flusher.join();
+    ::close(fd);
+    fd = -1;
+    synced.notify_all();
+}
+
+void Journal::flushLoop() {
+    unique_lock<mutex> lock(guard);
+    while (true) {
+        wake.wait(lock, [&] { return stopping || !pending.empty(); });
+        // Let the batch fill up for one commit interval unless it is
+        // already large or someone is waiting on it
+        wake.wait_for(lock, commitInterval, [&] {
+            return stopping || syncRequested || pending.size() >= batchBytes;
+        });
+        syncRequested = false;
+        if (!pending.empty()) {
+            string batch;
+            batch.swap(pending);
+            uint64_t batchLsn = nextLsn - 1;
+            // After a failure the file may end in a torn record, where
+            // replay stops, so later batches are dropped
+            bool write = failure == 0;
+            lock.unlock();
+            bool ok = write && writeWholeBuffer(fd, batch.data(), batch.size()) && fdatasync(fd) == 0;
+            int code = errno;
+            if (write && !ok) perror("hms.wal");
+            lock.lock();
+            if (ok) durableLsn = batchLsn;
+            else if (failure == 0) failure = code ? code : EIO;
+            synced.notify_all();
+        }
+        if (stopping && pending.empty()) break;
+    }
+}
+
+// --- Storage ---------------------------------------------------------------
+
+bool Storage::recover(const SnapshotReader& loadSnapshot, const RecordReplayer& replay) {
+    if (!closed.open(archivePath)) return false;
+    uint64_t lsn = 0;
+    if (!readSnapshot(loadSnapshot, lsn)) return false;
+    if (!replayLog(replay, lsn)) return false;
+    return wal.open(logPath, lsn);
+}
+
+bool Storage::checkpoint(const SnapshotWriter& writeSnapshot) {
+    if (!wal.sync()) return false;
+    uint64_t lsn = wal.lastLsn();
+    BinaryWriter body;
+    body.u64(lsn);
+    writeSnapshot(body);
+
+    BinaryWriter file;
+    file.bytes.append(SNAPSHOT_MAGIC, 8);
+    file.u64(body.bytes.size());
+    file.u32(crc32(body.bytes.data(), body.bytes.size()));
+    file.bytes.append(body.bytes);
+
+    string tempPath = snapshotPath + ".tmp";
+    int fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    bool ok = writeWholeBuffer(fd, file.bytes.data(), file.bytes.size()) && fsync(fd) == 0;
+    ::close(fd);
+    // The rename must reach the disk before the log it replaces is emptied
+    if (!ok || rename(tempPath.c_str(), snapshotPath.c_str()) != 0 || !syncDirectoryOf(snapshotPath)) return false;
+    wal.truncate();
+    return true;
+}
+
+bool decodeSnapshot(const string& contents, const Storage::SnapshotReader& loadSnapshot, uint64_t& lsn) {
+    if (contents.size() < 20 || contents.compare(0, 8, Storage::SNAPSHOT_MAGIC) != 0) return false;
+    BinaryReader header(contents.data() + 8, 12);
+    uint64_t length = header.u64();
+    uint32_t crc = header.u32();
+    if (length != contents.size() - 20 || crc != crc32(contents.data() + 20, length)) return false;
+
+    BinaryReader in(contents.data() + 20, length);
+    lsn = in.u64();
+    return loadSnapshot(in) && in.ok;
+}
+
+size_t decodeLogRecord(const char* data, size_t size, uint64_t& lsn, LogOp& op, BinaryReader& body) {
+    if (size < 8) return 0;
+    BinaryReader frame(data, 8);
+    uint32_t length = frame.u32();
+    uint32_t crc = frame.u32();
+    if (length < 9 || length > size - 8 || crc32(data + 8, length) != crc) return 0;
+    body = BinaryReader(data + 8, length);
+    lsn = body.u64();
+    op = (LogOp)body.u8();
+    return 8 + (size_t)length;
+}
+
+bool Storage::readSnapshot(const SnapshotReader& loadSnapshot, uint64_t& lsn) {
+    string contents;
+    if (!readWholeFile(snapshotPath, contents)) return true; // no snapshot yet
+    return decodeSnapshot(contents, loadSnapshot, lsn);
+}
+
+// Applies records newer than the snapshot and cuts off a torn tail.
+// A log written in another format is left alone and reported.
+bool Storage::replayLog(const RecordReplayer& replay, uint64_t& lsn) {
+    string contents;
+    if (!readWholeFile(logPath, contents)) return true;
+    if (contents.size() < Journal::HEADER_SIZE) {
+        if (::truncate(logPath.c_str(), 0) != 0) perror("hms.wal");
+        return true;
+    }
+    if (contents.compare(0, 8, Journal::MAGIC) != 0) return false;
+    size_t pos = Journal::HEADER_SIZE;
+    uint64_t recordLsn;
+    LogOp op;
+    BinaryReader in(nullptr, 0);
+    while (size_t length = decodeLogRecord(contents.data() + pos, contents.size() - pos, recordLsn, op, in)) {
+        if (recordLsn > lsn) {
+            replay(op, in);
+            lsn = recordLsn;
+            ++replayed;
+        }
+        pos += length;
+    }
+    if (pos < contents.size() && ::truncate(logPath.c_str(), (off_t)pos) != 0) perror("hms.wal");
+    return true;
+}
+
+} // namespace hms
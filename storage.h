@@ -0,0 +1,158 @@
+#ifndef HMS_STORAGE_H
+#define HMS_STORAGE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "archive.h"
+#include "binary_io.h"
+
+namespace hms {
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Persistent storage: binary snapshot plus an append-only write-ahead log.
+// Every state change appends a log record. On startup the last snapshot is
+// loaded and newer log records are replayed on top of it. The encoding of
+// the state itself belongs to the caller (see Hospital).
+// ---------------------------------------------------------------------------
+
+enum class LogOp : uint8_t {
+    AddDepartment = 1,
+    AddRoom,
+    UpdateRoom,
+    AddStaff,
+    RegisterPatient,
+    AssignDepartment,
+    ScheduleAppointment,
+    Hospitalize,
+    Discharge,
+    UpdateTimetable,
+    AddShift,
+    ClearShifts,
+    BookVisit,
+    CancelVisit,
+    BulkAdd,
+    ReassignStaff,
+};
+
+// Write-ahead log with group commit. Appends only copy the record into a
+// memory buffer and return before it is durable; a background thread
+// writes whatever has accumulated and issues one fdatasync per batch,
+// either when the batch grows past `batchBytes`, after `commitInterval`
+// elapses or as soon as someone calls sync(). Callers that acknowledge a
+// change call sync() first, as the server does before each batch of
+// replies, and callers syncing at once share the commit. A failed write
+// or sync stops the log: nothing after it is written or reported durable.
+class Journal {
+public:
+    static constexpr const char* MAGIC = "HMSWAL03";
+    static const size_t HEADER_SIZE = 8;
+
+    size_t batchBytes = 64 * 1024;
+    chrono::milliseconds commitInterval{5};
+
+    ~Journal() { close(); }
+
+    // Opens (or creates) the log and positions new records after `lsn`
+    bool open(const string& path, uint64_t lsn);
+    bool isOpen() const { return fd >= 0; }
+
+    // Buffers one record and returns its sequence number
+    uint64_t append(LogOp op, const string& payload);
+
+    // Blocks until every record appended so far is on stable storage;
+    // false if the log failed first
+    bool sync();
+
+    // Drops all records; they must already be covered by a snapshot
+    void truncate();
+
+    uint64_t lastLsn();
+    size_t recordsSinceSnapshot();
+    void close();
+
+private:
+    int fd = -1;
+    mutex guard;
+    condition_variable wake;
+    condition_variable synced;
+    thread flusher;
+    string pending;
+    uint64_t nextLsn = 1;
+    uint64_t durableLsn = 0;
+    size_t recordsSinceCheckpoint = 0;
+    bool stopping = false;
+    bool syncRequested = false;
+    int failure = 0; // errno of the write or sync that stopped the log
+
+    void flushLoop();
+};
+
+// Snapshot file layout: magic, u64 body length, u32 body CRC, body.
+// The body starts with the covered LSN; the rest is written by the caller.
+class Storage {
+public:
+    static constexpr const char* SNAPSHOT_MAGIC = "HMSSNP06";
+    size_t checkpointEvery = 100000; // log records between automatic snapshots
+
+    using SnapshotReader = function<bool(BinaryReader&)>;
+    using SnapshotWriter = function<void(BinaryWriter&)>;
+    using RecordReplayer = function<void(LogOp, BinaryReader&)>;
+
+    explicit Storage(const string& directory)
+        : home(directory), snapshotPath(directory + "/hms.snapshot"), logPath(directory + "/hms.wal"),
+          archivePath(directory + "/hms.archive") {}
+
+    // Maps the archive, loads the snapshot, replays the log and opens it
+    // for appends. Returns false only if the files exist but cannot be used.
+    bool recover(const SnapshotReader& loadSnapshot, const RecordReplayer& replay);
+
+    // Writes a new snapshot atomically, then empties the log
+    bool checkpoint(const SnapshotWriter& writeSnapshot);
+
+    bool checkpointDue() { return wal.isOpen() && wal.recordsSinceSnapshot() >= checkpointEvery; }
+
+    Journal& journal() { return wal; }
+    const string& directory() const { return home; }
+    PatientArchive& archive() { return closed; }
+    size_t replayedRecords() const { return replayed; }
+
+    void close() { wal.close(); }
+
+private:
+    string home;
+    string snapshotPath;
+    string logPath;
+    string archivePath;
+    Journal wal;
+    PatientArchive closed;
+    size_t replayed = 0;
+
+    bool readSnapshot(const SnapshotReader& loadSnapshot, uint64_t& lsn);
+    bool replayLog(const RecordReplayer& replay, uint64_t& lsn);
+};
+
+// Checks a snapshot file's header and CRC, reads the covered LSN into
+// `lsn` and hands the rest to `loadSnapshot`
+bool decodeSnapshot(const string& contents, const Storage::SnapshotReader& loadSnapshot, uint64_t& lsn);
+
+// Reads the log record at the front of [data, data + size): the bytes it
+// takes, or 0 if it is incomplete or damaged. `body` is left at its payload.
+size_t decodeLogRecord(const char* data, size_t size, uint64_t& lsn, LogOp& op, BinaryReader& body);
+
+// Reads a whole file; false if it does not exist or cannot be read
+bool readWholeFile(const string& path, string& contents);
+
+// Writes all bytes, retrying short writes
+bool writeWholeBuffer(int fd, const char* data, size_t size);
+
+} // namespace hms
+
+#endif // HMS_STORAGE_H
@@ -0,0 +1,48 @@
+#include "symbols.h"
+
+#include <mutex>
+#include <stdexcept>
+
+namespace hms {
+
+SymbolTable symbols;
+
+SymbolTable::SymbolTable() {
+    intern("");
+}
+
+SymbolTable::~SymbolTable() {
+    for (auto& chunk : chunks) delete[] chunk.load(memory_order_relaxed);
+}
+
+uint32_t SymbolTable::intern(string_view name) {
+    {
+        shared_lock<shared_mutex> read(guard);
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+    }
+    lock_guard<shared_mutex> write(guard);
+    auto it = ids.find(name);
+    if (it != ids.end()) return it->second;
+    uint32_t id = count.load(memory_order_relaxed);
+    size_t chunk = id >> CHUNK_BITS;
+    if (chunk >= MAX_CHUNKS) throw length_error("symbol table is full");
+    string* names = chunks[chunk].load(memory_order_relaxed);
+    if (!names) {
+        names = new string[CHUNK_SIZE];
+        chunks[chunk].store(names, memory_order_release);
+    }
+    string& stored = names[id & (CHUNK_SIZE - 1)];
+    stored.assign(name.data(), name.size());
+    ids.emplace(string_view(stored), id);
+    count.store(id + 1, memory_order_release);
+    return id;
+}
+
+uint32_t SymbolTable::find(string_view name) const {
+    shared_lock<shared_mutex> read(guard);
+    auto it = ids.find(name);
+    return it == ids.end() ? NONE : it->second;
+}
+
+} // namespace hms
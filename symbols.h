@@ -0,0 +1,115 @@
+#ifndef HMS_SYMBOLS_H
+#define HMS_SYMBOLS_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace hms {
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Interned names. Departments and room types are kept once in a process-wide
+// symbol table; records hold a 4-byte Symbol instead of their own copy of
+// the text, and two symbols compare by ID.
+// ---------------------------------------------------------------------------
+
+// Thread-safe. Interning takes the table's lock (shared while the name is
+// looked up, exclusive to add it); name() takes no lock. Names are stored
+// in fixed chunks that never move, so a name stays where it was written.
+class SymbolTable {
+public:
+    static constexpr uint32_t NONE = 0xFFFFFFFFu;
+    static constexpr uint32_t EMPTY = 0; // ID of the empty name
+
+    SymbolTable();
+    ~SymbolTable();
+
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    uint32_t intern(string_view name);
+    uint32_t find(string_view name) const; // NONE if never interned
+
+    const string& name(uint32_t id) const {
+        return chunks[id >> CHUNK_BITS].load(memory_order_acquire)[id & (CHUNK_SIZE - 1)];
+    }
+
+    size_t size() const { return count.load(memory_order_acquire); }
+
+private:
+    static const unsigned CHUNK_BITS = 10;
+    static const size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+    static const size_t MAX_CHUNKS = 4096; // four million names
+
+    mutable shared_mutex guard;
+    unordered_map<string_view, uint32_t> ids; // views of the names in the chunks
+    array<atomic<string*>, MAX_CHUNKS> chunks{};
+    atomic<uint32_t> count{0};
+};
+
+// Shared by every record in the process
+extern SymbolTable symbols;
+
+// An interned name. Converts to the name wherever a string is read, so
+// records can be printed and passed to string parameters as before.
+class Symbol {
+public:
+    Symbol() = default;
+    Symbol(const string& name) : symbol(symbols.intern(name)) {}
+    Symbol(const char* name) : symbol(symbols.intern(name)) {}
+
+    static Symbol fromId(uint32_t id) {
+        Symbol s;
+        s.symbol = id;
+        return s;
+    }
+
+    // The symbol of a name without interning it; false if the name was
+    // never interned, so nothing can refer to it yet
+    static bool find(string_view name, Symbol& found) {
+        uint32_t id = symbols.find(name);
+        if (id == SymbolTable::NONE) return false;
+        found.symbol = id;
+        return true;
+    }
+
+    uint32_t id() const { return symbol; }
+    const string& str() const { return symbols.name(symbol); }
+    operator const string&() const { return str(); }
+    bool empty() const { return symbol == SymbolTable::EMPTY; }
+
+    friend bool operator==(Symbol a, Symbol b) { return a.symbol == b.symbol; }
+    friend bool operator!=(Symbol a, Symbol b) { return a.symbol != b.symbol; }
+    // Against text the name is looked up, never interned
+    friend bool operator==(Symbol a, const string& b) { return a.symbol == symbols.find(b); }
+    friend bool operator!=(Symbol a, const string& b) { return !(a == b); }
+    friend bool operator==(const string& a, Symbol b) { return b == a; }
+    friend bool operator!=(const string& a, Symbol b) { return !(b == a); }
+
+private:
+    uint32_t symbol = SymbolTable::EMPTY;
+};
+
+inline ostream& operator<<(ostream& out, Symbol symbol) {
+    return out << symbol.str();
+}
+
+} // namespace hms
+
+namespace std {
+template <>
+struct hash<hms::Symbol> {
+    size_t operator()(hms::Symbol symbol) const { return symbol.id(); }
+};
+} // namespace std
+
+#endif // HMS_SYMBOLS_H
@@ -0,0 +1,202 @@
+#ifndef HMS_TIMETABLE_H
+#define HMS_TIMETABLE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hms {
+using namespace std;
+
+const int HOURS_IN_DAY = 24;
+
+
+// Per-slot schedule states. Appointment is a booked Work slot.
+enum class SlotState : uint8_t { Free = 0, Work = 1, Appointment = 2 };
+
+inline const char* slotStateName(SlotState state) {
+    switch (state) {
+    case SlotState::Work: return "Work";
+    case SlotState::Appointment: return "Appointment";
+    default: return "Free";
+    }
+}
+
+inline SlotState parseSlotState(const string& status) {
+    if (status == "Work") return SlotState::Work;
+    if (status == "Appointment") return SlotState::Appointment;
+    return SlotState::Free;
+}
+
+// Compact staff schedule: two bitmaps over all slots of the horizon.
+// A slot is Work when its bit is set in `work`, and Appointment when it is
+// also set in `booked`. Slots run day-major, hour, then sub-hour slot.
+// Bitmap words are read and written atomically, and book() claims an hour
+// with a compare-and-swap, so desks may book the same timetable at once.
+// Shift edits (set, setRange, setHours) must not run concurrently.
+class Timetable {
+public:
+    // slotsPerHour must divide 64 and be at most 4 (15 minute slots)
+    explicit Timetable(int days = 1, int slotsPerHour = 1)
+        : days(days < 1 ? 1 : days),
+          perHour(slotsPerHour == 2 || slotsPerHour == 4 ? slotsPerHour : 1),
+          work(wordCount(), 0), booked(wordCount(), 0) {}
+
+    int slotsPerHour() const { return perHour; }
+    int dayCount() const { return days; }
+    int slotCount() const { return days * HOURS_PER_DAY * perHour; }
+    int slotOf(int hour, int day = 0) const { return (day * HOURS_PER_DAY + hour) * perHour; }
+
+    SlotState state(int slot) const {
+        if (bit(booked, slot)) return SlotState::Appointment;
+        return bit(work, slot) ? SlotState::Work : SlotState::Free;
+    }
+
+    void set(int slot, SlotState state) { setRange(slot, slot, state); }
+
+    // Sets every slot in [first, last], clipped to the horizon
+    void setRange(int first, int last, SlotState state) {
+        first = max(first, 0);
+        last = min(last, slotCount() - 1);
+        for (int slot = first; slot <= last;) {
+            int word = slot / 64, offset = slot % 64;
+            int span = min(64 - offset, last - slot + 1);
+            uint64_t mask = (span == 64 ? ~0ULL : ((1ULL << span) - 1)) << offset;
+            uint64_t workWord = load(work[word]), bookedWord = load(booked[word]);
+            store(work[word], state == SlotState::Free ? workWord & ~mask : workWord | mask);
+            store(booked[word], state == SlotState::Appointment ? bookedWord | mask : bookedWord & ~mask);
+            slot += span;
+        }
+    }
+
+    // Sets every slot of the given hours (inclusive) on one day
+    void setHours(int startHour, int endHour, SlotState state, int day = 0) {
+        startHour = max(startHour, 0);
+        endHour = min(endHour, HOURS_PER_DAY - 1);
+        if (startHour > endHour || day < 0 || day >= days) return;
+        setRange(slotOf(startHour, day), slotOf(endHour, day) + perHour - 1, state);
+    }
+
+    // First Work slot that is not booked at or after `from`, or -1
+    int firstOpenSlot(int from = 0) const {
+        if (from < 0) from = 0;
+        for (int word = from / 64; word < (int)work.size(); ++word) {
+            uint64_t open = load(work[word]) & ~load(booked[word]);
+            if (word == from / 64) open &= ~0ULL << (from % 64);
+            if (open) {
+                int slot = word * 64 + __builtin_ctzll(open);
+                return slot < slotCount() ? slot : -1;
+            }
+        }
+        return -1;
+    }
+
+    // Bit `hour` set for each hour of the day that isAvailable; skips from
+    // one open slot to the next rather than testing every hour
+    uint32_t openHours(int day = 0) const {
+        uint32_t hours = 0;
+        if (day < 0 || day >= days) return hours;
+        for (int slot = firstOpenSlot(slotOf(0, day)); slot >= 0 && slot < slotOf(0, day + 1);) {
+            int hour = slot / perHour % HOURS_PER_DAY;
+            if (isAvailable(hour, day)) hours |= 1u << hour;
+            slot = firstOpenSlot(slotOf(hour + 1, day));
+        }
+        return hours;
+    }
+
+    // True when every slot of the hour is a Work slot with no booking
+    bool isAvailable(int hour, int day = 0) const {
+        uint64_t mask;
+        int word = hourWord(hour, day, mask);
+        return word >= 0 && (load(work[word]) & mask) == mask && (load(booked[word]) & mask) == 0;
+    }
+
+    // True when nothing is scheduled in any slot of the hour
+    bool isFree(int hour, int day = 0) const {
+        uint64_t mask;
+        int word = hourWord(hour, day, mask);
+        return word >= 0 && (load(work[word]) & mask) == 0;
+    }
+
+    // Books every slot of an available hour; false if it is not open or
+    // another caller booked it first
+    bool book(int hour, int day = 0) {
+        uint64_t mask;
+        int word = hourWord(hour, day, mask);
+        if (word < 0 || (load(work[word]) & mask) != mask) return false;
+        uint64_t seen = load(booked[word]);
+        do {
+            if (seen & mask) return false;
+        } while (!__atomic_compare_exchange_n(&booked[word], &seen, seen | mask, true,
+                                              __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+        return true;
+    }
+
+    // Clears the booking of an hour; false if it was not booked
+    bool release(int hour, int day = 0) {
+        uint64_t mask;
+        int word = hourWord(hour, day, mask);
+        return word >= 0 && (__atomic_fetch_and(&booked[word], ~mask, __ATOMIC_ACQ_REL) & mask) == mask;
+    }
+
+    // Adapter so `timetable[hour] == "Work"` and
+    // `timetable[hour] = "Appointment"` keep working on day 0 hours.
+    class HourRef {
+    public:
+        HourRef(Timetable& table, int hour) : table(table), hour(hour) {}
+        operator string() const { return slotStateName(table.state(table.slotOf(hour))); }
+        bool operator==(const string& status) const { return table.state(table.slotOf(hour)) == parseSlotState(status); }
+        bool operator!=(const string& status) const { return !(*this == status); }
+        HourRef& operator=(const string& status) {
+            table.setHours(hour, hour, parseSlotState(status));
+            return *this;
+        }
+    private:
+        Timetable& table;
+        int hour;
+    };
+
+    // Raw bitmaps, for persistence
+    const vector<uint64_t>& workBits() const { return work; }
+    const vector<uint64_t>& bookedBits() const { return booked; }
+    void assignBits(const vector<uint64_t>& newWork, const vector<uint64_t>& newBooked) {
+        if (newWork.size() != work.size() || newBooked.size() != booked.size()) return;
+        work = newWork;
+        booked = newBooked;
+    }
+
+    HourRef operator[](int hour) { return HourRef(*this, hour); }
+    string operator[](int hour) const { return slotStateName(state(slotOf(hour))); }
+    size_t size() const { return HOURS_PER_DAY; }
+
+private:
+    static const int HOURS_PER_DAY = 24;
+
+    int days;
+    int perHour;
+    vector<uint64_t> work;
+    vector<uint64_t> booked;
+
+    size_t wordCount() const { return (slotCount() + 63) / 64; }
+
+    static uint64_t load(const uint64_t& word) { return __atomic_load_n(&word, __ATOMIC_ACQUIRE); }
+    static void store(uint64_t& word, uint64_t value) { __atomic_store_n(&word, value, __ATOMIC_RELEASE); }
+
+    static bool bit(const vector<uint64_t>& bits, int slot) {
+        return (load(bits[slot / 64]) >> (slot % 64)) & 1;
+    }
+
+    // Word index and mask covering all slots of an hour; the slots of one
+    // hour never straddle a word because perHour divides 64
+    int hourWord(int hour, int day, uint64_t& mask) const {
+        if (hour < 0 || hour >= HOURS_PER_DAY || day < 0 || day >= days) return -1;
+        int slot = slotOf(hour, day);
+        mask = ((1ULL << perHour) - 1) << (slot % 64);
+        return slot / 64;
+    }
+};
+
+} // namespace hms
+
+#endif // HMS_TIMETABLE_H